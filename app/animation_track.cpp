@@ -0,0 +1,68 @@
+#include <app/animation_track.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	mat34 evaluate_track(const keyframe* keys, unsigned int count, const vec3& pivot, float time, const mat34& rest)
+	{
+		if(count == 0)
+		{
+			return rest;
+		}
+
+		// 1. key before the wrapped time, and the blend towards the next one
+		const auto last_time = keys[count - 1].time;
+		const auto t = last_time > 0.0f ? time - last_time * std::floor(time / last_time) : 0.0f;
+		unsigned int k = 0;
+		while(k + 1 < count && keys[k + 1].time <= t)
+		{
+			++k;
+		}
+
+		auto translation = keys[k].translation;
+		float q[4] = {keys[k].rotation[0], keys[k].rotation[1], keys[k].rotation[2], keys[k].rotation[3]};
+		if(k + 1 < count)
+		{
+			const auto& a = keys[k];
+			const auto& b = keys[k + 1];
+			const auto s = (t - a.time) / (b.time - a.time);
+			translation = a.translation * (1.0f - s) + b.translation * s;
+
+			// shortest arc, blended as mix does
+			const auto d = a.rotation[0]*b.rotation[0] + a.rotation[1]*b.rotation[1] + a.rotation[2]*b.rotation[2] + a.rotation[3]*b.rotation[3];
+			const auto sign = d < 0.0f ? -1.0f : 1.0f;
+			float length = 0.0f;
+			for(int i = 0; i < 4; ++i)
+			{
+				q[i] = a.rotation[i] * (1.0f - s) + sign * b.rotation[i] * s;
+				length += q[i] * q[i];
+			}
+			const auto inverse_length = 1.0f / std::sqrt(length);
+			for(int i = 0; i < 4; ++i)
+			{
+				q[i] *= inverse_length;
+			}
+		}
+
+		// 2. rotation about the pivot followed by the translation, applied after the rest transform
+		const auto x = q[0], y = q[1], z = q[2], w = q[3];
+		mat34 delta;
+		delta.data[0] = 1.0f - 2.0f*(y*y + z*z);
+		delta.data[1] = 2.0f*(x*y - w*z);
+		delta.data[2] = 2.0f*(x*z + w*y);
+		delta.data[4] = 2.0f*(x*y + w*z);
+		delta.data[5] = 1.0f - 2.0f*(x*x + z*z);
+		delta.data[6] = 2.0f*(y*z - w*x);
+		delta.data[8] = 2.0f*(x*z - w*y);
+		delta.data[9] = 2.0f*(y*z + w*x);
+		delta.data[10] = 1.0f - 2.0f*(x*x + y*y);
+		const auto rotated_pivot = delta.mul3x3(pivot);
+		delta.data[3] = pivot.x + translation.x - rotated_pivot.x;
+		delta.data[7] = pivot.y + translation.y - rotated_pivot.y;
+		delta.data[11] = pivot.z + translation.z - rotated_pivot.z;
+		return delta.mul(rest);
+	}
+} // namespace app
@@ -0,0 +1,18 @@
+#pragma once
+#include <app/transformation.h>
+
+namespace app
+{
+	// rigid motion of an instance about its rest center at one time, the rotation is a unit quaternion x, y, z, w
+	// laid out as the two texels duplicate_instance.vert fetches per key
+	struct keyframe
+	{
+		vec3 translation = vec3(0.0f);
+		float time = 0.0f;
+		float rotation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+	};
+
+	// keys in increasing time, the track loops at the time of its last key
+	// same steps as the vertex shader: linear translation, normalized linear quaternion, delta applied after rest
+	mat34 evaluate_track(const keyframe* keys, unsigned int count, const vec3& pivot, float time, const mat34& rest);
+} // namespace app
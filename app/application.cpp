@@ -1,25 +1,332 @@
 #include <app/application.h>
 #include <app/rvm_observer.h>
+#include <app/transform_kernels.h>
 #include <rvm/StatsCollector.h>
 #include <glv/viewer.h>
 #include <bl/bl.h>
 
 namespace app
 {
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// must match the projection set up by glb::engine::resize_screen
+	static const float CAMERA_FOVY = math::to_radians(60.0f);
+	static const float CAMERA_ZNEAR = 1.0f;
+	static const float CAMERA_ZFAR = 10000.0f;
+
+	// unique meshes with fewer instances are merged into static batches, 0 keeps every mesh instanced
+	static const unsigned int MERGE_THRESHOLD = 0;
+
+	// moving objects bob up and down around their upload-time position, in model units and radians per frame
+	static const float MOVE_AMPLITUDE = 0.5f;
+	static const float MOVE_SPEED = 0.05f;
+
+	// neighbouring instances move together as one delta over a contiguous range, groups per thread pool task
+	static const unsigned int MOVE_GROUP_SIZE = 64;
+	static const unsigned int MOVE_GRAIN = 64;
+	static const unsigned int BENCHMARK_RUNS = 10;
+
+	// an animated module is one contiguous fraction of the geometries, swinging each frame and changing color every period
+	static const unsigned int MODULE_FRACTION = 50;
+	static const unsigned int MODULE_COLOR_PERIOD = 30;
+
+	// shared-memory transform feed, the stand-in simulator drives one contiguous fraction of the geometries
+	static const char* FEED_NAME = "/rvm_transform_feed";
+	static const unsigned int FEED_FRACTION = 100;
+	static const float FEED_RATE_HZ = 240.0f;
+
+	// stand-in hierarchy over runs of consecutive geometries: site, zones of equipment, equipment of geometries
+	static const unsigned int EQUIPMENT_GEOMETRIES = 32;
+	static const unsigned int ZONE_EQUIPMENT = 16;
+
+	// keyframed dismantling of one contiguous fraction of the geometries: lifted, turned a quarter, put back, in seconds and model units
+	static const unsigned int TRACK_FRACTION = 100;
+	static const float TRACK_LIFT = 5.0f;
+	static const float TRACK_STEP_SECONDS = 2.0f;
+
+	// stand-in selection for isolating, highlighting and ghosting, one contiguous fraction of the geometries
+	static const unsigned int SELECTION_FRACTION = 10;
+	static const char* SELECTION_MODES[] = {"off", "isolated", "highlighted", "ghosted"};
+
+	// stand-in status overlay over every geometry, refreshed every period with one of OVERLAY_VALUES values per geometry,
+	// the first ones are statuses and the others show the CAD color
+	static const unsigned int OVERLAY_PERIOD = 30;
+	static const unsigned int OVERLAY_VALUES = 8;
+	static const unsigned int OVERLAY_STATUSES = 3;
+
+	// stand-in module delivery after loading: a copy of one contiguous fraction of the geometries next to the model, and a marker
+	// sphere above it that is matched like any mesh added late, in model units
+	static const unsigned int DELIVERY_FRACTION = 50;
+	static const float DELIVERY_OFFSET = 20.0f;
+	static const float DELIVERY_MARKER_RADIUS = 1.0f;
+	static const float DELIVERY_MARKER_LIFT = 10.0f;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static mat34 translation(const vec3& t)
+	{
+		return mat34(mat4::translation(t));
+	}
+
+	// rotation about the vertical axis through pivot
+	static mat34 rotation_z(float angle, const vec3& pivot)
+	{
+		auto r = translation(pivot);
+		const auto c = std::cos(angle);
+		const auto s = std::sin(angle);
+		r.data[0] = c;
+		r.data[1] = -s;
+		r.data[4] = s;
+		r.data[5] = c;
+		return r;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
 	void application::display(float* view_matrix)
 	{
 		_engine.set_view(view_matrix);
+
+		// view_matrix is column-major
+		const auto* v = view_matrix;
+		const mat4 view(v[0], v[4], v[8],  v[12],
+						v[1], v[5], v[9],  v[13],
+						v[2], v[6], v[10], v[14],
+						v[3], v[7], v[11], v[15]);
+		frustum f;
+		f.set(view, mat4::perspective(CAMERA_FOVY, (float)_width / (float)_height, CAMERA_ZNEAR, CAMERA_ZFAR), _height);
+		_renderer->set_view(f);
+
+		// occluders are rasterized on the CPU before the renderers test against them
+		if(_occlusion_culling)
+		{
+			_occlusion_buffer.begin(f);
+			_get_mesh_renderer().add_occluders(_occlusion_buffer);
+			_get_parametric_renderer().add_occluders(_occlusion_buffer);
+		}
+
+		mat34* frame = nullptr;
+		if(_get_mesh_renderer().get_dynamic_transforms())
+		{
+			frame = _move_objects();
+		}
+		else if(_animate_module)
+		{
+			_move_module();
+		}
+
+		// one zone turns on its pivot, only its subtree is recomputed, uploaded and refitted for culling
+		if(_animate_hierarchy && !_zones.empty())
+		{
+			const auto zone = _zones.size() / 2;
+			_hierarchy.set_local(_zones[zone], rotation_z(_frame++ * MOVE_SPEED * 0.1f, _zone_pivots[zone]));
+			auto& meshes = _get_mesh_renderer();
+			_hierarchy_nodes = _hierarchy.update([&meshes, frame](instance_handle handle, const mat34& world)
+			{
+				meshes.set_transform(frame, handle, world);
+			});
+		}
+
+		// keyframed instances only need the time, their tracks are evaluated by the vertex stage
+		if(_animate_tracks)
+		{
+			_get_mesh_renderer().set_animation_time(_animation_timer.sec());
+		}
+
+		if(_overlay && ++_overlay_frame % OVERLAY_PERIOD == 0)
+		{
+			_refresh_overlay();
+		}
+
+		// records written by the simulation since the last frame, applied in order so the newest transform wins,
+		// and straight into the mapped frame while transforms are streamed through the ring
+		if(_feed.is_open())
+		{
+			auto& meshes = _get_mesh_renderer();
+			_feed.consume([&meshes, frame](const feed_record& r)
+			{
+				meshes.set_transform(frame, r.handle, r.transform);
+			});
+		}
+
 		_engine.render();
 	}
 
 	void application::reshape(int w, int h)
 	{
+		_width = math::max(w, 1);
+		_height = math::max(h, 1);
 		_engine.resize_screen(w, h);
 	}
 
-	bool application::key_press(unsigned char /*key*/, int /*x*/, int /*y*/)
+	bool application::key_press(unsigned char key, int /*x*/, int /*y*/)
 	{
-		return false;
+		auto& meshes = _get_mesh_renderer();
+		auto& parametrics = _get_parametric_renderer();
+
+		switch(key)
+		{
+		case 'm':
+			meshes.set_meshlet_culling(!meshes.get_meshlet_culling());
+			io::print("meshlet culling:", meshes.get_meshlet_culling());
+			return true;
+		case 'l':
+			meshes.set_lod_selection(!meshes.get_lod_selection());
+			io::print("lod selection:", meshes.get_lod_selection());
+			return true;
+		case 'i':
+			meshes.set_multi_draw(!meshes.get_multi_draw());
+			io::print("multi draw indirect:", meshes.get_multi_draw());
+			return true;
+		case 'c':
+			meshes.set_instance_culling(!meshes.get_instance_culling());
+			parametrics.set_instance_culling(meshes.get_instance_culling());
+			io::print("instance culling:", meshes.get_instance_culling());
+			return true;
+		case 'r':
+			meshes.set_range_culling(!meshes.get_range_culling());
+			io::print("instance range culling:", meshes.get_range_culling());
+			return true;
+		case 'o':
+			_occlusion_culling = !_occlusion_culling;
+			meshes.set_occlusion_buffer(_occlusion_culling ? &_occlusion_buffer : nullptr);
+			parametrics.set_occlusion_buffer(_occlusion_culling ? &_occlusion_buffer : nullptr);
+			io::print("occlusion culling:", _occlusion_culling);
+			return true;
+		case 'f':
+		{
+			// draw, cull, point
+			const auto mode = static_cast<small_feature_mode>((meshes.get_small_feature_mode() + 1) % 3);
+			meshes.set_small_feature_mode(mode);
+			parametrics.set_small_feature_mode(mode);
+			io::print("small features:", mode == small_feature_draw ? "draw" : (mode == small_feature_cull ? "cull" : "point"));
+			return true;
+		}
+		case 'z':
+			_combined_instance_renderer.set_depth_prepass(!_combined_instance_renderer.get_depth_prepass());
+			io::print("depth pre-pass:", _combined_instance_renderer.get_depth_prepass());
+			return true;
+		case 'b':
+			_combined_instance_renderer.set_front_to_back(!_combined_instance_renderer.get_front_to_back());
+			io::print("front to back:", _combined_instance_renderer.get_front_to_back());
+			return true;
+		case 'v':
+			_combined_instance_renderer.set_visibility_buffer(!_combined_instance_renderer.get_visibility_buffer());
+			io::print("visibility buffer:", _combined_instance_renderer.get_visibility_buffer());
+			return true;
+		case 'd':
+			meshes.set_dynamic_transforms(!meshes.get_dynamic_transforms());
+			io::print("moving objects:", meshes.get_dynamic_transforms());
+			if(meshes.get_dynamic_transforms())
+			{
+				io::print("mesh culling, level of detail and occluders are paused while objects move");
+				_benchmark_transform_update();
+			}
+			return true;
+		case 'a':
+		{
+			// the module is a run of consecutive geometries of the model, back at their rest transforms when stopped
+			_animate_module = !_animate_module;
+			if(_animate_module)
+			{
+				const auto count = meshes.get_handle_count();
+				_module_first = count / 2;
+				_module_transforms.clear();
+				for(auto h = _module_first; h < math::min(count, _module_first + math::max(count / MODULE_FRACTION, 1u)); ++h)
+				{
+					_module_transforms.push_back(meshes.get_transform(h));
+				}
+			}
+			else
+			{
+				for(unsigned int i = 0; i < _module_transforms.size(); ++i)
+				{
+					meshes.set_transform(_module_first + i, _module_transforms[i].as_mat4());
+				}
+			}
+			io::print("animated module:", _animate_module, "with", _module_transforms.size(), "geometries");
+			return true;
+		}
+		case 'x':
+			_toggle_feed();
+			return true;
+		case 'h':
+			_animate_hierarchy = !_animate_hierarchy;
+			if(_animate_hierarchy && _zones.empty())
+			{
+				_build_hierarchy();
+			}
+			io::print("animated zone:", _animate_hierarchy, _zones.empty() ? 0u : _hierarchy.get_subtree_size(_zones[_zones.size() / 2]), "nodes of", _hierarchy.get_node_count());
+			return true;
+		case 'k':
+			_toggle_tracks();
+			return true;
+		case 'j':
+			meshes.set_cpu_animation(!meshes.get_cpu_animation());
+			io::print("keyframe tracks evaluated on:", meshes.get_cpu_animation() ? "cpu" : "gpu");
+			return true;
+		case 'u':
+			_cycle_selection();
+			return true;
+		case 'y':
+			_overlay = !_overlay;
+			if(_overlay)
+			{
+				_refresh_overlay();
+				io::print("status overlay:", meshes.get_handle_count(), "geometries,", _overlay_changed, "recolored in", _overlay_ms, "ms");
+			}
+			else
+			{
+				io::print("status overlay: off, recolored", meshes.reset_colors(), "geometries");
+			}
+			return true;
+		case 'n':
+			_toggle_delivery();
+			return true;
+		case 'e':
+		{
+			// off, all edges, feature edges
+			const auto mode = static_cast<wireframe_mode>((_combined_instance_renderer.get_wireframe_mode() + 1) % 3);
+			_combined_instance_renderer.set_wireframe_mode(mode);
+			io::print("wireframe:", mode == wireframe_off ? "off" : (mode == wireframe_all_edges ? "all edges" : "feature edges"));
+			return true;
+		}
+		case 's':
+			io::print("shaded samples:", _combined_instance_renderer.get_shaded_samples(), "overdraw:", _combined_instance_renderer.get_overdraw());
+			io::print("mesh triangles:", meshes.get_cull_stats().drawn_triangles, "draw calls:", meshes.get_cull_stats().draw_calls);
+			io::print("parametric vertices:", parametrics.get_vertex_count());
+			io::print("transform ring stalls:", meshes.get_transform_stalls());
+			if(_feed.is_open())
+			{
+				const auto stats = _feed.get_stats();
+				const auto mean_latency = stats.records > 0 ? stats.latency_sum_ms / stats.records : 0.0;
+				io::print("feed records per second:", stats.records / math::max(stats.seconds, 1e-3f), "latency ms mean:", mean_latency, "max:", stats.max_latency_ms,
+						  "dropped:", stats.dropped);
+				_feed.reset_stats();
+			}
+			io::print("hierarchy nodes recomputed:", _hierarchy_nodes, "culling nodes refitted:", meshes.get_upload_stats().refit_nodes);
+			io::print("status overlay refresh:", _overlay_changed, "recolored in", _overlay_ms, "ms");
+			io::print("hidden instances:", meshes.get_hidden_count(), "left out of draw lists:", meshes.get_cull_stats().hidden_instances);
+			{
+				const auto layout = meshes.get_layout_stats();
+				io::print("instance slots:", layout.slots, "spare:", layout.spare_slots, "waiting:", layout.pending_instances, "layouts:", layout.repacks);
+				io::print("geometry buffers:", layout.vertex_bytes, "vertex bytes,", layout.element_bytes, "element bytes, grown", layout.buffer_grows, "times");
+			}
+			io::print("uploaded bytes:", meshes.get_upload_stats().uploaded_bytes, "in", meshes.get_upload_stats().ranges, "ranges, full upload:", meshes.get_upload_stats().full_bytes);
+			return true;
+		case 'p':
+			parametrics.set_lod_selection(!parametrics.get_lod_selection());
+			io::print("parametric lod selection:", parametrics.get_lod_selection());
+			return true;
+		default:
+			return false;
+		}
 	}
 
 	bool application::initialize()
@@ -29,24 +336,28 @@ namespace app
 #define COMBINED
 
 #ifdef STATIC
-		if(!_engine.initialize(&_static_renderer))
+		_renderer = &_static_renderer;
 #elif defined(CPU)
-		if(!_engine.initialize(&_cpu_instance_renderer))
+		_renderer = &_cpu_instance_renderer;
 #elif defined(ATTRIB)
-		if(!_engine.initialize(&_attrib_instance_renderer))
+		_renderer = &_attrib_instance_renderer;
 #elif defined(TBO)
-		if(!_engine.initialize(&_texture_instance_renderer))
+		_renderer = &_texture_instance_renderer;
 #elif defined(MATCHING)
-		if(!_engine.initialize(&_duplicate_instance_renderer))
+		_renderer = &_duplicate_instance_renderer;
 #elif defined(PARAMETRIC)
-		if(!_engine.initialize(&_parametric_instance_renderer))
+		_renderer = &_parametric_instance_renderer;
 #elif defined(COMBINED)
-		if(!_engine.initialize(&_combined_instance_renderer))
+		_renderer = &_combined_instance_renderer;
 #endif
+
+		if(!_engine.initialize(_renderer))
 		{
 			return false;
 		}
 
+		_get_mesh_renderer().set_merge_threshold(MERGE_THRESHOLD);
+
 #ifdef STATIC
 		_static_renderer.begin_upload();
 #elif defined(CPU)
@@ -177,6 +488,319 @@ namespace app
 
 	bool application::finalize()
 	{
+		_feed_producer.stop();
+		_feed.close();
 		return true;
 	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	duplicate_instance_renderer& application::_get_mesh_renderer()
+	{
+#if defined(COMBINED)
+		return _combined_instance_renderer.get_mesh_renderer();
+#else
+		return _duplicate_instance_renderer;
+#endif
+	}
+
+	parametric_instance_renderer& application::_get_parametric_renderer()
+	{
+#if defined(COMBINED)
+		return _combined_instance_renderer.get_parametric_renderer();
+#else
+		return _parametric_instance_renderer;
+#endif
+	}
+
+	mat34* application::_move_objects()
+	{
+		// every transform of the frame is written straight into mapped memory, which is never read back, the frame is returned
+		// for updates that must land in it
+		auto& meshes = _get_mesh_renderer();
+		const auto& transforms = meshes.get_transforms();
+		auto* frame = meshes.map_transforms();
+		const auto phase = _frame++ * MOVE_SPEED;
+		const unsigned int count = transforms.size();
+		const auto groups = (count + MOVE_GROUP_SIZE - 1) / MOVE_GROUP_SIZE;
+		_thread_pool.parallel_for(groups, MOVE_GRAIN, [&](unsigned int first, unsigned int last)
+		{
+			for(auto g = first; g < last; ++g)
+			{
+				const auto begin = g * MOVE_GROUP_SIZE;
+				const mat34 delta(mat4::translation(vec3(0.0f, 0.0f, MOVE_AMPLITUDE * std::sin(phase + g))));
+				apply_delta(delta, transforms.data() + begin, frame + begin, math::min(MOVE_GROUP_SIZE, count - begin));
+			}
+		});
+		return frame;
+	}
+
+	void application::_move_module()
+	{
+		// handles reach the module's slots wherever end_upload put them, only their pages are uploaded
+		auto& meshes = _get_mesh_renderer();
+		const auto phase = _frame++ * MOVE_SPEED;
+		const mat34 delta(mat4::translation(vec3(0.0f, 0.0f, MOVE_AMPLITUDE * std::sin(phase))));
+		_module_frame.resize(_module_transforms.size());
+		apply_delta(delta, _module_transforms.data(), _module_frame.data(), _module_transforms.size());
+
+		const bool recolor = _frame % MODULE_COLOR_PERIOD == 0;
+		for(unsigned int i = 0; i < _module_frame.size(); ++i)
+		{
+			meshes.set_transform(_module_first + i, _module_frame[i].as_mat4());
+			if(recolor)
+			{
+				meshes.set_color(_module_first + i, static_cast<unsigned char>(_frame / MODULE_COLOR_PERIOD));
+			}
+		}
+	}
+
+	void application::_toggle_feed()
+	{
+		auto& meshes = _get_mesh_renderer();
+		if(_feed.is_open())
+		{
+			// pending records are dropped with the segment, the fed geometries go back to rest
+			_feed_producer.stop();
+			_feed.close();
+			for(unsigned int i = 0; i < _feed_transforms.size(); ++i)
+			{
+				meshes.set_transform(_feed_handles[i], _feed_transforms[i]);
+			}
+			io::print("transform feed: off");
+			return;
+		}
+
+		if(!_feed.create(FEED_NAME))
+		{
+			io::print("transform feed: cannot create", FEED_NAME);
+			return;
+		}
+
+		const auto count = meshes.get_handle_count();
+		_feed_handles.clear();
+		_feed_transforms.clear();
+		for(auto h = count / 4; h < math::min(count, count / 4 + math::max(count / FEED_FRACTION, 1u)); ++h)
+		{
+			_feed_handles.push_back(h);
+			_feed_transforms.push_back(meshes.get_transform(h));
+		}
+		if(!_feed_producer.start(FEED_NAME, _feed_handles, _feed_transforms, FEED_RATE_HZ))
+		{
+			io::print("transform feed: stand-in producer cannot attach");
+		}
+		io::print("transform feed:", FEED_NAME, "with", _feed_handles.size(), "geometries at", FEED_RATE_HZ, "Hz");
+	}
+
+	void application::_toggle_tracks()
+	{
+		auto& meshes = _get_mesh_renderer();
+		_animate_tracks = !_animate_tracks;
+		if(!_animate_tracks)
+		{
+			meshes.set_animation_time(-1.0f);
+			meshes.clear_animation_tracks();
+			io::print("keyframe tracks: off");
+			return;
+		}
+
+		// every geometry of the run shares the sequence, turning about its own center
+		const auto quarter = math::to_radians(45.0f);
+		vector<keyframe> keys(4);
+		keys[1].time = TRACK_STEP_SECONDS;
+		keys[1].translation = vec3(0.0f, 0.0f, TRACK_LIFT);
+		keys[2].time = 2.0f * TRACK_STEP_SECONDS;
+		keys[2].translation = vec3(0.0f, 0.0f, TRACK_LIFT);
+		keys[2].rotation[2] = std::sin(quarter);
+		keys[2].rotation[3] = std::cos(quarter);
+		keys[3].time = 3.0f * TRACK_STEP_SECONDS;
+
+		const auto count = meshes.get_handle_count();
+		const auto first = count * 3 / 4;
+		const auto last = math::min(count, first + math::max(count / TRACK_FRACTION, 1u));
+		for(auto h = first; h < last; ++h)
+		{
+			meshes.set_animation_track(h, keys);
+		}
+		_animation_timer = timer();
+		io::print("keyframe tracks:", last - first, "geometries");
+	}
+
+	void application::_cycle_selection()
+	{
+		// flags change in bulk, nothing is reloaded
+		auto& meshes = _get_mesh_renderer();
+		_selection_mode = (_selection_mode + 1) % 4;
+		meshes.clear_flags(instance_hidden | instance_highlighted | instance_ghosted);
+
+		const auto count = meshes.get_handle_count();
+		vector<instance_handle> selection;
+		for(auto h = count / 8; h < math::min(count, count / 8 + math::max(count / SELECTION_FRACTION, 1u)); ++h)
+		{
+			selection.push_back(h);
+		}
+
+		if(_selection_mode == 1)
+		{
+			// everything else is hidden, a hidden majority is compacted out of the draws
+			vector<instance_handle> all(count);
+			for(unsigned int h = 0; h < count; ++h)
+			{
+				all[h] = h;
+			}
+			meshes.set_flags(all, instance_hidden, 0);
+			meshes.set_flags(selection, 0, instance_hidden);
+		}
+		else if(_selection_mode == 2)
+		{
+			meshes.set_flags(selection, instance_highlighted, 0);
+		}
+		else if(_selection_mode == 3)
+		{
+			meshes.set_flags(selection, instance_ghosted, 0);
+		}
+		io::print("selection:", SELECTION_MODES[_selection_mode], "with", selection.size(), "geometries,", meshes.get_hidden_count(), "hidden");
+	}
+
+	void application::_refresh_overlay()
+	{
+		// statuses take the palette entries past the CAD materials: inspection due, work order, alarm
+		auto& meshes = _get_mesh_renderer();
+		const auto first = math::min(meshes.get_material_count(), PALETTE_SIZE - OVERLAY_STATUSES);
+		const vec3 status_colors[OVERLAY_STATUSES] = {vec3(0.9f, 0.8f, 0.1f), vec3(0.1f, 0.4f, 0.9f), vec3(0.9f, 0.1f, 0.1f)};
+		vector<unsigned char> palette(OVERLAY_STATUSES);
+		for(unsigned int i = 0; i < OVERLAY_STATUSES; ++i)
+		{
+			palette[i] = static_cast<unsigned char>(first + i);
+			meshes.set_palette_color(palette[i], status_colors[i]);
+		}
+
+		// a new status for every geometry, as a fresh query result would give
+		const auto count = meshes.get_handle_count();
+		_overlay_values.resize(count);
+		++_overlay_step;
+		for(unsigned int h = 0; h < count; ++h)
+		{
+			_overlay_values[h] = static_cast<unsigned char>(((h + _overlay_step) * 2654435761u >> 16) % OVERLAY_VALUES);
+		}
+
+		timer t;
+		_overlay_changed = meshes.map_colors(_overlay_values, palette);
+		_overlay_ms = t.msec();
+	}
+
+	void application::_toggle_delivery()
+	{
+		// nothing is reloaded: instances join the sets of their meshes, full sets grow when the next frame lays them out
+		auto& meshes = _get_mesh_renderer();
+		timer t;
+		if(!_delivered.empty())
+		{
+			unsigned int removed = 0;
+			for(auto h : _delivered)
+			{
+				removed += meshes.remove_instance(h);
+			}
+			io::print("module delivery: removed", removed, "of", _delivered.size(), "geometries in", t.msec(), "ms");
+			_delivered.clear();
+			return;
+		}
+
+		const auto count = meshes.get_handle_count();
+		const auto first = count * 5 / 8;
+		const auto last = math::min(count, first + math::max(count / DELIVERY_FRACTION, 1u));
+		const auto offset = translation(vec3(DELIVERY_OFFSET, 0.0f, 0.0f));
+		auto center = vec3(0.0f);
+		for(auto h = first; h < last; ++h)
+		{
+			const auto transform = offset.mul(meshes.get_transform(h));
+			const auto handle = meshes.add_instance_of(h, transform.as_mat4());
+			if(handle != INVALID_INSTANCE)
+			{
+				_delivered.push_back(handle);
+				center = center + transform.as_mat4().get_translation();
+			}
+		}
+		if(_delivered.empty())
+		{
+			io::print("module delivery: no instanced geometries to copy");
+			return;
+		}
+
+		center = center * (1.0f / _delivered.size()) + vec3(0.0f, 0.0f, DELIVERY_MARKER_LIFT);
+		_delivered.push_back(meshes.add_sphere({DELIVERY_MARKER_RADIUS}, mat4::translation(center)));
+		io::print("module delivery: added", _delivered.size(), "geometries in", t.msec(), "ms,", meshes.get_layout_stats().pending_instances,
+				  "waiting for a slot,", meshes.get_unique_mesh_count(), "unique meshes");
+	}
+
+	void application::_build_hierarchy()
+	{
+		// zones and equipment are placed at their first geometry, which their rotations pivot around
+		auto& meshes = _get_mesh_renderer();
+		const auto count = meshes.get_handle_count();
+		const auto site = _hierarchy.add_node(NO_NODE, translation(vec3(0.0f)));
+		const auto zone_geometries = EQUIPMENT_GEOMETRIES * ZONE_EQUIPMENT;
+		for(unsigned int first = 0; first < count; first += zone_geometries)
+		{
+			const auto pivot = meshes.get_transform(first).as_mat4().get_translation();
+			const auto zone = _hierarchy.add_node(site, translation(pivot));
+			_zones.push_back(zone);
+			_zone_pivots.push_back(pivot);
+
+			for(auto e = first; e < math::min(count, first + zone_geometries); e += EQUIPMENT_GEOMETRIES)
+			{
+				const auto position = meshes.get_transform(e).as_mat4().get_translation();
+				const auto equipment = _hierarchy.add_node(zone, translation(position - pivot));
+				for(auto h = e; h < math::min(count, e + EQUIPMENT_GEOMETRIES); ++h)
+				{
+					_hierarchy.add_instance(equipment, h, meshes.get_transform(h));
+				}
+			}
+		}
+	}
+
+	void application::_benchmark_transform_update()
+	{
+		// instances per millisecond of one mat4 product per instance, of the kernel on one thread and on the pool
+		const auto& transforms = _get_mesh_renderer().get_transforms();
+		const unsigned int count = transforms.size();
+		vector<mat34> output(count);
+		const auto translation = mat4::translation(vec3(0.0f, 0.0f, MOVE_AMPLITUDE));
+		const mat34 delta(translation);
+
+		timer t_mat4;
+		for(unsigned int run = 0; run < BENCHMARK_RUNS; ++run)
+		{
+			for(unsigned int i = 0; i < count; ++i)
+			{
+				output[i] = mat34(translation.mul(transforms[i].as_mat4()));
+			}
+		}
+		const auto mat4_ms = t_mat4.sec() * 1000.0;
+
+		timer t_kernel;
+		for(unsigned int run = 0; run < BENCHMARK_RUNS; ++run)
+		{
+			apply_delta(delta, transforms.data(), output.data(), count);
+		}
+		const auto kernel_ms = t_kernel.sec() * 1000.0;
+
+		timer t_pool;
+		for(unsigned int run = 0; run < BENCHMARK_RUNS; ++run)
+		{
+			_thread_pool.parallel_for(count, MOVE_GROUP_SIZE * MOVE_GRAIN, [&](unsigned int first, unsigned int last)
+			{
+				apply_delta(delta, transforms.data() + first, output.data() + first, last - first);
+			});
+		}
+		const auto pool_ms = t_pool.sec() * 1000.0;
+
+		const double updated = static_cast<double>(count) * BENCHMARK_RUNS;
+		io::print("transform update of", count, "instances, per ms:");
+		io::print("  mat4:", updated / math::max(mat4_ms, 1e-3));
+		io::print(" ", get_transform_kernel_name(), "1 thread:", updated / math::max(kernel_ms, 1e-3));
+		io::print(" ", get_transform_kernel_name(), _thread_pool.get_thread_count(), "threads:", updated / math::max(pool_ms, 1e-3));
+	}
 } // namespace app
@@ -8,6 +8,10 @@
 #include <app/duplicate_instance_renderer.h>
 #include <app/parametric_instance_renderer.h>
 #include <app/combined_instance_renderer.h>
+#include <app/occlusion_buffer.h>
+#include <app/thread_pool.h>
+#include <app/transform_feed.h>
+#include <app/scene_hierarchy.h>
 
 namespace app
 {
@@ -20,6 +24,19 @@ namespace app
 		virtual bool initialize() override;
 		virtual bool finalize() override;
 
+	private:
+		duplicate_instance_renderer& _get_mesh_renderer();
+		parametric_instance_renderer& _get_parametric_renderer();
+		mat34* _move_objects();
+		void _move_module();
+		void _toggle_feed();
+		void _toggle_tracks();
+		void _cycle_selection();
+		void _refresh_overlay();
+		void _toggle_delivery();
+		void _build_hierarchy();
+		void _benchmark_transform_update();
+
 	private:
 		static_renderer _static_renderer;
 		cpu_instance_renderer _cpu_instance_renderer;
@@ -29,5 +46,35 @@ namespace app
 		parametric_instance_renderer _parametric_instance_renderer;
 		combined_instance_renderer _combined_instance_renderer;
 		glb::engine _engine;
+		base_renderer* _renderer = nullptr;
+		occlusion_buffer _occlusion_buffer;
+		bool _occlusion_culling = false;
+		unsigned int _frame = 0;
+		thread_pool _thread_pool;
+		bool _animate_module = false;
+		unsigned int _module_first = 0;
+		vector<mat34> _module_transforms;
+		vector<mat34> _module_frame;
+		transform_feed _feed;
+		feed_producer _feed_producer;
+		vector<instance_handle> _feed_handles;
+		vector<mat34> _feed_transforms;
+		scene_hierarchy _hierarchy;
+		vector<node_id> _zones;
+		vector<vec3> _zone_pivots;
+		bool _animate_hierarchy = false;
+		unsigned int _hierarchy_nodes = 0;
+		bool _animate_tracks = false;
+		timer _animation_timer;
+		unsigned int _selection_mode = 0;
+		bool _overlay = false;
+		unsigned int _overlay_frame = 0;
+		unsigned int _overlay_step = 0;
+		unsigned int _overlay_changed = 0;
+		vector<unsigned char> _overlay_values;
+		double _overlay_ms = 0.0;
+		vector<instance_handle> _delivered;
+		int _width = 1;
+		int _height = 1;
 	};
 } // namespace app
@@ -16,36 +16,40 @@ namespace app
 	// public
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 
-	void attrib_instance_renderer::add_box(const box& b, const mat4& transform)
+	instance_handle attrib_instance_renderer::add_box(const box& b, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= b.extents;
 		_box_vao_builder.add_instance_attribs(_transform_buffer_id, &t, 1);
 		++_box_count;
+		return INVALID_INSTANCE;
 	}
 
-	void attrib_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
+	instance_handle attrib_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(c.radius, c.radius, c.height);
 		_cylinder_vao_builder.add_instance_attribs(_transform_buffer_id, &t, 1);
 		++_cylinder_count;
+		return INVALID_INSTANCE;
 	}
 
-	void attrib_instance_renderer::add_dish(const dish& d, const mat4& transform)
+	instance_handle attrib_instance_renderer::add_dish(const dish& d, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(d.radius, d.radius, d.height);
 		_dish_vao_builder.add_instance_attribs(_transform_buffer_id, &t, 1);
 		++_dish_count;
+		return INVALID_INSTANCE;
 	}
 
-	void attrib_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
+	instance_handle attrib_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(s.radius, s.radius, s.radius);
 		_sphere_vao_builder.add_instance_attribs(_transform_buffer_id, &t, 1);
 		++_sphere_count;
+		return INVALID_INSTANCE;
 	}
 
 	void attrib_instance_renderer::end_upload()
@@ -9,10 +9,10 @@ namespace app
 	class attrib_instance_renderer : public app::base_renderer
 	{
 	public:
-		virtual void add_box(const box& b, const mat4& transform) override;
-		virtual void add_cylinder(const cylinder& c, const mat4& transform) override;
-		virtual void add_dish(const dish& d, const mat4& transform) override;
-		virtual void add_sphere(const sphere& s, const mat4& transform) override;
+		virtual instance_handle add_box(const box& b, const mat4& transform) override;
+		virtual instance_handle add_cylinder(const cylinder& c, const mat4& transform) override;
+		virtual instance_handle add_dish(const dish& d, const mat4& transform) override;
+		virtual instance_handle add_sphere(const sphere& s, const mat4& transform) override;
 		virtual void end_upload() override;
 
 		virtual bool initialize(glb::framebuffer& fbuffer, glb::camera& cam) override;
@@ -1,5 +1,52 @@
 #include <app/base_renderer.h>
+#include <glb/camera.h>
+#include <glb/framebuffer.h>
+#include <glb/shader_program_builder.h>
 
 namespace app
 {
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	bool begin_pass_program(glb::shader_program_builder& builder, const char* vertex_shader, const char* visibility_shader, render_pass pass)
+	{
+		const char* fragment_shaders[] = {"../shaders/per_pixel_lighting_color.frag", "../shaders/depth_only.frag", visibility_shader,
+										  "../shaders/per_pixel_lighting_wireframe.frag"};
+
+		builder.begin();
+		if(!builder.add_file(glb::shader_vertex, vertex_shader))
+		{
+			return false;
+		}
+		if(pass == render_pass_wireframe && !builder.add_file(glb::shader_geometry, "../shaders/wireframe.geom"))
+		{
+			return false;
+		}
+		return builder.add_file(glb::shader_fragment, fragment_shaders[pass]);
+	}
+
+	bool end_pass_program(glb::shader_program_builder& builder, render_pass pass, glb::framebuffer& fbuffer, glb::camera& cam, glb::shader_program& program)
+	{
+		if(pass == render_pass_color || pass == render_pass_wireframe)
+		{
+			builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
+		}
+		else if(pass == render_pass_visibility)
+		{
+			builder.bind_draw_buffer("out_visibility", 0);
+		}
+		if(!builder.end())
+		{
+			return false;
+		}
+		program = builder.get_shader_program();
+		program.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
+		if(pass == render_pass_wireframe)
+		{
+			program.set_uniform("tex_edges", EDGES_TEX_UNIT);
+			program.set_uniform("feature_edges", 0);
+		}
+		return true;
+	}
 } // namespace app
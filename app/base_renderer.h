@@ -1,27 +1,91 @@
 #pragma once
 #include <glb/irenderer.h>
 #include <app/geometries.h>
+#include <app/frustum.h>
+#include <app/transformation.h>
 #include <tess/triangle_mesh.h>
 
+namespace glb
+{
+	class shader_program_builder;
+	class shader_program;
+}
+
 namespace app
 {
+	// programs a renderer draws with: shaded color, depth only, object and primitive ids for a visibility buffer,
+	// or shaded color with triangle edges blended in
+	enum render_pass
+	{
+		render_pass_color,
+		render_pass_depth,
+		render_pass_visibility,
+		render_pass_wireframe
+	};
+
+	// edges drawn over the shaded scene
+	enum wireframe_mode
+	{
+		wireframe_off,
+		wireframe_all_edges,
+		wireframe_feature_edges
+	};
+
+	// per-triangle feature edge masks read by the wireframe geometry stage
+	static const int EDGES_TEX_UNIT = 7;
+
+	// starts the program of a pass around the vertex stage of a renderer: color programs shade, depth-only programs have an empty fragment stage,
+	// visibility programs write ids with visibility_shader and wireframe programs add barycentrics in a geometry stage
+	// the renderer binds its vertex attributes between this and end_pass_program
+	bool begin_pass_program(glb::shader_program_builder& builder, const char* vertex_shader, const char* visibility_shader, render_pass pass);
+
+	// binds the outputs of the pass and links it, then sets the camera and the edge masks, the remaining texture units are up to the renderer
+	bool end_pass_program(glb::shader_program_builder& builder, render_pass pass, glb::framebuffer& fbuffer, glb::camera& cam, glb::shader_program& program);
+
+	// ids written by the visibility pass, the top two bits tell how to find the color of the object
+	static const unsigned int VISIBILITY_MESH_INSTANCE = 0u << 30;
+	static const unsigned int VISIBILITY_MERGED_COLOR = 1u << 30;
+	static const unsigned int VISIBILITY_PARAMETRIC_TYPE = 2u << 30;
+	static const unsigned int VISIBILITY_BACKGROUND = 0xFFFFFFFFu;
+
+	// what a renderer does with instances whose projected radius is below its small feature threshold,
+	// points are too small to occlude anything and are left out of the depth pre-pass
+	enum small_feature_mode
+	{
+		small_feature_draw,
+		small_feature_cull,
+		small_feature_point
+	};
+
+	// names the geometry of one add_* call for later updates, stable from the call on
+	typedef unsigned int instance_handle;
+
+	// returned by renderers that bake their geometry and cannot address it afterwards
+	static const instance_handle INVALID_INSTANCE = 0xFFFFFFFFu;
+
 	class base_renderer : public glb::irenderer
 	{
 	public:
 		virtual void begin_upload(){}
 		virtual void set_current_color(unsigned char color_id){}
-		virtual void add_box(const box& b, const mat4& transform){}
-		virtual void add_circular_torus(const circular_torus& c, const mat4& transform){}
-		virtual void add_cone(const cone& c, const mat4& transform){}
-		virtual void add_cone_offset(const cone_offset& c, const mat4& transform){}
-		virtual void add_cylinder(const cylinder& c, const mat4& transform){}
-		virtual void add_cylinder_offset(const cylinder_offset& c, const mat4& transform){}
-		virtual void add_cylinder_slope(const cylinder_slope& c, const mat4& transform){}
-		virtual void add_dish(const dish& d, const mat4& transform){}
-		virtual void add_mesh(const tess::triangle_mesh& m, const mat4& transform){}
-		virtual void add_pyramid(const pyramid& p, const mat4& transform){}
-		virtual void add_rectangular_torus(const rectangular_torus& rt, const mat4& transform){}
-		virtual void add_sphere(const sphere& s, const mat4& transform){}
+		virtual instance_handle add_box(const box& b, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_circular_torus(const circular_torus& c, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_cone(const cone& c, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_cone_offset(const cone_offset& c, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_cylinder(const cylinder& c, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_cylinder_offset(const cylinder_offset& c, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_cylinder_slope(const cylinder_slope& c, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_dish(const dish& d, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_mesh(const tess::triangle_mesh& m, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_pyramid(const pyramid& p, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_rectangular_torus(const rectangular_torus& rt, const mat4& transform){ return INVALID_INSTANCE; }
+		virtual instance_handle add_sphere(const sphere& s, const mat4& transform){ return INVALID_INSTANCE; }
 		virtual void end_upload(){}
+		virtual void set_view(const frustum& f){}
+
+		// transform replaces the one given to add_*, both are O(1) and ignore handles the renderer cannot address
+		// the bounds of moved instances are refit before the next frame is culled, culling never sees a stale position
+		virtual void set_transform(instance_handle handle, const mat4& transform){}
+		virtual void set_color(instance_handle handle, unsigned char color_id){}
 	};
 } // namespace app
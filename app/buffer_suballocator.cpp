@@ -0,0 +1,66 @@
+#include <app/buffer_suballocator.h>
+#include <glb/opengl.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// a store grows by a quarter of its size, and never by less
+	static const unsigned int MIN_GROWTH_BYTES = 1024 * 1024;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void buffer_suballocator::adopt(unsigned int buffer, unsigned int used_bytes)
+	{
+		_buffer = buffer;
+		_used = used_bytes;
+		_capacity = used_bytes;
+		_grows = 0;
+	}
+
+	unsigned int buffer_suballocator::allocate(const void* data, unsigned int bytes, unsigned int alignment)
+	{
+		const auto offset = (_used + alignment - 1) / alignment * alignment;
+		if(offset + bytes > _capacity)
+		{
+			_grow(offset + bytes);
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		_used = offset + bytes;
+		return offset;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void buffer_suballocator::_grow(unsigned int min_bytes)
+	{
+		const auto capacity = math::max(min_bytes, _capacity + math::max(_capacity / 4, MIN_GROWTH_BYTES));
+
+		// 1. used bytes out to a scratch buffer
+		unsigned int scratch = 0;
+		glGenBuffers(1, &scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+		glBufferData(GL_COPY_WRITE_BUFFER, _used, nullptr, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, _used);
+
+		// 2. the store is re-specified under the same name and the bytes copied back
+		glBufferData(GL_COPY_READ_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+		glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, _used);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &scratch);
+		_capacity = capacity;
+		++_grows;
+	}
+} // namespace app
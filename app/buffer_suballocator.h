@@ -0,0 +1,32 @@
+#pragma once
+#include <bl/bl.h>
+
+namespace app
+{
+	// ranges of one OpenGL buffer handed out back to back, ranges are never given back
+	// a full store grows in place and keeps its name, so vertex arrays and buffer textures bound to it stay valid
+	class buffer_suballocator
+	{
+	public:
+		// takes over a buffer whose first used_bytes are already in use
+		void adopt(unsigned int buffer, unsigned int used_bytes);
+
+		// copies the bytes to a new range starting at a multiple of alignment, returns its offset
+		unsigned int allocate(const void* data, unsigned int bytes, unsigned int alignment);
+
+		unsigned int get_buffer() const { return _buffer; }
+		unsigned int get_used_bytes() const { return _used; }
+		unsigned int get_capacity() const { return _capacity; }
+
+		// times the store had to grow
+		unsigned int get_grow_count() const { return _grows; }
+
+	private:
+		void _grow(unsigned int min_bytes);
+
+		unsigned int _buffer = 0;
+		unsigned int _used = 0;
+		unsigned int _capacity = 0;
+		unsigned int _grows = 0;
+	};
+} // namespace app
@@ -0,0 +1,282 @@
+#include <app/bvh.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BVH_SSE 1
+#include <xmmintrin.h>
+#else
+#define BVH_SSE 0
+#endif
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static float component(const vec3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void bvh::build(const vector<bounding_sphere>& bounds, unsigned int leaf_size /*= BVH_LEAF_SIZE*/)
+	{
+		_nodes.clear();
+		_parents.clear();
+		_indices.resize(bounds.size());
+		_leaves.resize(bounds.size());
+		for(unsigned int i = 0; i < bounds.size(); ++i)
+		{
+			_indices[i] = i;
+		}
+
+		if(!bounds.empty())
+		{
+			_nodes.reserve(2 * bounds.size() / math::max(leaf_size, 1u) + 1);
+			_build(bounds, 0, 0, bounds.size(), math::max(leaf_size, 1u));
+		}
+		_marked.assign(_nodes.size(), 0);
+
+		// leaf tests read 4 slots at a time
+		const auto padded = bounds.size() + 3;
+		_x.assign(padded, 0.0f);
+		_y.assign(padded, 0.0f);
+		_z.assign(padded, 0.0f);
+		_radius.assign(padded, 0.0f);
+		_slots.resize(bounds.size());
+		for(unsigned int i = 0; i < bounds.size(); ++i)
+		{
+			const auto& b = bounds[_indices[i]];
+			_x[i] = b.center.x;
+			_y[i] = b.center.y;
+			_z[i] = b.center.z;
+			_radius[i] = b.radius;
+			_slots[_indices[i]] = i;
+		}
+	}
+
+	void bvh::refit(const vector<bounding_sphere>& bounds)
+	{
+		for(unsigned int i = 0; i < _indices.size(); ++i)
+		{
+			const auto& b = bounds[_indices[i]];
+			_x[i] = b.center.x;
+			_y[i] = b.center.y;
+			_z[i] = b.center.z;
+			_radius[i] = b.radius;
+		}
+
+		// children are stored after their parent, so a reverse walk visits them first
+		for(auto index = _nodes.size(); index-- > 0;)
+		{
+			_refit_node(index);
+		}
+		_refit_nodes = _nodes.size();
+	}
+
+	void bvh::refit(const vector<bounding_sphere>& bounds, const vector<unsigned int>& moved)
+	{
+		// 1. slots of the moved spheres, their leaves and the ancestors of those once each
+		_refit.clear();
+		for(auto index : moved)
+		{
+			if(index >= _slots.size())
+			{
+				continue;
+			}
+
+			const auto i = _slots[index];
+			const auto& b = bounds[index];
+			_x[i] = b.center.x;
+			_y[i] = b.center.y;
+			_z[i] = b.center.z;
+			_radius[i] = b.radius;
+
+			for(auto n = _leaves[i]; !_marked[n]; n = _parents[n])
+			{
+				_marked[n] = 1;
+				_refit.push_back(n);
+				if(n == 0)
+				{
+					break;
+				}
+			}
+		}
+
+		// 2. children before their parents, a parent always has the lower index
+		std::sort(_refit.begin(), _refit.end(), std::greater<unsigned int>());
+		for(auto n : _refit)
+		{
+			_refit_node(n);
+			_marked[n] = 0;
+		}
+		_refit_nodes = _refit.size();
+	}
+
+	unsigned int bvh::cull(const frustum& f, vector<unsigned int>& visible) const
+	{
+		const auto first = visible.size();
+		if(!_nodes.empty())
+		{
+			_cull(0, f, visible);
+		}
+		return visible.size() - first;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	unsigned int bvh::_build(const vector<bounding_sphere>& bounds, unsigned int parent, unsigned int first, unsigned int count, unsigned int leaf_size)
+	{
+		const unsigned int index = _nodes.size();
+		_nodes.push_back(node());
+		_parents.push_back(parent);
+
+		// 1. bounds of the spheres and of their centers
+		vec3 min(math::limit_posf()), max(math::limit_negf());
+		vec3 center_min(math::limit_posf()), center_max(math::limit_negf());
+		for(auto i = first; i < first + count; ++i)
+		{
+			const auto& b = bounds[_indices[i]];
+			min = vec3(math::min(min.x, b.center.x - b.radius), math::min(min.y, b.center.y - b.radius), math::min(min.z, b.center.z - b.radius));
+			max = vec3(math::max(max.x, b.center.x + b.radius), math::max(max.y, b.center.y + b.radius), math::max(max.z, b.center.z + b.radius));
+			center_min = vec3(math::min(center_min.x, b.center.x), math::min(center_min.y, b.center.y), math::min(center_min.z, b.center.z));
+			center_max = vec3(math::max(center_max.x, b.center.x), math::max(center_max.y, b.center.y), math::max(center_max.z, b.center.z));
+		}
+		_nodes[index].min = min;
+		_nodes[index].max = max;
+		_nodes[index].first = first;
+		_nodes[index].count = count;
+
+		if(count <= leaf_size)
+		{
+			for(auto i = first; i < first + count; ++i)
+			{
+				_leaves[i] = index;
+			}
+			return index;
+		}
+
+		// 2. split at the median center along the longest axis
+		const auto extent = center_max - center_min;
+		const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		const auto middle = first + count / 2;
+		std::nth_element(_indices.begin() + first, _indices.begin() + middle, _indices.begin() + first + count, [&](unsigned int a, unsigned int b)
+		{
+			return component(bounds[a].center, axis) < component(bounds[b].center, axis);
+		});
+
+		_build(bounds, index, first, middle - first, leaf_size);
+		const auto right = _build(bounds, index, middle, first + count - middle, leaf_size);
+		_nodes[index].right = right;
+		return index;
+	}
+
+	void bvh::_refit_node(unsigned int index)
+	{
+		auto& n = _nodes[index];
+		if(n.right == 0)
+		{
+			vec3 min(math::limit_posf()), max(math::limit_negf());
+			for(auto i = n.first; i < n.first + n.count; ++i)
+			{
+				min = vec3(math::min(min.x, _x[i] - _radius[i]), math::min(min.y, _y[i] - _radius[i]), math::min(min.z, _z[i] - _radius[i]));
+				max = vec3(math::max(max.x, _x[i] + _radius[i]), math::max(max.y, _y[i] + _radius[i]), math::max(max.z, _z[i] + _radius[i]));
+			}
+			n.min = min;
+			n.max = max;
+		}
+		else
+		{
+			const auto& left = _nodes[index + 1];
+			const auto& right = _nodes[n.right];
+			n.min = vec3(math::min(left.min.x, right.min.x), math::min(left.min.y, right.min.y), math::min(left.min.z, right.min.z));
+			n.max = vec3(math::max(left.max.x, right.max.x), math::max(left.max.y, right.max.y), math::max(left.max.z, right.max.z));
+		}
+	}
+
+	void bvh::_cull(unsigned int index, const frustum& f, vector<unsigned int>& visible) const
+	{
+		const auto& n = _nodes[index];
+		const auto c = f.classify_box(n.min, n.max);
+
+		if(c == containment_outside)
+		{
+			return;
+		}
+
+		// whole subtree visible, its spheres occupy a contiguous range of slots
+		if(c == containment_inside)
+		{
+			visible.insert(visible.end(), _indices.begin() + n.first, _indices.begin() + n.first + n.count);
+			return;
+		}
+
+		if(n.right == 0)
+		{
+			_cull_leaf(n, f, visible);
+			return;
+		}
+
+		_cull(index + 1, f, visible);
+		_cull(n.right, f, visible);
+	}
+
+	void bvh::_cull_leaf(const node& n, const frustum& f, vector<unsigned int>& visible) const
+	{
+		const auto last = n.first + n.count;
+
+#if BVH_SSE
+		__m128 nx[6], ny[6], nz[6], d[6];
+		for(int p = 0; p < 6; ++p)
+		{
+			const auto& pl = f.get_plane(p);
+			nx[p] = _mm_set1_ps(pl.normal.x);
+			ny[p] = _mm_set1_ps(pl.normal.y);
+			nz[p] = _mm_set1_ps(pl.normal.z);
+			d[p] = _mm_set1_ps(pl.distance);
+		}
+
+		// 4 spheres against the 6 planes at a time
+		for(auto i = n.first; i < last; i += 4)
+		{
+			const auto x = _mm_loadu_ps(&_x[i]);
+			const auto y = _mm_loadu_ps(&_y[i]);
+			const auto z = _mm_loadu_ps(&_z[i]);
+			const auto r = _mm_loadu_ps(&_radius[i]);
+
+			auto outside = _mm_setzero_ps();
+			for(int p = 0; p < 6; ++p)
+			{
+				const auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, nx[p]), _mm_mul_ps(y, ny[p])), _mm_add_ps(_mm_mul_ps(z, nz[p]), d[p]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+			}
+
+			auto mask = ~_mm_movemask_ps(outside) & 0xF;
+			if(last - i < 4)
+			{
+				mask &= (1 << (last - i)) - 1;
+			}
+			for(int lane = 0; lane < 4; ++lane)
+			{
+				if(mask & (1 << lane))
+				{
+					visible.push_back(_indices[i + lane]);
+				}
+			}
+		}
+#else
+		for(auto i = n.first; i < last; ++i)
+		{
+			if(!f.is_sphere_outside(vec3(_x[i], _y[i], _z[i]), _radius[i]))
+			{
+				visible.push_back(_indices[i]);
+			}
+		}
+#endif
+	}
+} // namespace app
@@ -0,0 +1,63 @@
+#pragma once
+#include <app/frustum.h>
+
+namespace app
+{
+	static const unsigned int BVH_LEAF_SIZE = 8;
+
+	// bounding volume hierarchy over instance bounding spheres for frustum culling
+	class bvh
+	{
+	public:
+		void build(const vector<bounding_sphere>& bounds, unsigned int leaf_size = BVH_LEAF_SIZE);
+
+		// takes moved spheres and grows or shrinks the node boxes to them, keeping the tree topology
+		void refit(const vector<bounding_sphere>& bounds);
+
+		// same for the given spheres only, just the leaves holding them and their ancestors are recomputed
+		void refit(const vector<bounding_sphere>& bounds, const vector<unsigned int>& moved);
+
+		// appends the indices of the spheres not outside the frustum, returns how many were appended
+		unsigned int cull(const frustum& f, vector<unsigned int>& visible) const;
+
+		unsigned int get_node_count() const { return _nodes.size(); }
+
+		// nodes recomputed by the last refit
+		unsigned int get_refit_node_count() const { return _refit_nodes; }
+
+	private:
+		// nodes are stored depth first, the left child of an inner node follows it
+		struct node
+		{
+			vec3 min;
+			unsigned int first = 0;
+			vec3 max;
+			unsigned int count = 0;
+			unsigned int right = 0;
+		};
+
+		unsigned int _build(const vector<bounding_sphere>& bounds, unsigned int parent, unsigned int first, unsigned int count, unsigned int leaf_size);
+		void _refit_node(unsigned int index);
+		void _cull(unsigned int index, const frustum& f, vector<unsigned int>& visible) const;
+		void _cull_leaf(const node& n, const frustum& f, vector<unsigned int>& visible) const;
+
+		vector<node> _nodes;
+		vector<unsigned int> _parents;
+
+		// sphere index and bounds of each leaf slot, bounds as structure of arrays padded for 4-wide tests
+		vector<unsigned int> _indices;
+		vector<float> _x;
+		vector<float> _y;
+		vector<float> _z;
+		vector<float> _radius;
+
+		// leaf slot of each sphere and leaf node of each slot, for refitting moved spheres only
+		vector<unsigned int> _slots;
+		vector<unsigned int> _leaves;
+
+		// nodes to recompute, and whether a node is already among them
+		vector<unsigned int> _refit;
+		vector<unsigned char> _marked;
+		unsigned int _refit_nodes = 0;
+	};
+} // namespace app
@@ -1,66 +1,95 @@
 #include <app/combined_instance_renderer.h>
+#include <glb/framebuffer.h>
+#include <glb/shader_program_builder.h>
 #include <glb/opengl.h>
 
 namespace app
 {
-	void combined_instance_renderer::add_box(const box& b, const mat4& transform)
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// color ids, palette and instance flags stay on the units duplicate_instance_renderer binds them to
+	static const int COLOR_IDS_TEX_UNIT = 1;
+	static const int COLORS_TEX_UNIT = 2;
+	static const int FLAGS_TEX_UNIT = 8;
+	static const int VISIBILITY_TEX_UNIT = 3;
+	static const int DEPTH_TEX_UNIT = 4;
+	static const int RESOLVE_TEX_UNIT = 5;
+
+	static const instance_handle PARAMETRIC_HANDLE = 1u << 31;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static instance_handle tag_parametric(instance_handle handle)
+	{
+		return handle == INVALID_INSTANCE ? handle : handle | PARAMETRIC_HANDLE;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	instance_handle combined_instance_renderer::add_box(const box& b, const mat4& transform)
 	{
-		_parametric_renderer.add_box(b, transform);
+		return tag_parametric(_parametric_renderer.add_box(b, transform));
 	}
 
-	void combined_instance_renderer::add_circular_torus(const circular_torus& c, const mat4& transform)
+	instance_handle combined_instance_renderer::add_circular_torus(const circular_torus& c, const mat4& transform)
 	{
-		_parametric_renderer.add_circular_torus(c, transform);
+		return tag_parametric(_parametric_renderer.add_circular_torus(c, transform));
 	}
 
-	void combined_instance_renderer::add_cone(const cone& c, const mat4& transform)
+	instance_handle combined_instance_renderer::add_cone(const cone& c, const mat4& transform)
 	{
-		_parametric_renderer.add_cone(c, transform);
+		return tag_parametric(_parametric_renderer.add_cone(c, transform));
 	}
 
-	void combined_instance_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
+	instance_handle combined_instance_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
 	{
-		_parametric_renderer.add_cone_offset(c, transform);
+		return tag_parametric(_parametric_renderer.add_cone_offset(c, transform));
 	}
 
-	void combined_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
+	instance_handle combined_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
 	{
-		_parametric_renderer.add_cylinder(c, transform);
+		return tag_parametric(_parametric_renderer.add_cylinder(c, transform));
 	}
 
-	void combined_instance_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
+	instance_handle combined_instance_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
 	{
-		_parametric_renderer.add_cylinder_offset(c, transform);
+		return tag_parametric(_parametric_renderer.add_cylinder_offset(c, transform));
 	}
 
-	void combined_instance_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
+	instance_handle combined_instance_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
 	{
-		_parametric_renderer.add_cylinder_slope(c, transform);
+		return tag_parametric(_parametric_renderer.add_cylinder_slope(c, transform));
 	}
 
-	void combined_instance_renderer::add_dish(const dish& d, const mat4& transform)
+	instance_handle combined_instance_renderer::add_dish(const dish& d, const mat4& transform)
 	{
-		_parametric_renderer.add_dish(d, transform);
+		return tag_parametric(_parametric_renderer.add_dish(d, transform));
 	}
 
-	void combined_instance_renderer::add_pyramid(const pyramid& p, const mat4& transform)
+	instance_handle combined_instance_renderer::add_pyramid(const pyramid& p, const mat4& transform)
 	{
-		_parametric_renderer.add_pyramid(p, transform);
+		return tag_parametric(_parametric_renderer.add_pyramid(p, transform));
 	}
 
-	void combined_instance_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
+	instance_handle combined_instance_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
 	{
-		_parametric_renderer.add_rectangular_torus(rt, transform);
+		return tag_parametric(_parametric_renderer.add_rectangular_torus(rt, transform));
 	}
 
-	void combined_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
+	instance_handle combined_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
 	{
-		_parametric_renderer.add_sphere(s, transform);
+		return tag_parametric(_parametric_renderer.add_sphere(s, transform));
 	}
 
-	void combined_instance_renderer::add_mesh(const tess::triangle_mesh& m, const mat4& transform)
+	instance_handle combined_instance_renderer::add_mesh(const tess::triangle_mesh& m, const mat4& transform)
 	{
-		_mesh_renderer.add_mesh(m, transform);
+		return _mesh_renderer.add_mesh(m, transform);
 	}
 
 	void combined_instance_renderer::end_upload()
@@ -69,6 +98,33 @@ namespace app
 		_parametric_renderer.end_upload();
 	}
 
+	void combined_instance_renderer::set_view(const frustum& f)
+	{
+		_frustum = f;
+		_mesh_renderer.set_view(f);
+		_parametric_renderer.set_view(f);
+	}
+
+	void combined_instance_renderer::set_transform(instance_handle handle, const mat4& transform)
+	{
+		if(handle != INVALID_INSTANCE && (handle & PARAMETRIC_HANDLE))
+		{
+			_parametric_renderer.set_transform(handle & ~PARAMETRIC_HANDLE, transform);
+			return;
+		}
+		_mesh_renderer.set_transform(handle, transform);
+	}
+
+	void combined_instance_renderer::set_color(instance_handle handle, unsigned char color_id)
+	{
+		// parametric primitives keep the color of their type
+		if(handle != INVALID_INSTANCE && (handle & PARAMETRIC_HANDLE))
+		{
+			return;
+		}
+		_mesh_renderer.set_color(handle, color_id);
+	}
+
 	bool combined_instance_renderer::initialize(glb::framebuffer& fbuffer, glb::camera& cam)
 	{
 		if(!_mesh_renderer.initialize(fbuffer, cam))
@@ -79,6 +135,41 @@ namespace app
 		{
 			return false;
 		}
+		glGenQueries(1, &_samples_query);
+
+		glb::shader_program_builder shader_builder;
+		shader_builder.begin();
+		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/fullscreen_triangle.vert"))
+		{
+			return false;
+		}
+		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/visibility_resolve.frag"))
+		{
+			return false;
+		}
+		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
+		if(!shader_builder.end())
+		{
+			return false;
+		}
+		_resolve_shader = shader_builder.get_shader_program();
+		_resolve_shader.set_uniform("tex_visibility", VISIBILITY_TEX_UNIT);
+		_resolve_shader.set_uniform("tex_depth", DEPTH_TEX_UNIT);
+		_resolve_shader.set_uniform("tex_colorIDs", COLOR_IDS_TEX_UNIT);
+		_resolve_shader.set_uniform("tex_colors", COLORS_TEX_UNIT);
+		_resolve_shader.set_uniform("tex_resolve", RESOLVE_TEX_UNIT);
+		_resolve_shader.set_uniform("tex_flags", FLAGS_TEX_UNIT);
+
+		glGenBuffers(1, &_resolve_buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, _resolve_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, (1 + PRIMITIVE_TYPES) * 4 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+		glGenTextures(1, &_resolve_texture);
+		glBindTexture(GL_TEXTURE_BUFFER, _resolve_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _resolve_buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glGenVertexArrays(1, &_fullscreen_vao);
 		return true;
 	}
 
@@ -92,30 +183,261 @@ namespace app
 		{
 			return false;
 		}
+		glDeleteQueries(1, &_samples_query);
+		glDeleteFramebuffers(1, &_visibility_fbo);
+		glDeleteTextures(1, &_visibility_texture);
+		glDeleteTextures(1, &_depth_texture);
+		glDeleteTextures(1, &_resolve_texture);
+		glDeleteBuffers(1, &_resolve_buffer);
+		glDeleteVertexArrays(1, &_fullscreen_vao);
 		return true;
 	}
 
-#define WIREFRAME 0
+	duplicate_instance_renderer& combined_instance_renderer::get_mesh_renderer()
+	{
+		return _mesh_renderer;
+	}
+
+	parametric_instance_renderer& combined_instance_renderer::get_parametric_renderer()
+	{
+		return _parametric_renderer;
+	}
+
+	void combined_instance_renderer::set_depth_prepass(bool enabled)
+	{
+		_depth_prepass = enabled;
+	}
+
+	bool combined_instance_renderer::get_depth_prepass() const
+	{
+		return _depth_prepass;
+	}
+
+	void combined_instance_renderer::set_front_to_back(bool enabled)
+	{
+		_mesh_renderer.set_front_to_back(enabled);
+		_parametric_renderer.set_front_to_back(enabled);
+	}
+
+	bool combined_instance_renderer::get_front_to_back() const
+	{
+		return _mesh_renderer.get_front_to_back();
+	}
+
+	unsigned int combined_instance_renderer::get_shaded_samples() const
+	{
+		return _shaded_samples;
+	}
+
+	float combined_instance_renderer::get_overdraw() const
+	{
+		return static_cast<float>(_shaded_samples) / _viewport_pixels;
+	}
+
+	void combined_instance_renderer::set_visibility_buffer(bool enabled)
+	{
+		_visibility_buffer = enabled;
+	}
+
+	bool combined_instance_renderer::get_visibility_buffer() const
+	{
+		return _visibility_buffer;
+	}
+
+	void combined_instance_renderer::set_wireframe_mode(wireframe_mode mode)
+	{
+		_wireframe_mode = mode;
+		_mesh_renderer.set_feature_edges(mode == wireframe_feature_edges);
+		_parametric_renderer.set_feature_edges(mode == wireframe_feature_edges);
+	}
+
+	wireframe_mode combined_instance_renderer::get_wireframe_mode() const
+	{
+		return _wireframe_mode;
+	}
 
 	void combined_instance_renderer::render()
 	{
-#if WIREFRAME
+		if(_visibility_buffer)
+		{
+			_render_visibility();
+			return;
+		}
+
+		// 1. lay down depth without shading, then shade only the nearest surface
+		if(_depth_prepass)
+		{
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			_mesh_renderer.render_depth();
+			_parametric_renderer.render_depth();
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthFunc(GL_LEQUAL);
+			glDepthMask(GL_FALSE);
+		}
+
+		// 2. the previous query is read only once available, a new one starts after that
+		if(_query_pending)
+		{
+			unsigned int available = 0;
+			glGetQueryObjectuiv(_samples_query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if(available)
+			{
+				glGetQueryObjectuiv(_samples_query, GL_QUERY_RESULT, &_shaded_samples);
+				_query_pending = false;
+			}
+		}
+
+		const auto measure = !_query_pending;
+		if(measure)
+		{
+			int viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			_viewport_pixels = math::max(viewport[2] * viewport[3], 1);
+			glBeginQuery(GL_SAMPLES_PASSED, _samples_query);
+		}
+
+		if(_wireframe_mode != wireframe_off)
+		{
+			_mesh_renderer.render_wireframe();
+			_parametric_renderer.render_wireframe();
+		}
+		else
+		{
+			_mesh_renderer.render();
+			_parametric_renderer.render();
+		}
+
+		if(measure)
+		{
+			glEndQuery(GL_SAMPLES_PASSED);
+			_query_pending = true;
+		}
+
+		if(_depth_prepass)
+		{
+			glDepthMask(GL_TRUE);
+			glDepthFunc(GL_LESS);
+		}
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void combined_instance_renderer::_render_visibility()
+	{
+		int viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		int draw_framebuffer = 0;
+		int read_framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_framebuffer);
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+
+		if(!_resize_visibility_buffer(viewport[2], viewport[3]))
+		{
+			return;
+		}
+
+		// 1. ids and depth of the nearest surface, nothing is shaded
+		glBindFramebuffer(GL_FRAMEBUFFER, _visibility_fbo);
+		glViewport(0, 0, viewport[2], viewport[3]);
+		const unsigned int background[4] = {VISIBILITY_BACKGROUND, 0, 0, 0};
+		glClearBufferuiv(GL_COLOR, 0, background);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		_mesh_renderer.render_visibility();
+		_parametric_renderer.render_visibility();
+
+		// 2. one shaded fragment per covered pixel, depth is carried over for later passes
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		_update_resolve_constants();
+		_resolve_shader.bind();
+		_mesh_renderer.bind_color_textures();
+		glActiveTexture(GL_TEXTURE0 + VISIBILITY_TEX_UNIT);
+		glBindTexture(GL_TEXTURE_2D, _visibility_texture);
+		glActiveTexture(GL_TEXTURE0 + DEPTH_TEX_UNIT);
+		glBindTexture(GL_TEXTURE_2D, _depth_texture);
+		glActiveTexture(GL_TEXTURE0 + RESOLVE_TEX_UNIT);
+		glBindTexture(GL_TEXTURE_BUFFER, _resolve_texture);
+
+		glDepthFunc(GL_ALWAYS);
+		glBindVertexArray(_fullscreen_vao);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
 		glDepthFunc(GL_LESS);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-#endif
-
-		_mesh_renderer.render();
-		_parametric_renderer.render();
-
-#if WIREFRAME
-		glDepthFunc(GL_LEQUAL);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glPolygonOffset(-1, -1);
-		glEnable(GL_POLYGON_OFFSET_LINE);
-		glLineWidth(2.0f);
-		_mesh_renderer.render_color(vec3::ZERO);
-		_parametric_renderer.render_color(vec3::ZERO);
-		glEnable(GL_POLYGON_OFFSET_LINE);
-#endif
+
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glActiveTexture(GL_TEXTURE0 + DEPTH_TEX_UNIT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0 + VISIBILITY_TEX_UNIT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	bool combined_instance_renderer::_resize_visibility_buffer(int width, int height)
+	{
+		if(width == _visibility_width && height == _visibility_height)
+		{
+			return true;
+		}
+
+		if(_visibility_fbo == 0)
+		{
+			glGenFramebuffers(1, &_visibility_fbo);
+			glGenTextures(1, &_visibility_texture);
+			glGenTextures(1, &_depth_texture);
+		}
+
+		// integer ids are fetched per pixel, never filtered
+		glBindTexture(GL_TEXTURE_2D, _visibility_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, width, height, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		glBindTexture(GL_TEXTURE_2D, _depth_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, _visibility_fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _visibility_texture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _depth_texture, 0);
+		const GLenum draw_buffer = GL_COLOR_ATTACHMENT0;
+		glDrawBuffers(1, &draw_buffer);
+		const auto complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		if(!complete)
+		{
+			_visibility_buffer = false;
+			return false;
+		}
+
+		_visibility_width = width;
+		_visibility_height = height;
+		return true;
+	}
+
+	void combined_instance_renderer::_update_resolve_constants()
+	{
+		// projection terms to rebuild eye positions from depth, then the parametric type colors
+		const auto& p = _frustum.get_projection();
+		float constants[(1 + PRIMITIVE_TYPES) * 4] = {p.at(0,0), p.at(1,1), p.at(2,2), p.at(2,3)};
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
+		{
+			const auto& color = _parametric_renderer.get_type_color(static_cast<primitive_type>(type));
+			constants[4 + type*4 + 0] = color.x;
+			constants[4 + type*4 + 1] = color.y;
+			constants[4 + type*4 + 2] = color.z;
+			constants[4 + type*4 + 3] = 1.0f;
+		}
+
+		glBindBuffer(GL_TEXTURE_BUFFER, _resolve_buffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(constants), constants);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
 	}
 }
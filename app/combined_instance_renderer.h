@@ -7,26 +7,80 @@ namespace app
 	class combined_instance_renderer : public app::base_renderer
 	{
 	public:
-		virtual void add_box(const box& b, const mat4& transform) override;
-		virtual void add_circular_torus(const circular_torus& c, const mat4& transform) override;
-		virtual void add_cone(const cone& c, const mat4& transform) override;
-		virtual void add_cone_offset(const cone_offset& c, const mat4& transform) override;
-		virtual void add_cylinder(const cylinder& c, const mat4& transform) override;
-		virtual void add_cylinder_offset(const cylinder_offset& c, const mat4& transform) override;
-		virtual void add_cylinder_slope(const cylinder_slope& c, const mat4& transform) override;
-		virtual void add_dish(const dish& d, const mat4& transform) override;
-		virtual void add_pyramid(const pyramid& p, const mat4& transform) override;
-		virtual void add_rectangular_torus(const rectangular_torus& rt, const mat4& transform) override;
-		virtual void add_sphere(const sphere& s, const mat4& transform) override;
-		virtual void add_mesh(const tess::triangle_mesh& m, const mat4& transform) override;
+		virtual instance_handle add_box(const box& b, const mat4& transform) override;
+		virtual instance_handle add_circular_torus(const circular_torus& c, const mat4& transform) override;
+		virtual instance_handle add_cone(const cone& c, const mat4& transform) override;
+		virtual instance_handle add_cone_offset(const cone_offset& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder(const cylinder& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder_offset(const cylinder_offset& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder_slope(const cylinder_slope& c, const mat4& transform) override;
+		virtual instance_handle add_dish(const dish& d, const mat4& transform) override;
+		virtual instance_handle add_pyramid(const pyramid& p, const mat4& transform) override;
+		virtual instance_handle add_rectangular_torus(const rectangular_torus& rt, const mat4& transform) override;
+		virtual instance_handle add_sphere(const sphere& s, const mat4& transform) override;
+		virtual instance_handle add_mesh(const tess::triangle_mesh& m, const mat4& transform) override;
 		virtual void end_upload() override;
+		virtual void set_view(const frustum& f) override;
+
+		// handles of parametric primitives carry a tag bit over the handle of the parametric renderer, set_color ignores them
+		virtual void set_transform(instance_handle handle, const mat4& transform) override;
+		virtual void set_color(instance_handle handle, unsigned char color_id) override;
 
 		virtual bool initialize(glb::framebuffer& fbuffer, glb::camera& cam) override;
 		virtual bool finalize() override;
 		virtual void render() override;
 
+		duplicate_instance_renderer& get_mesh_renderer();
+		parametric_instance_renderer& get_parametric_renderer();
+
+		// depth-only pass of both renderers before shading, so that each pixel is shaded about once
+		void set_depth_prepass(bool enabled);
+		bool get_depth_prepass() const;
+
+		// both renderers draw nearest first
+		void set_front_to_back(bool enabled);
+		bool get_front_to_back() const;
+
+		// samples that passed the depth test in the shading pass, read back one or more frames late
+		unsigned int get_shaded_samples() const;
+
+		// shaded samples per viewport pixel
+		float get_overdraw() const;
+
+		// geometry writes only object and primitive ids, a full-screen pass then shades each pixel once
+		void set_visibility_buffer(bool enabled);
+		bool get_visibility_buffer() const;
+
+		// edges are blended over the shading by the same draws, no second line pass
+		void set_wireframe_mode(wireframe_mode mode);
+		wireframe_mode get_wireframe_mode() const;
+
 	private:
+		void _render_visibility();
+		bool _resize_visibility_buffer(int width, int height);
+		void _update_resolve_constants();
+
 		duplicate_instance_renderer _mesh_renderer;
 		parametric_instance_renderer _parametric_renderer;
+
+		bool _depth_prepass = false;
+		wireframe_mode _wireframe_mode = wireframe_off;
+		unsigned int _samples_query = 0;
+		bool _query_pending = false;
+		unsigned int _shaded_samples = 0;
+		unsigned int _viewport_pixels = 1;
+
+		// visibility buffer: ids and depth of the nearest surface, resolved to color in one pass
+		bool _visibility_buffer = false;
+		frustum _frustum;
+		glb::shader_program _resolve_shader;
+		unsigned int _visibility_fbo = 0;
+		unsigned int _visibility_texture = 0;
+		unsigned int _depth_texture = 0;
+		int _visibility_width = 0;
+		int _visibility_height = 0;
+		unsigned int _resolve_buffer = 0;
+		unsigned int _resolve_texture = 0;
+		unsigned int _fullscreen_vao = 0;
 	};
 }
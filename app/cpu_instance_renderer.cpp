@@ -20,32 +20,36 @@ namespace app
 	// public
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 
-	void cpu_instance_renderer::add_box(const box& b, const mat4& transform)
+	instance_handle cpu_instance_renderer::add_box(const box& b, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= b.extents;
 		_box_transforms.push_back(t);
+		return INVALID_INSTANCE;
 	}
 
-	void cpu_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
+	instance_handle cpu_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(c.radius, c.radius, c.height);
 		_cylinder_transforms.push_back(t);
+		return INVALID_INSTANCE;
 	}
 
-	void cpu_instance_renderer::add_dish(const dish& d, const mat4& transform)
+	instance_handle cpu_instance_renderer::add_dish(const dish& d, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(d.radius, d.radius, d.height);
 		_dish_transforms.push_back(t);
+		return INVALID_INSTANCE;
 	}
 
-	void cpu_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
+	instance_handle cpu_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(s.radius, s.radius, s.radius);
 		_sphere_transforms.push_back(t);
+		return INVALID_INSTANCE;
 	}
 
 	bool cpu_instance_renderer::initialize(glb::framebuffer& fbuffer, glb::camera& cam)
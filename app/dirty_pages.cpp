@@ -0,0 +1,80 @@
+#include <app/dirty_pages.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void dirty_pages::resize(unsigned int bytes)
+	{
+		_bytes = bytes;
+		const auto pages = (bytes + DIRTY_PAGE_BYTES - 1) / DIRTY_PAGE_BYTES;
+		_bits.assign((pages + 63) / 64, 0);
+		_first = ~0u;
+		_last = 0;
+	}
+
+	void dirty_pages::mark(unsigned int offset, unsigned int size)
+	{
+		if(size == 0 || offset >= _bytes)
+		{
+			return;
+		}
+
+		const auto first = offset / DIRTY_PAGE_BYTES;
+		const auto last = (math::min(offset + size, _bytes) - 1) / DIRTY_PAGE_BYTES;
+		for(auto page = first; page <= last; ++page)
+		{
+			_bits[page / 64] |= bl::uint64(1) << (page % 64);
+		}
+		_first = math::min(_first, first);
+		_last = math::max(_last, last);
+	}
+
+	unsigned int dirty_pages::take_ranges(vector<byte_range>& ranges)
+	{
+		if(!is_dirty())
+		{
+			return 0;
+		}
+
+		// runs of set bits become one range each, clean words are skipped whole
+		unsigned int bytes = 0;
+		unsigned int run_first = 0;
+		bool in_run = false;
+		for(auto page = _first; page <= _last + 1; ++page)
+		{
+			const auto word = page / 64;
+			if(page <= _last && !in_run && page % 64 == 0 && _bits[word] == 0)
+			{
+				page += 63;
+				continue;
+			}
+
+			const auto dirty = page <= _last && (_bits[word] >> (page % 64)) & 1;
+			if(dirty && !in_run)
+			{
+				run_first = page;
+				in_run = true;
+			}
+			else if(!dirty && in_run)
+			{
+				byte_range r;
+				r.offset = run_first * DIRTY_PAGE_BYTES;
+				r.size = math::min(page * DIRTY_PAGE_BYTES, _bytes) - r.offset;
+				ranges.push_back(r);
+				bytes += r.size;
+				in_run = false;
+			}
+		}
+
+		for(auto word = _first / 64; word <= _last / 64; ++word)
+		{
+			_bits[word] = 0;
+		}
+		_first = ~0u;
+		_last = 0;
+		return bytes;
+	}
+} // namespace app
@@ -0,0 +1,37 @@
+#pragma once
+#include <bl/bl.h>
+
+namespace app
+{
+	static const unsigned int DIRTY_PAGE_BYTES = 4096;
+
+	struct byte_range
+	{
+		unsigned int offset = 0;
+		unsigned int size = 0;
+	};
+
+	// pages of a buffer written on the CPU since its last upload, taken as ranges of consecutive dirty pages
+	class dirty_pages
+	{
+	public:
+		// clears every page
+		void resize(unsigned int bytes);
+
+		void mark(unsigned int offset, unsigned int size);
+		bool is_dirty() const { return _first <= _last; }
+
+		// appends the coalesced dirty ranges clamped to the buffer size, clears them and returns their bytes
+		unsigned int take_ranges(vector<byte_range>& ranges);
+
+		unsigned int get_size_bytes() const { return _bytes; }
+
+	private:
+		vector<bl::uint64> _bits;
+		unsigned int _bytes = 0;
+
+		// lowest and highest dirty page, bound the scan of take_ranges
+		unsigned int _first = ~0u;
+		unsigned int _last = 0;
+	};
+} // namespace app
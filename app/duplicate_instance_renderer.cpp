@@ -1,4 +1,5 @@
 #include <app/duplicate_instance_renderer.h>
+#include <app/mesh_optimizer.h>
 #include <glb/camera.h>
 #include <glb/framebuffer.h>
 #include <glb/shader_program_builder.h>
@@ -20,6 +21,15 @@ namespace app
 		EigenMat3 basis;
 	};
 
+	// remapping carries every vertex, so only meshes with as many vertices share a topology
+	struct topology
+	{
+		unsigned int first_element = 0;
+		unsigned int vertex_count = 0;
+		vector<tess::element> source_elements;
+		vector<unsigned int> vertex_remap;
+	};
+
 	struct bbox
 	{
 		vec3 min = vec3(math::limit_posf());
@@ -45,9 +55,39 @@ namespace app
 	static const unsigned int MAX_BUFFER_SIZE_BYTES = 5 * 1024 * 1024;
 	static const double EPSILON = 1e-3;
 	static const int TRANSFORM_TEX_UNIT = 0;
-	static const int TEX_OFFSET_ATTRIB = 5;
+	static const int INSTANCE_ATTRIB = 5;
 	static const int COLOR_IDS_TEX_UNIT = 1;
 	static const int COLORS_TEX_UNIT = 2;
+	static const unsigned int MIN_MESHLET_TRIANGLES = 4 * MESHLET_MAX_TRIANGLES;
+	static const unsigned int MIN_LOD_TRIANGLES = 64;
+	static const unsigned int LOD_MAX_GRID_RESOLUTION = 32;
+	static const float LOD_MIN_REDUCTION = 0.6f;
+	static const float LOD_PIXEL_ERROR = 1.0f;
+
+	// without indirect submission each visible meshlet range of an instance is a call, past this many the instance is drawn whole
+	static const unsigned int MAX_MESHLET_RANGES = 4;
+
+	// dihedral angle above which a shared edge is a feature edge of the wireframe
+	static const float FEATURE_CREASE_ANGLE = math::to_radians(30.0f);
+	static const unsigned char UNKNOWN_EDGES = 0xFF;
+
+	// instances with a larger world radius are candidate occluders, in model units
+	static const float OCCLUDER_MIN_RADIUS = 2.0f;
+	static const float OCCLUDER_MIN_PIXELS = 32.0f;
+	static const unsigned int OCCLUDER_MAX_TRIANGLES = 512;
+	static const unsigned int MAX_OCCLUDERS = 64;
+
+	// consecutive instances of a set in morton order that are culled and drawn together
+	static const unsigned int INSTANCE_RANGE_SIZE = 64;
+	static const unsigned int MORTON_BITS = 10;
+
+	static const unsigned int MERGED_BATCH_MAX_VERTICES = 64 * 1024;
+
+	// keyframe tracks, texel offsets are stored as floats and stay exact below 2^24 texels
+	static const int ANIMATION_TEX_UNIT = 6;
+
+	// instance flags, past the units the combined renderer resolves with
+	static const int FLAGS_TEX_UNIT = 8;
 
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// helper functions
@@ -159,6 +199,150 @@ namespace app
 				abs(i.coeff(3,0) - 0.0) <= EPS && abs(i.coeff(3,1) - 0.0) <= EPS && abs(i.coeff(3,2) - 0.0) <= EPS && abs(i.coeff(3,3) - 1.0) <= EPS;
 	}
 
+	static size_t hash_elements(const vector<tess::element>& elements)
+	{
+		// FNV-1a over the raw index list
+		size_t h = 2166136261u;
+		for(const auto e : elements)
+		{
+			h = (h ^ e) * 16777619u;
+		}
+		return h ^ elements.size();
+	}
+
+	static unsigned int add_shared_elements(const vector<tess::element>& src, vector<tess::element>& elements, hash_multimap<size_t, unsigned int>& ranges)
+	{
+		const auto h = hash_elements(src);
+		auto range = ranges.equal_range(h);
+		for(auto r = range.first; r != range.second; ++r)
+		{
+			if(r->second + src.size() <= elements.size() && std::equal(src.begin(), src.end(), elements.begin() + r->second))
+			{
+				return r->second;
+			}
+		}
+
+		const unsigned int first_element = elements.size();
+		elements.insert(elements.end(), src.begin(), src.end());
+		ranges.emplace(h, first_element);
+		return first_element;
+	}
+
+	// spreads the low 10 bits of v so that two zero bits follow each of them
+	static unsigned int expand_bits(unsigned int v)
+	{
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+
+	static unsigned int quantize(float value, float min, float extent)
+	{
+		const auto max_value = static_cast<float>((1u << MORTON_BITS) - 1);
+		return extent > 0.0f ? static_cast<unsigned int>(math::min(math::max((value - min) / extent, 0.0f), 1.0f) * max_value) : 0u;
+	}
+
+	static unsigned int morton_code(const vec3& p, const bbox& bounds)
+	{
+		const auto extent = bounds.max - bounds.min;
+		return (expand_bits(quantize(p.x, bounds.min.x, extent.x)) << 2) |
+			   (expand_bits(quantize(p.y, bounds.min.y, extent.y)) << 1) |
+				expand_bits(quantize(p.z, bounds.min.z, extent.z));
+	}
+
+	static bounding_sphere enclosing_sphere(const bounding_sphere* spheres, unsigned int count)
+	{
+		bbox box;
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			box.expand(spheres[i].center);
+		}
+
+		bounding_sphere b;
+		b.center = (box.min + box.max) * 0.5f;
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			const auto d = spheres[i].center - b.center;
+			b.radius = math::max(b.radius, std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z) + spheres[i].radius);
+		}
+		return b;
+	}
+
+	// sends the dirty ranges of one stream and clears them, returns the bytes sent
+	static unsigned int upload_ranges(unsigned int buffer, dirty_pages& pages, const void* data, vector<byte_range>& ranges)
+	{
+		ranges.clear();
+		const auto bytes = pages.take_ranges(ranges);
+		if(ranges.empty())
+		{
+			return 0;
+		}
+
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		for(const auto& r : ranges)
+		{
+			glBufferSubData(GL_TEXTURE_BUFFER, r.offset, r.size, static_cast<const char*>(data) + r.offset);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		return bytes;
+	}
+
+	// gives a stream viewed by a buffer texture a new store of the given size, the texture keeps viewing it
+	static unsigned int respecify_buffer(unsigned int buffer, const void* data, unsigned int bytes)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STATIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		return bytes;
+	}
+
+	static float distance_to_sphere(const vec3& p, const bounding_sphere& b)
+	{
+		const auto d = b.center - p;
+		return std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z) - b.radius;
+	}
+
+	// every pass shares the vertex stage and the texture units, visibility programs write the ids output by the vertex stage
+	static bool build_program(glb::shader_program_builder& builder, const char* vertex_shader, const char* instance_attrib, render_pass pass,
+							  glb::framebuffer& fbuffer, glb::camera& cam, glb::shader_program& program)
+	{
+		if(!begin_pass_program(builder, vertex_shader, "../shaders/visibility.frag", pass))
+		{
+			return false;
+		}
+		builder.bind_vertex_attrib("in_position", 0);
+		builder.bind_vertex_attrib("in_normal", 1);
+		builder.bind_vertex_attrib(instance_attrib, INSTANCE_ATTRIB);
+		builder.bind_vertex_attrib("in_color", 7);
+		if(!end_pass_program(builder, pass, fbuffer, cam, program))
+		{
+			return false;
+		}
+		program.set_uniform("tex_transforms", TRANSFORM_TEX_UNIT);
+		program.set_uniform("tex_colorIDs", COLOR_IDS_TEX_UNIT);
+		program.set_uniform("tex_colors", COLORS_TEX_UNIT);
+		program.set_uniform("tex_tracks", ANIMATION_TEX_UNIT);
+		program.set_uniform("tex_flags", FLAGS_TEX_UNIT);
+		if(pass == render_pass_wireframe)
+		{
+			program.set_uniform("triangle_base", 0);
+		}
+		return true;
+	}
+
+	// location of a uniform set between draw calls, where looking it up by name every call would cost more than the draw
+	static int get_uniform_location(glb::shader_program& program, const char* name)
+	{
+		int id = 0;
+		program.bind();
+		glGetIntegerv(GL_CURRENT_PROGRAM, &id);
+		const auto location = glGetUniformLocation(id, name);
+		glUseProgram(0);
+		return location;
+	}
+
 	static EigenOBB compute_obb(const EigenVec3Array& src)
 	{
 		EigenOBB obb;
@@ -195,12 +379,16 @@ namespace app
 		return mat4_to_bl(Eigen::umeyama(to_eigen(src_points), to_eigen(dst_points), true));
 	}
 
-	static mat4 estimate_transform_3x3(const EigenVec3Array& src,
-									   const EigenVec3& src_mean, const EigenVec3Array& src_local, const EigenMat3& Aqq,
+	static mat4 estimate_transform_3x3(const vector<vec3>& src_points,
 									   const EigenVec3Array& dst,
 									   const EigenVec3& dst_mean, const EigenVec3Array& dst_local,
 									   double& error)
 	{
+		EigenVec3Array src = to_eigen(src_points);
+		EigenVec3 src_mean = src.rowwise().mean();
+		EigenVec3Array src_local = src.colwise() - src_mean;
+
+		EigenMat3 Aqq = (src_local * src_local.transpose()).inverse();
 		EigenMat3 Apq = dst_local * src_local.transpose();
 
 		EigenMat3 A = Apq * Aqq;
@@ -275,67 +463,159 @@ namespace app
 		_current_color_id = color_id;
 	}
 
-	void duplicate_instance_renderer::add_box(const box& b, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_box(const box& b, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_box(b.extents), transform);
+		return _add_mesh(tess::tessellate_box(b.extents), transform);
 	}
 
-	void duplicate_instance_renderer::add_circular_torus(const circular_torus& c, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_circular_torus(const circular_torus& c, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_circular_torus(c.in_radius, c.out_radius, c.sweep_angle), transform);
+		return _add_mesh(tess::tessellate_circular_torus(c.in_radius, c.out_radius, c.sweep_angle), transform);
 	}
 
-	void duplicate_instance_renderer::add_cone(const cone& c, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_cone(const cone& c, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_cone(c.top_radius, c.bottom_radius, c.height), transform);
+		return _add_mesh(tess::tessellate_cone(c.top_radius, c.bottom_radius, c.height), transform);
 	}
 
-	void duplicate_instance_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_cone_offset(c.top_radius, c.bottom_radius, c.height, c.offset), transform);
+		return _add_mesh(tess::tessellate_cone_offset(c.top_radius, c.bottom_radius, c.height, c.offset), transform);
 	}
 
-	void duplicate_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_cylinder(c.radius, c.height), transform);
+		return _add_mesh(tess::tessellate_cylinder(c.radius, c.height), transform);
 	}
 
-	void duplicate_instance_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_cylinder_offset(c.radius, c.height, c.offset), transform);
+		return _add_mesh(tess::tessellate_cylinder_offset(c.radius, c.height, c.offset), transform);
 	}
 
-	void duplicate_instance_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_cylinder_slope(c.radius, c.height, c.top_slope_angles, c.bottom_slope_angles), transform);
+		return _add_mesh(tess::tessellate_cylinder_slope(c.radius, c.height, c.top_slope_angles, c.bottom_slope_angles), transform);
 	}
 
-	void duplicate_instance_renderer::add_dish(const dish& d, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_dish(const dish& d, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_dish(d.radius, d.height), transform);
+		return _add_mesh(tess::tessellate_dish(d.radius, d.height), transform);
 	}
 
-	void duplicate_instance_renderer::add_mesh(const tess::triangle_mesh& m, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_mesh(const tess::triangle_mesh& m, const mat4& transform)
 	{
-		_add_mesh(m, transform, true);
+		return _add_mesh(m, transform, true);
 	}
 
-	void duplicate_instance_renderer::add_pyramid(const pyramid& p, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_pyramid(const pyramid& p, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_pyramid(p.top_extents, p.bottom_extents, p.height, p.offset), transform);
+		return _add_mesh(tess::tessellate_pyramid(p.top_extents, p.bottom_extents, p.height, p.offset), transform);
 	}
 
-	void duplicate_instance_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_rectangular_torus(rt.in_radius, rt.out_radius, rt.in_height, rt.sweep_angle), transform);
+		return _add_mesh(tess::tessellate_rectangular_torus(rt.in_radius, rt.out_radius, rt.in_height, rt.sweep_angle), transform);
 	}
 
-	void duplicate_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
+	instance_handle duplicate_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
 	{
-		_add_mesh(tess::tessellate_sphere(s.radius), transform);
+		return _add_mesh(tess::tessellate_sphere(s.radius), transform);
 	}
 
 	void duplicate_instance_renderer::end_upload()
+	{
+		if(!_prepared)
+		{
+			prepare_upload();
+		}
+
+		if(!_batches.empty())
+		{
+			_upload_merged_batches();
+		}
+
+		// 1. transform, color id and flag streams behind their buffer textures
+		_transform_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, _total_geometries * sizeof(mat34));
+		_transform_buffer.add(_cpu_transform_buffer.data(), _cpu_transform_buffer.size());
+		_transform_texture.create(TRANSFORM_TEX_UNIT, glb::target_texture_buffer);
+		_transform_texture.set_data_source(glb::internal_format_rgba32f, _transform_buffer);
+		_transform_buffer_id = _transform_buffer.get_id();
+
+		_color_id_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, _total_geometries * sizeof(unsigned char));
+		_color_id_buffer.add(_cpu_color_id_buffer.data(), _cpu_color_id_buffer.size());
+		_color_ids_texture.create(COLOR_IDS_TEX_UNIT, glb::target_texture_buffer);
+		_color_ids_texture.set_data_source(glb::internal_format_r8ui, _color_id_buffer);
+		_color_id_buffer_id = _color_id_buffer.get_id();
+
+		_flag_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, _total_geometries * sizeof(unsigned char));
+		_flag_buffer.add(_cpu_flag_buffer.data(), _cpu_flag_buffer.size());
+		_flags_texture.create(FLAGS_TEX_UNIT, glb::target_texture_buffer);
+		_flags_texture.set_data_source(glb::internal_format_r8ui, _flag_buffer);
+		_flag_buffer_id = _flag_buffer.get_id();
+
+		// 2. shared vertex and element buffers
+		glGenVertexArrays(1, &_main_vao);
+		glBindVertexArray(_main_vao);
+
+		glGenBuffers(1, &_vertex_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, _upload_vertices.size() * sizeof(tess::vertex), _upload_vertices.data(), GL_STATIC_DRAW);
+		_vertex_allocator.adopt(_vertex_buffer, _upload_vertices.size() * sizeof(tess::vertex));
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex), GLB_BYTE_OFFSET(0));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex), GLB_BYTE_OFFSET(sizeof(vec3)));
+
+		glGenBuffers(1, &_element_buffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _element_buffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, _upload_elements.size() * sizeof(tess::element), _upload_elements.data(), GL_STATIC_DRAW);
+		_element_allocator.adopt(_element_buffer, _upload_elements.size() * sizeof(tess::element));
+
+		vector<tess::vertex>().swap(_upload_vertices);
+		vector<tess::element>().swap(_upload_elements);
+
+		// 3. per-instance index into transforms and color ids: identity range for whole sets, followed by room for per-frame lists
+		vector<unsigned int> identity(_total_geometries);
+		for(unsigned int i = 0; i < _total_geometries; ++i)
+		{
+			identity[i] = i;
+		}
+		glGenBuffers(1, &_instance_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, 2 * _total_geometries * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, identity.size() * sizeof(unsigned int), identity.data());
+		glEnableVertexAttribArray(INSTANCE_ATTRIB);
+		glVertexAttribIPointer(INSTANCE_ATTRIB, 1, GL_INT, 0, GLB_BYTE_OFFSET(0));
+		glVertexAttribDivisor(INSTANCE_ATTRIB, 1);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+
+		// 4. one indirect command per set, base instance selects the set's range of transforms
+		glGenBuffers(1, &_set_commands_buffer);
+		glGenBuffers(1, &_frame_commands_buffer);
+		_upload_set_commands();
+
+		// 5. CAD color table and feature edge masks
+		_colors_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, PALETTE_SIZE * sizeof(color));
+		_colors_buffer.add(_palette.data(), _palette.size());
+		_colors_texture.create(COLORS_TEX_UNIT, glb::target_texture_buffer);
+		_colors_texture.set_data_source(glb::internal_format_rgba8ui, _colors_buffer);
+		_colors_buffer_id = _colors_buffer.get_id();
+		_palette_dirty = false;
+
+		_edges_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, _edge_masks.size() * sizeof(unsigned char));
+		_edges_buffer.add(_edge_masks.data(), _edge_masks.size());
+		_edges_texture.create(EDGES_TEX_UNIT, glb::target_texture_buffer);
+		_edges_texture.set_data_source(glb::internal_format_r8ui, _edges_buffer);
+		_edges_buffer_id = _edges_buffer.get_id();
+
+		_uploaded = true;
+	}
+
+	void duplicate_instance_renderer::prepare_upload()
 	{
 //		auto aspect = 1.0f;
 //		auto fovy = math::to_radians(60.0f);
@@ -360,29 +640,37 @@ namespace app
 
 
 
+		if(_merge_threshold > 0)
+		{
+			_merge_low_count_meshes();
+		}
+
 		const auto unique_mesh_count = _unique_meshes.size();
 		_instance_sets.reserve(unique_mesh_count);
 
-		glb::vertex_specification spec;
-		spec.setup_vertex_buffer(glb::usage_static_draw, _total_vbo_size_bytes);
-		spec.setup_element_buffer(glb::usage_static_draw, _total_ebo_size_bytes);
-		spec.add_vertex_attrib({3, glb::type_float, false, sizeof(tess::vertex), 0});
-		spec.add_vertex_attrib({3, glb::type_float, false, sizeof(tess::vertex), sizeof(vec3)});
+		vector<tess::vertex> vertices;
+		vertices.reserve(_total_vbo_size_bytes / sizeof(tess::vertex));
+		vector<tess::element> elements;
+		elements.reserve(_total_ebo_size_bytes / sizeof(tess::element));
+		vector<unsigned char> edge_masks;
 
-		if(!_vao_builder.initialize(spec, glb::mode_triangles, glb::type_uint))
-		{
-			return;
-		}
+		// meshes with identical connectivity share a single element range and differ only in base vertex
+		hash_multimap<size_t, topology> topologies;
+		topologies.reserve(unique_mesh_count);
+		unsigned int shared_meshes = 0;
 
-		_vao_builder.begin();
+		// simplified levels of detail with identical elements are also shared
+		hash_multimap<size_t, unsigned int> lod_ranges;
+		unsigned int lod_elements = 0;
 
-		_transform_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, _total_geometries * sizeof(mat34));
-		_transform_texture.create(TRANSFORM_TEX_UNIT, glb::target_texture_buffer);
-		_transform_texture.set_data_source(glb::internal_format_rgba32f, _transform_buffer);
+		double acmr_before = 0.0;
+		double acmr_after = 0.0;
+		unsigned int optimized_triangles = 0;
 
-		_color_id_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, _total_geometries * sizeof(unsigned char));
-		_color_ids_texture.create(COLOR_IDS_TEX_UNIT, glb::target_texture_buffer);
-		_color_ids_texture.set_data_source(glb::internal_format_r8ui, _color_id_buffer);
+		_instance_bounds.reserve(_total_geometries);
+		_instance_set_index.reserve(_total_geometries);
+		_slots.reset(_total_geometries);
+		_set_occluder_mesh.reserve(unique_mesh_count);
 
 //		map<int, int> histogram;
 //		vector<int> instance_count;
@@ -418,18 +706,222 @@ namespace app
 //			file.write((char*)xfms.data(), sizeof(mat34)*xfms.size());
 //			file.flush();
 
+			// 1. search for a previously uploaded element range with the same connectivity and vertex count
+			const unsigned int vertex_count = ps.mesh.vertices.size();
+			const auto h = hash_elements(ps.mesh.elements) ^ (static_cast<size_t>(vertex_count) * 2654435761u);
+			auto range = topologies.equal_range(h);
+			auto match = range.second;
+			for(auto t = range.first; t != range.second; ++t)
+			{
+				if(t->second.vertex_count == vertex_count && t->second.source_elements == ps.mesh.elements)
+				{
+					match = t;
+					break;
+				}
+			}
+
+			// 2. append a new element range only if connectivity is not shared
+			unsigned int first_element = 0;
+			unsigned int element_count = ps.mesh.elements.size();
+			if(match != range.second)
+			{
+				// shared connectivity was optimized once: only bring vertices to the same order
+				remap_vertices(ps.mesh.vertices, match->second.vertex_remap);
+				first_element = match->second.first_element;
+				++shared_meshes;
+				_total_memory -= ps.mesh.elements.size() * sizeof(tess::element);
+			}
+			else
+			{
+				topology topo;
+				topo.first_element = first_element = elements.size();
+				topo.vertex_count = vertex_count;
+				topo.source_elements = ps.mesh.elements;
+
+				// 3. optimize triangle order for vertex cache and overdraw, then vertex order for fetch locality
+				const auto triangles = element_count / 3;
+				acmr_before += compute_acmr(ps.mesh.elements, ps.mesh.vertices.size()) * triangles;
+				optimize_vertex_cache(ps.mesh.elements, ps.mesh.vertices.size());
+				optimize_overdraw(ps.mesh.elements, ps.mesh.vertices);
+				topo.vertex_remap = optimize_vertex_fetch(ps.mesh.elements, ps.mesh.vertices);
+				acmr_after += compute_acmr(ps.mesh.elements, ps.mesh.vertices.size()) * triangles;
+				optimized_triangles += triangles;
+
+				elements.insert(elements.end(), ps.mesh.elements.begin(), ps.mesh.elements.end());
+				topologies.emplace(h, std::move(topo));
+			}
+
 			instance_set instances;
-			instances.element_count = ps.mesh.elements.size();
-			instances.element_byte_offset = _vao_builder._spec.get_element_buffer().get_size_bytes();
-			instances.tex_offset = _transform_buffer.get_count();
+			instances.element_count = element_count;
+			instances.element_byte_offset = first_element * sizeof(tess::element);
+			instances.base_vertex = vertices.size();
+			instances.tex_offset = _cpu_transform_buffer.size();
 			instances.count = ps.transforms.size();
+			instances.capacity = instances.count;
 			instances.color = vec3(rc(), rc(), rc());
-			_instance_sets.push_back(instances);
 
-			_vao_builder.add_mesh(ps.mesh.vertices.data(), ps.mesh.vertices.size(), ps.mesh.elements.data(), ps.mesh.elements.size());
+			// 4. split large meshes into meshlets for per-instance cluster culling
+			if(element_count / 3 >= MIN_MESHLET_TRIANGLES)
+			{
+				const vector<tess::element> mesh_elements(elements.begin() + first_element, elements.begin() + first_element + element_count);
+				const auto meshlets = build_meshlets(mesh_elements, ps.mesh.vertices);
+				instances.first_meshlet = _meshlets.size();
+				instances.meshlet_count = meshlets.size();
+				_meshlets.insert(_meshlets.end(), meshlets.begin(), meshlets.end());
+			}
+
+			// 5. bounding sphere in mesh space
+			bbox bounds;
+			for(const auto& v : ps.mesh.vertices)
+			{
+				bounds.expand(v.position);
+			}
+			instances.center = (bounds.min + bounds.max) * 0.5f;
+			for(const auto& v : ps.mesh.vertices)
+			{
+				const auto d = v.position - instances.center;
+				instances.radius = math::max(instances.radius, std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z));
+			}
+
+			// 6. simplification chain over the same vertices: coarser levels only add elements
+			instances.first_lod = _lods.size();
+			lod full;
+			full.element_count = element_count;
+			full.element_byte_offset = instances.element_byte_offset;
+			_lods.push_back(full);
+			if(element_count / 3 >= MIN_LOD_TRIANGLES)
+			{
+				vector<tess::element> previous(elements.begin() + first_element, elements.begin() + first_element + element_count);
+				for(unsigned int resolution = LOD_MAX_GRID_RESOLUTION; resolution >= 2 && _lods.size() - instances.first_lod < MAX_LODS; resolution /= 2)
+				{
+					float error = 0.0f;
+					auto simplified = simplify_clustered(previous, ps.mesh.vertices, resolution, error);
+					if(simplified.empty())
+					{
+						break;
+					}
+					if(simplified.size() > previous.size() * LOD_MIN_REDUCTION)
+					{
+						continue;
+					}
+					optimize_vertex_cache(simplified, ps.mesh.vertices.size());
+
+					lod l;
+					l.element_count = simplified.size();
+					l.element_byte_offset = add_shared_elements(simplified, elements, lod_ranges) * sizeof(tess::element);
+					l.error = error;
+					_lods.push_back(l);
+					lod_elements += simplified.size();
+
+					previous.swap(simplified);
+				}
+			}
+			instances.lod_count = _lods.size() - instances.first_lod;
+
+			// 7. spatial order of the instances, neighbours share transform fetches and culling ranges
+			{
+				bbox centers;
+				for(const auto& t : ps.transforms)
+				{
+					centers.expand(t.mul(instances.center));
+				}
+
+				vector<std::pair<unsigned int, unsigned int>> codes(ps.transforms.size());
+				for(unsigned int i = 0; i < ps.transforms.size(); ++i)
+				{
+					codes[i] = std::make_pair(morton_code(ps.transforms[i].mul(instances.center), centers), i);
+				}
+				std::sort(codes.begin(), codes.end());
+
+				vector<mat34> transforms(ps.transforms.size());
+				vector<unsigned char> color_ids(ps.color_ids.size());
+				vector<instance_handle> handles(ps.handles.size());
+				for(unsigned int i = 0; i < codes.size(); ++i)
+				{
+					transforms[i] = ps.transforms[codes[i].second];
+					color_ids[i] = ps.color_ids[codes[i].second];
+					handles[i] = ps.handles[codes[i].second];
+				}
+				ps.transforms.swap(transforms);
+				ps.color_ids.swap(color_ids);
+				ps.handles.swap(handles);
+			}
+
+			// 8. world bounds of every instance for culling, large instances are candidate occluders
+			_set_occluder_mesh.push_back(-1);
+			bool has_occluders = false;
+			for(const auto& t : ps.transforms)
+			{
+				bounding_sphere b;
+				b.center = t.mul(instances.center);
+				b.radius = instances.radius * t.max_scale();
+				if(b.radius >= OCCLUDER_MIN_RADIUS)
+				{
+					_occluder_instances.push_back(_instance_bounds.size());
+					has_occluders = true;
+				}
+				_instance_bounds.push_back(b);
+				_instance_set_index.push_back(_instance_sets.size());
+			}
+
+			// slots of the set's handles, a new transform is carried to the reference mesh by the local transform of its slot
+			for(unsigned int i = 0; i < ps.handles.size(); ++i)
+			{
+				_slots.place(ps.handles[i], instances.tex_offset + i, ps.transforms[i]);
+			}
+
+			// 9. occluders are drawn from the finest level within the triangle budget
+			if(has_occluders)
+			{
+				auto level = instances.first_lod;
+				while(level + 1 < instances.first_lod + instances.lod_count && static_cast<unsigned int>(_lods[level].element_count / 3) > OCCLUDER_MAX_TRIANGLES)
+				{
+					++level;
+				}
+
+				occluder_mesh occluder;
+				const auto first = elements.begin() + _lods[level].element_byte_offset / sizeof(tess::element);
+				occluder.elements.assign(first, first + _lods[level].element_count);
+				occluder.positions.reserve(ps.mesh.vertices.size());
+				for(const auto& v : ps.mesh.vertices)
+				{
+					occluder.positions.push_back(v.position);
+				}
+				_set_occluder_mesh.back() = _occluder_meshes.size();
+				_occluder_meshes.push_back(std::move(occluder));
+			}
+
+			// 10. fixed size ranges of spatially close instances with their enclosing bounds
+			instances.first_range = _instance_ranges.size();
+			const auto set_bounds = _instance_bounds.data() + _instance_bounds.size() - ps.transforms.size();
+			for(unsigned int first = 0; first < ps.transforms.size(); first += INSTANCE_RANGE_SIZE)
+			{
+				instance_range range;
+				range.first = first;
+				range.count = math::min(static_cast<unsigned int>(ps.transforms.size()) - first, INSTANCE_RANGE_SIZE);
+				range.bounds = enclosing_sphere(set_bounds + first, range.count);
+				_instance_ranges.push_back(range);
+			}
+			instances.range_count = _instance_ranges.size() - instances.first_range;
+
+			// 11. feature edges of every new element range, shared ranges keep the masks of the first mesh
+			edge_masks.resize(elements.size() / 3, UNKNOWN_EDGES);
+			for(int l = instances.first_lod; l < instances.first_lod + instances.lod_count; ++l)
+			{
+				const auto first = _lods[l].element_byte_offset / sizeof(tess::element);
+				if(_lods[l].element_count == 0 || edge_masks[first / 3] != UNKNOWN_EDGES)
+				{
+					continue;
+				}
+				const vector<tess::element> range(elements.begin() + first, elements.begin() + first + _lods[l].element_count);
+				const auto masks = compute_feature_edges(range, ps.mesh.vertices, FEATURE_CREASE_ANGLE);
+				std::copy(masks.begin(), masks.end(), edge_masks.begin() + first / 3);
+			}
+
+			ps.set = _instance_sets.size();
+			_instance_sets.push_back(instances);
 
-			_transform_buffer.add(ps.transforms.data(), ps.transforms.size());
-			_color_id_buffer.add(ps.color_ids.data(), ps.color_ids.size());
+			vertices.insert(vertices.end(), ps.mesh.vertices.begin(), ps.mesh.vertices.end());
 
 			_cpu_transform_buffer.insert(_cpu_transform_buffer.end(), ps.transforms.begin(), ps.transforms.end());
 			_cpu_color_id_buffer.insert(_cpu_color_id_buffer.end(), ps.color_ids.begin(), ps.color_ids.end());
@@ -442,11 +934,31 @@ namespace app
 
 //		file.close();
 
-//		_cpu_transform_buffer2.resize(_cpu_transform_buffer.size());
+		_bvh.build(_instance_bounds);
+
+		_dirty_transforms.resize(_cpu_transform_buffer.size() * sizeof(mat34));
+		_dirty_color_ids.resize(_cpu_color_id_buffer.size() * sizeof(unsigned char));
+		_upload_stats = upload_stats();
+		_upload_stats.full_bytes = _dirty_transforms.get_size_bytes() + _dirty_color_ids.get_size_bytes();
 
-		_vao_builder.end();
+		// every instance starts shown, flags only ever go up as dirty pages
+		_cpu_flag_buffer.assign(_cpu_color_id_buffer.size(), 0);
+		_dirty_flags.resize(_cpu_flag_buffer.size() * sizeof(unsigned char));
+		_hidden_instances = 0;
+		_upload_color_ids = _cpu_color_id_buffer;
+
+		// one vertex at the center of each set stands for its small features
+		for(auto& instances : _instance_sets)
+		{
+			instances.point_vertex = vertices.size();
+			tess::vertex v;
+			v.position = instances.center;
+			v.normal = vec3(0.0f, 0.0f, 1.0f);
+			vertices.push_back(v);
+		}
 
-		_main_vao = _vao_builder.get_vertex_arrays()[0];
+		// per-frame instance lists start past the identity range of every slot
+		_list_offset = _total_geometries;
 
 //		int max_count = 0;
 //		for(auto c : instance_count)
@@ -461,16 +973,27 @@ namespace app
 //			io::print("[#instances,#ocurrences]:", c.first, c.second);
 //		}
 
-		// free memory
-		_unique_meshes = decltype(_unique_meshes)();
+		// free memory, unique meshes keep what matching late meshes needs
+		for(auto& itr : _unique_meshes)
+		{
+			auto& ps = itr.second;
+			ps.mesh = tess::triangle_mesh();
+			vector<mat34>().swap(ps.transforms);
+			vector<unsigned char>().swap(ps.color_ids);
+			vector<instance_handle>().swap(ps.handles);
+		}
+		_layout_dirty = false;
 
 		// CAD color table
 		rvm::MaterialTable color_table;
 
-		glb::buffer colors_buffer;
-		colors_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, color_table.getNumberMaterials() * sizeof(color));
-
-		for(int i = 0; i < color_table.getNumberMaterials(); ++i)
+		// the table covers every color id, entries past the materials are left to overlays
+		color grey;
+		grey.rgba[0] = grey.rgba[1] = grey.rgba[2] = 64;
+		grey.rgba[3] = 255;
+		_palette.assign(PALETTE_SIZE, grey);
+		_material_count = math::min(static_cast<unsigned int>(color_table.getNumberMaterials()), PALETTE_SIZE);
+		for(unsigned int i = 0; i < _material_count; ++i)
 		{
 			auto diffuse = vec3(color_table.getMaterial(i).diffuseColor);
 			color c;
@@ -483,116 +1006,1661 @@ namespace app
 				c.rgba[1] = 64;
 				c.rgba[2] = 64;
 			}
-			colors_buffer.add(c);
+			_palette[i] = c;
 		}
-		_colors_texture.create(COLORS_TEX_UNIT, glb::target_texture_buffer);
-		_colors_texture.set_data_source(glb::internal_format_rgba8ui, colors_buffer);
+
+		_edges_capacity = edge_masks.size();
+		_total_memory += edge_masks.size() * sizeof(unsigned char);
+		_edge_masks.swap(edge_masks);
 
 		io::print("unique meshes:", unique_mesh_count);
 		io::print("geometries:", _total_geometries);
 		io::print("triangles:", _total_triangles);
+		io::print("shared topologies:", shared_meshes, "meshes reuse", topologies.size(), "element ranges");
+		io::print("vertex cache ACMR:", acmr_before / math::max(optimized_triangles, 1u), "->", acmr_after / math::max(optimized_triangles, 1u));
+		io::print("meshlets:", _meshlets.size());
+		io::print("instance bvh nodes:", _bvh.get_node_count());
+		io::print("instance ranges:", _instance_ranges.size());
+		io::print("occluders:", _occluder_instances.size(), "instances of", _occluder_meshes.size(), "meshes");
+		io::print("pinned instances with singular transforms:", _slots.get_pinned_count());
+		io::print("lod levels:", _lods.size() - _instance_sets.size(), "with", lod_elements * sizeof(tess::element) / 1024.0f / 1024.0f, "MB of elements");
+		io::print("element memory:", elements.size() * sizeof(tess::element) / 1024.0f / 1024.0f, "MB of", _total_ebo_size_bytes / 1024.0f / 1024.0f, "MB");
 		io::print("-- memory matching:", _total_memory / 1024.0f / 1024.0f, "MB");
+
+		_upload_vertices.swap(vertices);
+		_upload_elements.swap(elements);
+		_prepared = true;
 	}
 
-	bool duplicate_instance_renderer::initialize(glb::framebuffer& fbuffer, glb::camera& cam)
+	void duplicate_instance_renderer::set_view(const frustum& f)
 	{
-		fbuffer.set_clear_color(0, 1.0f, 1.0f, 1.0f);
+		_frustum = f;
+		_upload_stats.uploaded_bytes = 0;
+		_upload_stats.ranges = 0;
+		_upload_stats.refit_nodes = 0;
+		_lists_valid = false;
+	}
 
-		glb::shader_program_builder shader_builder;
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/duplicate_instance.vert"))
+	void duplicate_instance_renderer::set_transform(instance_handle handle, const mat4& transform)
+	{
+		set_transform(handle, mat34(transform));
+	}
+
+	void duplicate_instance_renderer::set_transform(instance_handle handle, const mat34& transform)
+	{
+		if(!_slots.has_slot(handle) || _slots.is_pinned(handle))
 		{
-			return false;
+			return;
 		}
-//		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/pass_through.vert"))
-//		{
-//			return false;
-//		}
-//		if(!shader_builder.add_file(glb::shader_geometry, "../shaders/duplicate_instance.geom"))
-//		{
-//			return false;
-//		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
+
+		const auto slot = _slots.get_slot(handle);
+		_slots.set_transform(handle, transform);
+		if(slot < _slot_tracks.size() && _slot_tracks[slot] >= 0)
 		{
-			return false;
+			// the track keeps turning the instance about the center of its new rest bounds
+			auto& track = _tracks[_slot_tracks[slot]];
+			track.rest = _slots.get_slot_transform(handle, transform);
+			track.pivot = track.rest.mul(_instance_sets[_instance_set_index[slot]].center);
+			_write_animated_transform(_slot_tracks[slot]);
+			_tracks_dirty = true;
+			return;
 		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_normal", 1);
-		shader_builder.bind_vertex_attrib("in_tex_offset", TEX_OFFSET_ATTRIB);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
+		_cpu_transform_buffer[slot] = _slots.get_slot_transform(handle, transform);
+		_dirty_transforms.mark(slot * sizeof(mat34), sizeof(mat34));
+		_moved_instances.push_back(slot);
+	}
+
+	void duplicate_instance_renderer::set_color(instance_handle handle, unsigned char color_id)
+	{
+		if(!_slots.has_slot(handle))
 		{
-			return false;
+			return;
 		}
-		_shader = shader_builder.get_shader_program();
-		_shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_shader.set_uniform("tex_transforms", TRANSFORM_TEX_UNIT);
-		_shader.set_uniform("tex_colorIDs", COLOR_IDS_TEX_UNIT);
-		_shader.set_uniform("tex_colors", COLORS_TEX_UNIT);
 
-		return true;
+		_write_color_id(_slots.get_slot(handle), color_id);
 	}
 
-	bool duplicate_instance_renderer::finalize()
+	unsigned int duplicate_instance_renderer::set_colors(const vector<instance_handle>& handles, const vector<unsigned char>& color_ids)
 	{
-		return true;
+		unsigned int changed = 0;
+		const auto count = math::min(handles.size(), color_ids.size());
+		for(size_t i = 0; i < count; ++i)
+		{
+			const auto handle = handles[i];
+			if(_slots.has_slot(handle))
+			{
+				changed += _write_color_id(_slots.get_slot(handle), color_ids[i]);
+			}
+		}
+		return changed;
 	}
 
-	void duplicate_instance_renderer::render()
+	unsigned int duplicate_instance_renderer::map_colors(const vector<unsigned char>& values, const vector<unsigned char>& palette)
 	{
-//		static auto rid = make_random(0, 255);
-//		static auto rt = make_random(-1.0f, 1.0f);
+		// slots in order a page at a time, writes stay sequential and a changed page is marked once
+		unsigned int changed = 0;
+		const unsigned int slots = _cpu_color_id_buffer.size();
+		for(unsigned int first = 0; first < slots; first += DIRTY_PAGE_BYTES)
+		{
+			const auto last = math::min(slots, first + DIRTY_PAGE_BYTES);
+			unsigned int page_changed = 0;
+			for(auto slot = first; slot < last; ++slot)
+			{
+				const auto handle = _slots.get_handle(slot);
+				if(handle >= values.size())
+				{
+					continue;
+				}
+				const auto value = values[handle];
+				const auto color_id = value < palette.size() ? palette[value] : _upload_color_ids[slot];
+				page_changed += _cpu_color_id_buffer[slot] != color_id;
+				_cpu_color_id_buffer[slot] = color_id;
+			}
+			if(page_changed > 0)
+			{
+				_dirty_color_ids.mark(first, last - first);
+				changed += page_changed;
+			}
+		}
+		return changed;
+	}
 
+	unsigned int duplicate_instance_renderer::reset_colors()
+	{
+		unsigned int changed = 0;
+		const unsigned int slots = _cpu_color_id_buffer.size();
+		for(unsigned int first = 0; first < slots; first += DIRTY_PAGE_BYTES)
+		{
+			const auto last = math::min(slots, first + DIRTY_PAGE_BYTES);
+			unsigned int page_changed = 0;
+			for(auto slot = first; slot < last; ++slot)
+			{
+				page_changed += _cpu_color_id_buffer[slot] != _upload_color_ids[slot];
+				_cpu_color_id_buffer[slot] = _upload_color_ids[slot];
+			}
+			if(page_changed > 0)
+			{
+				_dirty_color_ids.mark(first, last - first);
+				changed += page_changed;
+			}
+		}
+		return changed;
+	}
 
-//		for(auto& id : _cpu_color_id_buffer)
-//		{
-//			id = rid();
-//		}
-//		_color_id_buffer.replace(_cpu_color_id_buffer.data(), _cpu_color_id_buffer.size());
+	void duplicate_instance_renderer::set_palette_color(unsigned char color_id, const vec3& rgb)
+	{
+		auto& c = _palette[color_id];
+		c.rgba[0] = static_cast<unsigned char>(255 * math::min(math::max(rgb.x, 0.0f), 1.0f));
+		c.rgba[1] = static_cast<unsigned char>(255 * math::min(math::max(rgb.y, 0.0f), 1.0f));
+		c.rgba[2] = static_cast<unsigned char>(255 * math::min(math::max(rgb.z, 0.0f), 1.0f));
+		_palette_dirty = true;
+	}
 
-//		for(unsigned int i = 0; i < _cpu_transform_buffer.size(); ++i)
-//		{
-//			const auto& t = _cpu_transform_buffer[i];
-//			_cpu_transform_buffer2[i] = mat34(mat4::translation({rt(), rt(), rt()}).mul(t.as_mat4()));
-//		}
-//		_transform_buffer.replace(_cpu_transform_buffer2.data(), _cpu_transform_buffer2.size());
+	unsigned int duplicate_instance_renderer::get_material_count() const
+	{
+		return _material_count;
+	}
 
+	const mat34& duplicate_instance_renderer::get_transform(instance_handle handle) const
+	{
+		return _slots.get_transform(handle);
+	}
 
+	bool duplicate_instance_renderer::is_pinned(instance_handle handle) const
+	{
+		return _slots.is_pinned(handle);
+	}
 
-		_shader.bind();
-		_transform_texture.bind();
-		_color_ids_texture.bind();
-		_colors_texture.bind();
-		_main_vao.bind();
-		for(const auto& instances : _instance_sets)
-		{
-			glVertexAttribI1i(TEX_OFFSET_ATTRIB, instances.tex_offset);
-//			glVertexAttrib3fv(7, instances.color.data());
-			glDrawElementsInstanced(GL_TRIANGLES, instances.element_count, GL_UNSIGNED_INT, GLB_BYTE_OFFSET(instances.element_byte_offset), instances.count);
-		}
+	unsigned int duplicate_instance_renderer::get_handle_count() const
+	{
+		return _slots.get_handle_count();
 	}
 
-	void duplicate_instance_renderer::render_color(const vec3& color)
+	instance_handle duplicate_instance_renderer::add_instance_of(instance_handle source, const mat4& transform)
 	{
-		_shader.bind();
-		_transform_texture.bind();
-		_color_ids_texture.bind();
-		_colors_texture.bind();
-		_main_vao.bind();
-		glVertexAttrib3fv(7, color.data());
-		for(const auto& instances : _instance_sets)
+		if(!_uploaded || !_slots.has_slot(source) || _slots.is_pinned(source))
 		{
-			glVertexAttribI1i(TEX_OFFSET_ATTRIB, instances.tex_offset);
-			glDrawElementsInstanced(GL_TRIANGLES, instances.element_count, GL_UNSIGNED_INT, GLB_BYTE_OFFSET(instances.element_byte_offset), instances.count);
+			return INVALID_INSTANCE;
 		}
+
+		// the new handle carries the reference mesh the same way as the source
+		const auto slot = _slots.get_slot(source);
+		const auto set = _instance_set_index[slot];
+		const mat34 t(transform);
+		const auto slot_transform = _slots.get_slot_transform(source, t);
+		const auto color_id = _upload_color_ids[slot];
+		const auto handle = _slots.add(t);
+		++_total_geometries;
+		_total_triangles += _instance_sets[set].element_count / 3;
+		_insert_instance(set, handle, slot_transform, color_id);
+		return handle;
 	}
 
+	bool duplicate_instance_renderer::remove_instance(instance_handle handle)
+	{
+		if(handle >= _slots.get_handle_count())
+		{
+			return false;
+		}
+
+		// 1. not placed yet, or merged
+		if(!_slots.has_slot(handle))
+		{
+			unsigned int set = 0;
+			if(!_slots.remove_pending(handle, set))
+			{
+				return false;
+			}
+			--_total_geometries;
+			_total_triangles -= _instance_sets[set].element_count / 3;
+			return true;
+		}
+
+		// 2. flags and track let go of the slot before it is reused
+		set_flags(handle, 0);
+		set_animation_track(handle, vector<keyframe>());
+
+		// 3. the last instance of the set fills the hole, so the instances stay a prefix of the set's slots
+		const auto slot = _slots.get_slot(handle);
+		auto& instances = _instance_sets[_instance_set_index[slot]];
+		const unsigned int last = instances.tex_offset + --instances.count;
+		_slots.release(handle);
+		if(last != slot)
+		{
+			_move_slot(last, slot);
+		}
+		--_total_geometries;
+		_total_triangles -= instances.element_count / 3;
+		_set_commands_dirty = true;
+		_lists_valid = false;
+
+		// 4. empty slots still cost culling, the sets are packed again once they make a quarter of the slots
+		if(_slots.get_spare_count() * 4 > _cpu_transform_buffer.size())
+		{
+			_layout_dirty = true;
+		}
+		return true;
+	}
+
+	unsigned int duplicate_instance_renderer::get_instance_count() const
+	{
+		return _total_geometries;
+	}
+
+	unsigned int duplicate_instance_renderer::get_unique_mesh_count() const
+	{
+		return _uploaded ? _instance_sets.size() : _unique_meshes.size();
+	}
+
+	void duplicate_instance_renderer::set_flags(const vector<instance_handle>& handles, unsigned char set, unsigned char clear)
+	{
+		for(auto handle : handles)
+		{
+			if(!_slots.has_slot(handle))
+			{
+				continue;
+			}
+			const auto slot = _slots.get_slot(handle);
+			_write_flags(slot, (_cpu_flag_buffer[slot] & ~clear) | set);
+		}
+	}
+
+	void duplicate_instance_renderer::set_flags(instance_handle handle, unsigned char flags)
+	{
+		if(!_slots.has_slot(handle))
+		{
+			return;
+		}
+		_write_flags(_slots.get_slot(handle), flags);
+	}
+
+	unsigned char duplicate_instance_renderer::get_flags(instance_handle handle) const
+	{
+		if(!_slots.has_slot(handle))
+		{
+			return 0;
+		}
+		return _cpu_flag_buffer[_slots.get_slot(handle)];
+	}
+
+	void duplicate_instance_renderer::clear_flags(unsigned char flags)
+	{
+		for(unsigned int slot = 0; slot < _cpu_flag_buffer.size(); ++slot)
+		{
+			if(_cpu_flag_buffer[slot] & flags)
+			{
+				_write_flags(slot, _cpu_flag_buffer[slot] & ~flags);
+			}
+		}
+	}
+
+	unsigned int duplicate_instance_renderer::get_hidden_count() const
+	{
+		return _hidden_instances;
+	}
+
+	void duplicate_instance_renderer::set_animation_track(instance_handle handle, const vector<keyframe>& keys)
+	{
+		if(!_slots.has_slot(handle) || _slots.is_pinned(handle))
+		{
+			return;
+		}
+
+		// 1. existing track of the slot, or a new one
+		const auto slot = _slots.get_slot(handle);
+		_slot_tracks.resize(_cpu_transform_buffer.size(), -1);
+		if(_slot_tracks[slot] < 0)
+		{
+			if(keys.empty())
+			{
+				return;
+			}
+			if(_free_tracks.empty())
+			{
+				_slot_tracks[slot] = _tracks.size();
+				_tracks.emplace_back();
+			}
+			else
+			{
+				_slot_tracks[slot] = _free_tracks.back();
+				_free_tracks.pop_back();
+			}
+			++_animated_slots;
+		}
+		else if(keys.empty())
+		{
+			--_animated_slots;
+		}
+
+		// 2. rotations pivot on the center of the rest bounds, which no key can move further than its translation
+		auto& track = _tracks[_slot_tracks[slot]];
+		track.keys = keys;
+		track.slot = slot;
+		track.rest = _slots.get_slot_transform(handle, _slots.get_transform(handle));
+		track.pivot = track.rest.mul(_instance_sets[_instance_set_index[slot]].center);
+		track.reach = 0.0f;
+		for(const auto& k : keys)
+		{
+			const auto& t = k.translation;
+			track.reach = math::max(track.reach, std::sqrt(t.x*t.x + t.y*t.y + t.z*t.z));
+		}
+		_write_animated_transform(_slot_tracks[slot]);
+		if(keys.empty())
+		{
+			// a removed track no longer writes to the slot, which the instance or another one may be moved to, and its entry
+			// is taken by the next new track
+			track.slot = NO_SLOT;
+			_free_tracks.push_back(_slot_tracks[slot]);
+			_slot_tracks[slot] = -1;
+		}
+		_tracks_dirty = true;
+	}
+
+	void duplicate_instance_renderer::clear_animation_tracks()
+	{
+		for(auto& track : _tracks)
+		{
+			track.keys.clear();
+			_write_animated_transform(&track - _tracks.data());
+		}
+		_tracks.clear();
+		_free_tracks.clear();
+		_slot_tracks.clear();
+		_animated_slots = 0;
+		_tracks_dirty = true;
+	}
+
+	void duplicate_instance_renderer::set_animation_time(float time)
+	{
+		// the vertex stage only needs the new uniform, unless starting or stopping changes the culling bounds
+		const auto was_playing = _animation_time >= 0.0f;
+		_animation_time = time;
+		if(_cpu_animation || was_playing != (time >= 0.0f))
+		{
+			for(unsigned int i = 0; i < _tracks.size(); ++i)
+			{
+				_write_animated_transform(i);
+			}
+		}
+	}
+
+	float duplicate_instance_renderer::get_animation_time() const
+	{
+		return _animation_time;
+	}
+
+	void duplicate_instance_renderer::set_cpu_animation(bool enabled)
+	{
+		_cpu_animation = enabled;
+		for(unsigned int i = 0; i < _tracks.size(); ++i)
+		{
+			_write_animated_transform(i);
+		}
+	}
+
+	bool duplicate_instance_renderer::get_cpu_animation() const
+	{
+		return _cpu_animation;
+	}
+
+	bool duplicate_instance_renderer::initialize(glb::framebuffer& fbuffer, glb::camera& cam)
+	{
+		fbuffer.set_clear_color(0, 1.0f, 1.0f, 1.0f);
+
+		glb::shader_program_builder shader_builder;
+		if(!build_program(shader_builder, "../shaders/duplicate_instance.vert", "in_instance", render_pass_color, fbuffer, cam, _shader))
+		{
+			return false;
+		}
+		if(!build_program(shader_builder, "../shaders/duplicate_instance.vert", "in_instance", render_pass_depth, fbuffer, cam, _depth_shader))
+		{
+			return false;
+		}
+		if(!build_program(shader_builder, "../shaders/duplicate_instance.vert", "in_instance", render_pass_visibility, fbuffer, cam, _visibility_shader))
+		{
+			return false;
+		}
+		if(!build_program(shader_builder, "../shaders/duplicate_instance.vert", "in_instance", render_pass_wireframe, fbuffer, cam, _wireframe_shader))
+		{
+			return false;
+		}
+
+		// merged batches are already in world space and only look up their color
+		if(!build_program(shader_builder, "../shaders/duplicate_merged.vert", "in_color_id", render_pass_color, fbuffer, cam, _merged_shader))
+		{
+			return false;
+		}
+		if(!build_program(shader_builder, "../shaders/duplicate_merged.vert", "in_color_id", render_pass_depth, fbuffer, cam, _merged_depth_shader))
+		{
+			return false;
+		}
+		if(!build_program(shader_builder, "../shaders/duplicate_merged.vert", "in_color_id", render_pass_visibility, fbuffer, cam, _merged_visibility_shader))
+		{
+			return false;
+		}
+		if(!build_program(shader_builder, "../shaders/duplicate_merged.vert", "in_color_id", render_pass_wireframe, fbuffer, cam, _merged_wireframe_shader))
+		{
+			return false;
+		}
+		_triangle_base_location = get_uniform_location(_wireframe_shader, "triangle_base");
+		_merged_triangle_base_location = get_uniform_location(_merged_wireframe_shader, "triangle_base");
+		_animation_time_locations[render_pass_color] = get_uniform_location(_shader, "animation_time");
+		_animation_time_locations[render_pass_depth] = get_uniform_location(_depth_shader, "animation_time");
+		_animation_time_locations[render_pass_visibility] = get_uniform_location(_visibility_shader, "animation_time");
+		_animation_time_locations[render_pass_wireframe] = get_uniform_location(_wireframe_shader, "animation_time");
+
+		return true;
+	}
+
+	bool duplicate_instance_renderer::finalize()
+	{
+		// names created by end_upload, deleting 0 is ignored
+		glDeleteVertexArrays(1, &_main_vao);
+		glDeleteBuffers(1, &_vertex_buffer);
+		glDeleteBuffers(1, &_element_buffer);
+		glDeleteBuffers(1, &_instance_buffer);
+		glDeleteBuffers(1, &_set_commands_buffer);
+		glDeleteBuffers(1, &_frame_commands_buffer);
+		_main_vao = 0;
+		_vertex_buffer = 0;
+		_element_buffer = 0;
+		_instance_buffer = 0;
+		_set_commands_buffer = 0;
+		_frame_commands_buffer = 0;
+
+		glDeleteVertexArrays(1, &_merged_vao);
+		glDeleteBuffers(1, &_merged_vertex_buffer);
+		glDeleteBuffers(1, &_merged_element_buffer);
+		_merged_vao = 0;
+		_merged_vertex_buffer = 0;
+		_merged_element_buffer = 0;
+
+		_transform_ring.destroy();
+		glDeleteTextures(1, &_tracks_texture);
+		glDeleteBuffers(1, &_tracks_buffer);
+		_tracks_texture = 0;
+		_tracks_buffer = 0;
+		return true;
+	}
+
+	void duplicate_instance_renderer::render()
+	{
+		_shader.bind();
+		_bind_transforms();
+		_color_ids_texture.bind();
+		_colors_texture.bind();
+		_flags_texture.bind();
+		glBindVertexArray(_main_vao);
+		_draw_instance_sets();
+		_draw_batches();
+	}
+
+	void duplicate_instance_renderer::render_color(const vec3& color)
+	{
+		_shader.bind();
+		_bind_transforms();
+		_color_ids_texture.bind();
+		_colors_texture.bind();
+		_flags_texture.bind();
+		glBindVertexArray(_main_vao);
+		glVertexAttrib3fv(7, color.data());
+		_draw_instance_sets();
+		_draw_batches();
+	}
+
+	void duplicate_instance_renderer::render_depth()
+	{
+		_render_pass(render_pass_depth, _depth_shader);
+	}
+
+	void duplicate_instance_renderer::render_visibility()
+	{
+		_render_pass(render_pass_visibility, _visibility_shader);
+	}
+
+	void duplicate_instance_renderer::render_wireframe()
+	{
+		_color_ids_texture.bind();
+		_colors_texture.bind();
+		_flags_texture.bind();
+		_edges_texture.bind();
+		_render_pass(render_pass_wireframe, _wireframe_shader);
+	}
+
+	void duplicate_instance_renderer::bind_color_textures()
+	{
+		_color_ids_texture.bind();
+		_colors_texture.bind();
+		_flags_texture.bind();
+	}
+
+	void duplicate_instance_renderer::set_meshlet_culling(bool enabled)
+	{
+		_meshlet_culling = enabled;
+	}
+
+	bool duplicate_instance_renderer::get_meshlet_culling() const
+	{
+		return _meshlet_culling;
+	}
+
+	void duplicate_instance_renderer::set_lod_selection(bool enabled)
+	{
+		_lod_selection = enabled;
+	}
+
+	bool duplicate_instance_renderer::get_lod_selection() const
+	{
+		return _lod_selection;
+	}
+
+	void duplicate_instance_renderer::set_multi_draw(bool enabled)
+	{
+		_multi_draw = enabled;
+	}
+
+	bool duplicate_instance_renderer::get_multi_draw() const
+	{
+		return _multi_draw;
+	}
+
+	void duplicate_instance_renderer::set_instance_culling(bool enabled)
+	{
+		_instance_culling = enabled;
+	}
+
+	bool duplicate_instance_renderer::get_instance_culling() const
+	{
+		return _instance_culling;
+	}
+
+	void duplicate_instance_renderer::set_range_culling(bool enabled)
+	{
+		_range_culling = enabled;
+	}
+
+	bool duplicate_instance_renderer::get_range_culling() const
+	{
+		return _range_culling;
+	}
+
+	void duplicate_instance_renderer::set_merge_threshold(unsigned int instances)
+	{
+		_merge_threshold = instances;
+	}
+
+	unsigned int duplicate_instance_renderer::get_merge_threshold() const
+	{
+		return _merge_threshold;
+	}
+
+	void duplicate_instance_renderer::set_front_to_back(bool enabled)
+	{
+		_front_to_back = enabled;
+	}
+
+	bool duplicate_instance_renderer::get_front_to_back() const
+	{
+		return _front_to_back;
+	}
+
+	void duplicate_instance_renderer::set_dynamic_transforms(bool enabled)
+	{
+		// frames are allocated on first use, the static buffer stays for switching back
+		if(enabled && !_transform_ring.is_created() && !_transform_ring.create(_cpu_transform_buffer, TRANSFORM_TEX_UNIT))
+		{
+			io::print("dynamic transforms unavailable");
+			enabled = false;
+		}
+		_dynamic_transforms = enabled;
+	}
+
+	bool duplicate_instance_renderer::get_dynamic_transforms() const
+	{
+		return _dynamic_transforms;
+	}
+
+	mat34* duplicate_instance_renderer::map_transforms()
+	{
+		return _dynamic_transforms ? _transform_ring.begin_frame() : nullptr;
+	}
+
+	void duplicate_instance_renderer::set_transform(mat34* frame, instance_handle handle, const mat34& transform)
+	{
+		set_transform(handle, transform);
+		const auto slot = _slots.get_slot(handle);
+		if(frame != nullptr && slot != NO_SLOT)
+		{
+			frame[slot] = _cpu_transform_buffer[slot];
+		}
+	}
+
+	const vector<mat34>& duplicate_instance_renderer::get_transforms() const
+	{
+		return _cpu_transform_buffer;
+	}
+
+	unsigned int duplicate_instance_renderer::get_transform_stalls() const
+	{
+		return _transform_ring.get_stalls();
+	}
+
+	const duplicate_instance_renderer::upload_stats& duplicate_instance_renderer::get_upload_stats() const
+	{
+		return _upload_stats;
+	}
+
+	duplicate_instance_renderer::layout_stats duplicate_instance_renderer::get_layout_stats() const
+	{
+		layout_stats stats;
+		stats.slots = _cpu_transform_buffer.size();
+		stats.spare_slots = _slots.get_spare_count();
+		stats.pending_instances = _slots.get_pending().size();
+		stats.repacks = _repacks;
+		stats.vertex_bytes = _vertex_allocator.get_used_bytes();
+		stats.element_bytes = _element_allocator.get_used_bytes();
+		stats.buffer_grows = _vertex_allocator.get_grow_count() + _element_allocator.get_grow_count();
+		return stats;
+	}
+
+	void duplicate_instance_renderer::set_feature_edges(bool enabled)
+	{
+		_feature_edges = enabled;
+		_wireframe_shader.set_uniform("feature_edges", enabled ? 1 : 0);
+		_merged_wireframe_shader.set_uniform("feature_edges", enabled ? 1 : 0);
+	}
+
+	bool duplicate_instance_renderer::get_feature_edges() const
+	{
+		return _feature_edges;
+	}
+
+	void duplicate_instance_renderer::set_small_feature_mode(small_feature_mode mode)
+	{
+		_small_feature_mode = mode;
+	}
+
+	small_feature_mode duplicate_instance_renderer::get_small_feature_mode() const
+	{
+		return _small_feature_mode;
+	}
+
+	void duplicate_instance_renderer::set_small_feature_pixels(float pixels)
+	{
+		_small_feature_pixels = pixels;
+	}
+
+	float duplicate_instance_renderer::get_small_feature_pixels() const
+	{
+		return _small_feature_pixels;
+	}
+
+	void duplicate_instance_renderer::set_occlusion_buffer(const occlusion_buffer* buffer)
+	{
+		_occlusion = buffer;
+	}
+
+	void duplicate_instance_renderer::add_occluders(occlusion_buffer& buffer) const
+	{
+		// dynamic frames move every instance away from the transforms the occluders would be drawn with
+		if(!_is_testing_bounds())
+		{
+			return;
+		}
+
+		// largest candidates on screen first
+		vector<std::pair<float, unsigned int>> candidates;
+		for(auto instance : _occluder_instances)
+		{
+			// animated occluders are drawn somewhere along their track, hidden and ghosted ones do not hide anything
+			if(!_is_live_slot(instance))
+			{
+				continue;
+			}
+			if(_is_animating_on_gpu() && instance < _slot_tracks.size() && _slot_tracks[instance] >= 0)
+			{
+				continue;
+			}
+			if(_cpu_flag_buffer[instance] & (instance_hidden | instance_ghosted))
+			{
+				continue;
+			}
+			const auto& b = _instance_bounds[instance];
+			if(_frustum.is_sphere_outside(b.center, b.radius))
+			{
+				continue;
+			}
+			const auto pixels = _frustum.projected_radius(b.center, b.radius);
+			if(pixels >= OCCLUDER_MIN_PIXELS)
+			{
+				candidates.emplace_back(pixels, instance);
+			}
+		}
+
+		const auto count = math::min(static_cast<unsigned int>(candidates.size()), MAX_OCCLUDERS);
+		std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), std::greater<std::pair<float, unsigned int>>());
+
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			const auto instance = candidates[i].second;
+			const auto& mesh = _occluder_meshes[_set_occluder_mesh[_instance_set_index[instance]]];
+			buffer.rasterize(mesh.positions, mesh.elements, _cpu_transform_buffer[instance]);
+		}
+	}
+
+	const duplicate_instance_renderer::cull_stats& duplicate_instance_renderer::get_cull_stats() const
+	{
+		return _stats;
+	}
+
+	unsigned int duplicate_instance_renderer::count_culled_triangles(const frustum& f) const
+	{
+		unsigned int culled_triangles = 0;
+		vector<draw_range> ranges;
+		for(const auto& instances : _instance_sets)
+		{
+			for(int i = 0; i < instances.count && instances.meshlet_count > 0; ++i)
+			{
+				ranges.clear();
+				culled_triangles += cull_meshlets(_meshlets.data() + instances.first_meshlet, instances.meshlet_count,
+												  _cpu_transform_buffer[instances.tex_offset + i], f, ranges);
+			}
+		}
+		return culled_triangles;
+	}
+
+	unsigned int duplicate_instance_renderer::count_visible_instances(const frustum& f) const
+	{
+		vector<unsigned int> visible;
+		return _bvh.cull(f, visible);
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
-	// private
-	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 
-	void duplicate_instance_renderer::_add_mesh(const tess::triangle_mesh& mesh, const mat4& transform, bool remove_duplicate_vertices /*= false*/)
+	void duplicate_instance_renderer::_draw_instance_sets()
+	{
+		_stats = cull_stats();
+		_draw_commands.clear();
+		_point_commands.clear();
+
+		// hidden instances are compacted out of the per-frame lists
+		if(_is_selecting_lods() || _is_culling_instances() || _is_filtering_small_features() || _hidden_instances > 0)
+		{
+			_draw_instance_lists();
+			_submit_draw_commands();
+			return;
+		}
+
+		if(_front_to_back)
+		{
+			_order_sets();
+		}
+
+		// nothing changes from frame to frame without culling, draw every set from the static commands
+		if(_multi_draw && !_is_culling_meshlets() && !_is_culling_ranges() && !_front_to_back && !_is_drawing_feature_edges())
+		{
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _set_commands_buffer);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, GLB_BYTE_OFFSET(0), _set_command_count, 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			_stats.drawn_triangles = _total_triangles;
+			_stats.draw_calls = 1;
+			return;
+		}
+
+		for(unsigned int k = 0; k < _instance_sets.size(); ++k)
+		{
+			const auto& instances = _instance_sets[_front_to_back ? _set_order[k].second : k];
+			if(instances.count == 0)
+			{
+				continue;
+			}
+			if(_is_culling_meshlets() && instances.meshlet_count > 0)
+			{
+				_meshlet_draws.clear();
+				for(int i = 0; i < instances.count; ++i)
+				{
+					_append_meshlet_draws(instances, i, _meshlet_draws);
+				}
+				for(const auto& draw : _meshlet_draws)
+				{
+					_draw_elements(draw.element_count, draw.element_byte_offset, draw.count, draw.base_vertex, draw.first_instance);
+				}
+				continue;
+			}
+
+			if(_is_culling_ranges())
+			{
+				_draw_instance_ranges(instances);
+				continue;
+			}
+
+//			glVertexAttrib3fv(7, instances.color.data());
+			_draw_elements(instances.element_count, instances.element_byte_offset, instances.count, instances.base_vertex, instances.tex_offset);
+		}
+
+		_submit_draw_commands();
+	}
+
+	void duplicate_instance_renderer::_draw_instance_lists()
+	{
+		// 1. culling, level selection and the list upload happen once per view, the pre-pass and the shading pass draw the same
+		if(!_lists_valid)
+		{
+			_build_instance_lists();
+			_list_stats = _stats;
+			_lists_valid = true;
+		}
+		_stats = _list_stats;
+
+		// 2. replay
+		for(const auto& draw : _instance_draws)
+		{
+			_draw_elements(draw.element_count, draw.element_byte_offset, draw.count, draw.base_vertex, draw.first_instance);
+		}
+
+		// no points in the depth pre-pass, and none through the wireframe geometry stage which needs triangles
+		if(_pass == render_pass_depth || _point_draws.empty())
+		{
+			return;
+		}
+		if(_pass == render_pass_wireframe && !_multi_draw)
+		{
+			_shader.bind();
+		}
+		for(const auto& draw : _point_draws)
+		{
+			_draw_points(draw.base_vertex, draw.count, draw.first_instance);
+		}
+	}
+
+	void duplicate_instance_renderer::_build_instance_lists()
+	{
+		if(_front_to_back)
+		{
+			_order_sets();
+		}
+
+		// 1. visible instances grouped by set, counting sort of the bvh output
+		const auto culling = _is_culling_instances();
+		if(culling)
+		{
+			_visible.clear();
+			_bvh.cull(_frustum, _visible);
+			_stats.culled_instances = _total_geometries - math::min(static_cast<unsigned int>(_visible.size()), _total_geometries);
+
+			if(_occlusion)
+			{
+				const auto in_frustum = _visible.size();
+				_visible.erase(std::remove_if(_visible.begin(), _visible.end(), [this](unsigned int instance)
+				{
+					const auto& b = _instance_bounds[instance];
+					return !_occlusion->is_sphere_visible(b.center, b.radius);
+				}), _visible.end());
+				_stats.occluded_instances = in_frustum - _visible.size();
+			}
+
+			_set_offsets.assign(_instance_sets.size() + 1, 0);
+			for(auto instance : _visible)
+			{
+				++_set_offsets[_instance_set_index[instance] + 1];
+			}
+			for(unsigned int s = 0; s < _instance_sets.size(); ++s)
+			{
+				_set_offsets[s + 1] += _set_offsets[s];
+			}
+
+			// after placement each offset has moved to the end of its set
+			_visible_by_set.resize(_visible.size());
+			for(auto instance : _visible)
+			{
+				_visible_by_set[_set_offsets[_instance_set_index[instance]]++] = instance;
+			}
+		}
+
+		// 2. regroup instances of each set into per-LOD instance lists
+		_cpu_instance_list.clear();
+		_instance_draws.clear();
+		_point_draws.clear();
+
+		for(unsigned int k = 0; k < _instance_sets.size(); ++k)
+		{
+			const auto s = _front_to_back ? _set_order[k].second : k;
+			const auto& instances = _instance_sets[s];
+			for(auto& bucket : _lod_buckets)
+			{
+				bucket.clear();
+			}
+			_point_bucket.clear();
+
+			const auto first = culling ? (s == 0 ? 0 : _set_offsets[s - 1]) : 0;
+			const auto last = culling ? _set_offsets[s] : instances.count;
+			for(auto k = first; k < last; ++k)
+			{
+				const auto i = culling ? _visible_by_set[k] - instances.tex_offset : k;
+				if(i >= static_cast<unsigned int>(instances.count))
+				{
+					// empty slot past the instances of the set
+					continue;
+				}
+				if(_cpu_flag_buffer[instances.tex_offset + i] & instance_hidden)
+				{
+					++_stats.hidden_instances;
+					continue;
+				}
+				const auto l = _is_selecting_lods() ? _select_lod(instances, i) : 0;
+
+				// small features are dropped or reduced to the set's center point
+				if(_is_filtering_small_features())
+				{
+					const auto& b = _instance_bounds[instances.tex_offset + i];
+					if(_frustum.projected_radius(b.center, b.radius) < _small_feature_pixels)
+					{
+						++_stats.small_instances;
+						_stats.saved_triangles += _lods[instances.first_lod + l].element_count / 3;
+						if(_small_feature_mode == small_feature_point)
+						{
+							_point_bucket.push_back(instances.tex_offset + i);
+						}
+						continue;
+					}
+				}
+
+				if(l == 0 && _is_culling_meshlets() && instances.meshlet_count > 0)
+				{
+					_append_meshlet_draws(instances, i, _instance_draws);
+					continue;
+				}
+				_lod_buckets[l].push_back(instances.tex_offset + i);
+			}
+
+			for(int l = 0; l < instances.lod_count; ++l)
+			{
+				const auto& bucket = _lod_buckets[l];
+				if(bucket.empty())
+				{
+					continue;
+				}
+
+				instance_draw draw;
+				draw.element_count = _lods[instances.first_lod + l].element_count;
+				draw.element_byte_offset = _lods[instances.first_lod + l].element_byte_offset;
+				draw.base_vertex = instances.base_vertex;
+				draw.first_instance = _list_offset + _cpu_instance_list.size();
+				draw.count = bucket.size();
+				_instance_draws.push_back(draw);
+
+				_cpu_instance_list.insert(_cpu_instance_list.end(), bucket.begin(), bucket.end());
+			}
+
+			if(!_point_bucket.empty())
+			{
+				instance_draw draw;
+				draw.base_vertex = instances.point_vertex;
+				draw.first_instance = _list_offset + _cpu_instance_list.size();
+				draw.count = _point_bucket.size();
+				_point_draws.push_back(draw);
+
+				_cpu_instance_list.insert(_cpu_instance_list.end(), _point_bucket.begin(), _point_bucket.end());
+			}
+		}
+
+		// 3. upload lists after the identity range
+		glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, _list_offset * sizeof(unsigned int), _cpu_instance_list.size() * sizeof(unsigned int), _cpu_instance_list.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void duplicate_instance_renderer::_render_pass(render_pass pass, glb::shader_program& program)
+	{
+		_pass = pass;
+		program.bind();
+		_bind_transforms();
+		glBindVertexArray(_main_vao);
+		_draw_instance_sets();
+		_draw_batches();
+		_pass = render_pass_color;
+	}
+
+	void duplicate_instance_renderer::_draw_batches()
+	{
+		if(_batches.empty())
+		{
+			return;
+		}
+
+		// 1. visible batches, nearest first if ordered
+		const auto culling = _is_culling_instances() || _range_culling;
+		const auto& eye = _frustum.get_eye();
+		_visible_batches.clear();
+		for(unsigned int b = 0; b < _batches.size(); ++b)
+		{
+			const auto& bounds = _batches[b].bounds;
+			if(!culling || !_frustum.is_sphere_outside(bounds.center, bounds.radius))
+			{
+				_visible_batches.emplace_back(_front_to_back ? distance_to_sphere(eye, bounds) : 0.0f, b);
+			}
+		}
+		if(_visible_batches.empty())
+		{
+			return;
+		}
+		if(_front_to_back)
+		{
+			std::sort(_visible_batches.begin(), _visible_batches.end());
+		}
+
+		// 2. batches are consecutive in the element buffer, neighbours in draw order merge into one range
+		_batch_counts.clear();
+		_batch_offsets.clear();
+		unsigned int next_offset = 0;
+		for(const auto& visible : _visible_batches)
+		{
+			const auto& batch = _batches[visible.second];
+			if(!_batch_counts.empty() && static_cast<unsigned int>(batch.element_byte_offset) == next_offset)
+			{
+				_batch_counts.back() += batch.element_count;
+			}
+			else
+			{
+				_batch_counts.push_back(batch.element_count);
+				_batch_offsets.push_back(GLB_BYTE_OFFSET(batch.element_byte_offset));
+			}
+			next_offset = batch.element_byte_offset + batch.element_count * sizeof(unsigned int);
+			_stats.drawn_triangles += batch.element_count / 3;
+		}
+
+		glb::shader_program* programs[] = {&_merged_shader, &_merged_depth_shader, &_merged_visibility_shader, &_merged_wireframe_shader};
+		programs[_pass]->bind();
+		_colors_texture.bind();
+		_merged_edges_texture.bind();
+		glBindVertexArray(_merged_vao);
+		if(_is_drawing_feature_edges())
+		{
+			for(unsigned int r = 0; r < _batch_counts.size(); ++r)
+			{
+				glUniform1i(_merged_triangle_base_location, static_cast<int>(reinterpret_cast<size_t>(_batch_offsets[r]) / (3 * sizeof(unsigned int))));
+				glDrawElements(GL_TRIANGLES, _batch_counts[r], GL_UNSIGNED_INT, _batch_offsets[r]);
+			}
+			_stats.draw_calls += _batch_counts.size();
+		}
+		else
+		{
+			glMultiDrawElements(GL_TRIANGLES, _batch_counts.data(), GL_UNSIGNED_INT, _batch_offsets.data(), _batch_counts.size());
+			++_stats.draw_calls;
+		}
+		glBindVertexArray(0);
+	}
+
+	void duplicate_instance_renderer::_order_sets()
+	{
+		// a set is as near as its nearest range of instances
+		const auto& eye = _frustum.get_eye();
+		_set_order.resize(_instance_sets.size());
+		for(unsigned int s = 0; s < _instance_sets.size(); ++s)
+		{
+			const auto& instances = _instance_sets[s];
+			auto distance = math::limit_posf();
+			for(int r = instances.first_range; r < instances.first_range + instances.range_count; ++r)
+			{
+				distance = math::min(distance, distance_to_sphere(eye, _instance_ranges[r].bounds));
+			}
+			_set_order[s] = std::make_pair(distance, s);
+		}
+		std::sort(_set_order.begin(), _set_order.end());
+	}
+
+	void duplicate_instance_renderer::_draw_instance_ranges(const instance_set& instances)
+	{
+		// ranges are consecutive in the transform buffer, neighbouring visible ranges merge into one call
+		// ranges cover the empty slots of the set as well, only its instances are drawn
+		int first = 0;
+		int count = 0;
+		for(int r = instances.first_range; r < instances.first_range + instances.range_count; ++r)
+		{
+			const auto& range = _instance_ranges[r];
+			const int live = math::max(math::min(static_cast<int>(range.count), instances.count - static_cast<int>(range.first)), 0);
+			if(live == 0)
+			{
+				break;
+			}
+			if(!_frustum.is_sphere_outside(range.bounds.center, range.bounds.radius))
+			{
+				first = count == 0 ? range.first : first;
+				count += live;
+				continue;
+			}
+
+			_stats.culled_instances += live;
+			if(count > 0)
+			{
+				_draw_elements(instances.element_count, instances.element_byte_offset, count, instances.base_vertex, instances.tex_offset + first);
+				count = 0;
+			}
+		}
+
+		if(count > 0)
+		{
+			_draw_elements(instances.element_count, instances.element_byte_offset, count, instances.base_vertex, instances.tex_offset + first);
+		}
+	}
+
+	void duplicate_instance_renderer::_append_meshlet_draws(const instance_set& instances, int instance, vector<instance_draw>& draws)
+	{
+		// only the visible clusters of this instance, as merged element ranges read through the identity part of the instance buffer
+		_draw_ranges.clear();
+		const auto culled = cull_meshlets(_meshlets.data() + instances.first_meshlet, instances.meshlet_count,
+										  _cpu_transform_buffer[instances.tex_offset + instance], _frustum, _draw_ranges);
+
+		// ranges become commands of the one indirect submission of the pass, otherwise too many of them cost more calls than
+		// the culled triangles save
+		if(_draw_ranges.size() > MAX_MESHLET_RANGES && (!_multi_draw || _is_drawing_feature_edges()))
+		{
+			_draw_ranges.clear();
+			_draw_ranges.push_back({0, static_cast<unsigned int>(instances.element_count)});
+		}
+		else
+		{
+			_stats.culled_triangles += culled;
+		}
+
+		// the same range of the previous instance of the set grows into an instanced draw
+		for(const auto& r : _draw_ranges)
+		{
+			const int byte_offset = instances.element_byte_offset + r.first_element * sizeof(tess::element);
+			const int first_instance = instances.tex_offset + instance;
+			if(!draws.empty())
+			{
+				auto& last = draws.back();
+				if(last.element_byte_offset == byte_offset && last.element_count == static_cast<int>(r.element_count) &&
+				   last.base_vertex == instances.base_vertex && last.first_instance + last.count == first_instance)
+				{
+					++last.count;
+					continue;
+				}
+			}
+
+			instance_draw draw;
+			draw.element_count = r.element_count;
+			draw.element_byte_offset = byte_offset;
+			draw.base_vertex = instances.base_vertex;
+			draw.first_instance = first_instance;
+			draw.count = 1;
+			draws.push_back(draw);
+		}
+	}
+
+	void duplicate_instance_renderer::_draw_elements(int element_count, int element_byte_offset, int instance_count, int base_vertex, int base_instance)
+	{
+		_stats.drawn_triangles += element_count / 3 * instance_count;
+
+		if(_multi_draw && !_is_drawing_feature_edges())
+		{
+			draw_command command;
+			command.count = element_count;
+			command.instance_count = instance_count;
+			command.first_index = element_byte_offset / sizeof(tess::element);
+			command.base_vertex = base_vertex;
+			command.base_instance = base_instance;
+			_draw_commands.push_back(command);
+			return;
+		}
+
+		// primitive ids restart with every draw, the masks of this draw start at its first triangle
+		if(_is_drawing_feature_edges())
+		{
+			glUniform1i(_triangle_base_location, element_byte_offset / (3 * sizeof(tess::element)));
+		}
+
+		// base_instance offsets the per-instance index attribute
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, element_count, GL_UNSIGNED_INT, GLB_BYTE_OFFSET(element_byte_offset), instance_count, base_vertex, base_instance);
+		++_stats.draw_calls;
+	}
+
+	void duplicate_instance_renderer::_draw_points(int first_vertex, int instance_count, int base_instance)
+	{
+		if(_multi_draw)
+		{
+			point_command command;
+			command.count = 1;
+			command.instance_count = instance_count;
+			command.first = first_vertex;
+			command.base_instance = base_instance;
+			_point_commands.push_back(command);
+			return;
+		}
+
+		glDrawArraysInstancedBaseInstance(GL_POINTS, first_vertex, 1, instance_count, base_instance);
+		++_stats.draw_calls;
+	}
+
+	void duplicate_instance_renderer::_submit_draw_commands()
+	{
+		if(_draw_commands.empty() && _point_commands.empty())
+		{
+			return;
+		}
+
+		// orphan last frame's commands instead of waiting for the GPU to consume them
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _frame_commands_buffer);
+		if(!_draw_commands.empty())
+		{
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, _draw_commands.size() * sizeof(draw_command), _draw_commands.data(), GL_STREAM_DRAW);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, GLB_BYTE_OFFSET(0), _draw_commands.size(), 0);
+			++_stats.draw_calls;
+		}
+		if(!_point_commands.empty())
+		{
+			if(_pass == render_pass_wireframe)
+			{
+				_shader.bind();
+			}
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, _point_commands.size() * sizeof(point_command), _point_commands.data(), GL_STREAM_DRAW);
+			glMultiDrawArraysIndirect(GL_POINTS, GLB_BYTE_OFFSET(0), _point_commands.size(), 0);
+			++_stats.draw_calls;
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	int duplicate_instance_renderer::_select_lod(const instance_set& instances, int instance) const
+	{
+		// coarsest level whose simplification error projects below the pixel tolerance at the nearest point of the mesh
+		const auto& t = _cpu_transform_buffer[instances.tex_offset + instance];
+		const auto scale = t.max_scale();
+		const auto d = t.mul(instances.center) - _frustum.get_eye();
+		const auto distance = std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z) - instances.radius * scale;
+		if(distance <= 0.0f)
+		{
+			return 0;
+		}
+
+		const auto pixels_per_unit = scale * _frustum.get_pixel_scale() / distance;
+		for(int l = instances.lod_count - 1; l > 0; --l)
+		{
+			if(_lods[instances.first_lod + l].error * pixels_per_unit <= LOD_PIXEL_ERROR)
+			{
+				return l;
+			}
+		}
+		return 0;
+	}
+
+	bool duplicate_instance_renderer::_is_culling_instances() const
+	{
+		// occlusion tests only make sense for instances inside the frustum
+		return (_instance_culling || _occlusion != nullptr) && _is_testing_bounds();
+	}
+
+	void duplicate_instance_renderer::_bind_transforms()
+	{
+		// instances added and removed since the last frame are laid out before anything goes up
+		if(_layout_dirty)
+		{
+			_repack_slots();
+		}
+		if(_set_commands_dirty)
+		{
+			_upload_set_commands();
+		}
+		_upload_dirty_ranges();
+
+		// tracks go up once, each pass then only sets the time
+		const auto animating = _is_animating_on_gpu();
+		if(animating)
+		{
+			_upload_animation_tracks();
+			glActiveTexture(GL_TEXTURE0 + ANIMATION_TEX_UNIT);
+			glBindTexture(GL_TEXTURE_BUFFER, _tracks_texture);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		glUniform1f(_animation_time_locations[_pass], animating ? _animation_time : -1.0f);
+
+		if(_dynamic_transforms)
+		{
+			_transform_ring.bind();
+			return;
+		}
+		_transform_texture.bind();
+	}
+
+	void duplicate_instance_renderer::_upload_dirty_ranges()
+	{
+		if(!_dirty_transforms.is_dirty() && !_dirty_color_ids.is_dirty() && !_dirty_flags.is_dirty() && !_palette_dirty)
+		{
+			return;
+		}
+		_lists_valid = false;
+
+		// 1. bounds of moved instances
+		_refit_moved_instances();
+
+		// 2. consecutive dirty pages of each stream go up as one range
+		_upload_stats.uploaded_bytes += upload_ranges(_transform_buffer_id, _dirty_transforms, _cpu_transform_buffer.data(), _dirty_ranges);
+		_upload_stats.ranges += _dirty_ranges.size();
+		_upload_stats.uploaded_bytes += upload_ranges(_color_id_buffer_id, _dirty_color_ids, _cpu_color_id_buffer.data(), _dirty_ranges);
+		_upload_stats.ranges += _dirty_ranges.size();
+		_upload_stats.uploaded_bytes += upload_ranges(_flag_buffer_id, _dirty_flags, _cpu_flag_buffer.data(), _dirty_ranges);
+		_upload_stats.ranges += _dirty_ranges.size();
+
+		// 3. the palette is a single kilobyte, sent whole
+		if(_palette_dirty)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, _colors_buffer_id);
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, _palette.size() * sizeof(color), _palette.data());
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			_upload_stats.uploaded_bytes += _palette.size() * sizeof(color);
+			++_upload_stats.ranges;
+			_palette_dirty = false;
+		}
+	}
+
+	void duplicate_instance_renderer::_refit_moved_instances()
+	{
+		if(_moved_instances.empty())
+		{
+			return;
+		}
+
+		// 1. world bounds of every moved instance, and the ranges holding them with their set
+		vector<std::pair<unsigned int, unsigned int>> ranges;
+		for(auto instance : _moved_instances)
+		{
+			const auto set = _instance_set_index[instance];
+			const auto& instances = _instance_sets[set];
+			const auto& t = _cpu_transform_buffer[instance];
+			auto& b = _instance_bounds[instance];
+			b.center = t.mul(instances.center);
+			b.radius = instances.radius * t.max_scale();
+			if(_is_animating_on_gpu() && instance < _slot_tracks.size() && _slot_tracks[instance] >= 0)
+			{
+				// the vertex stage moves the instance anywhere along its track, rotations swing the center about the pivot
+				const auto& track = _tracks[_slot_tracks[instance]];
+				const auto d = b.center - track.pivot;
+				b.radius += track.reach + 2.0f * std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z);
+			}
+			ranges.push_back(std::make_pair(instances.first_range + (instance - instances.tex_offset) / INSTANCE_RANGE_SIZE, set));
+		}
+
+		// 2. ranges are re-enclosed once each, the hierarchy keeps its topology and only refits the leaves of moved instances
+		std::sort(ranges.begin(), ranges.end());
+		ranges.erase(std::unique(ranges.begin(), ranges.end()), ranges.end());
+		for(const auto& r : ranges)
+		{
+			auto& range = _instance_ranges[r.first];
+			range.bounds = enclosing_sphere(_instance_bounds.data() + _instance_sets[r.second].tex_offset + range.first, range.count);
+		}
+		_bvh.refit(_instance_bounds, _moved_instances);
+		_upload_stats.refit_nodes += _bvh.get_refit_node_count();
+		_moved_instances.clear();
+	}
+
+	unsigned int duplicate_instance_renderer::_write_color_id(unsigned int slot, unsigned char color_id)
+	{
+		if(_cpu_color_id_buffer[slot] == color_id)
+		{
+			return 0;
+		}
+		_cpu_color_id_buffer[slot] = color_id;
+		_dirty_color_ids.mark(slot * sizeof(unsigned char), sizeof(unsigned char));
+		return 1;
+	}
+
+	void duplicate_instance_renderer::_write_flags(unsigned int slot, unsigned char flags)
+	{
+		// only changed slots dirty their page
+		const auto previous = _cpu_flag_buffer[slot];
+		if(previous == flags)
+		{
+			return;
+		}
+		_hidden_instances += (flags & instance_hidden ? 1 : 0) - (previous & instance_hidden ? 1 : 0);
+		_cpu_flag_buffer[slot] = flags;
+		_dirty_flags.mark(slot * sizeof(unsigned char), sizeof(unsigned char));
+	}
+
+	void duplicate_instance_renderer::_upload_animation_tracks()
+	{
+		if(!_tracks_dirty)
+		{
+			return;
+		}
+
+		// 1. track texel of every slot, four to a texel
+		const unsigned int slots = _cpu_transform_buffer.size();
+		_track_texels.assign((slots + 3) / 4 * 4, -1.0f);
+
+		// 2. header and keys of every track
+		for(const auto& track : _tracks)
+		{
+			if(track.keys.empty())
+			{
+				continue;
+			}
+			_track_texels[track.slot] = static_cast<float>(_track_texels.size() / 4);
+			_track_texels.insert(_track_texels.end(), {track.pivot.x, track.pivot.y, track.pivot.z, static_cast<float>(track.keys.size())});
+			for(const auto& k : track.keys)
+			{
+				_track_texels.insert(_track_texels.end(), {k.translation.x, k.translation.y, k.translation.z, k.time,
+														   k.rotation[0], k.rotation[1], k.rotation[2], k.rotation[3]});
+			}
+		}
+
+		// 3. tracks change far less often than the time, the whole buffer is replaced
+		if(_tracks_buffer == 0)
+		{
+			glGenBuffers(1, &_tracks_buffer);
+			glGenTextures(1, &_tracks_texture);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, _tracks_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, _track_texels.size() * sizeof(float), _track_texels.data(), GL_STATIC_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, _tracks_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _tracks_buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		_upload_stats.uploaded_bytes += _track_texels.size() * sizeof(float);
+		_tracks_dirty = false;
+	}
+
+	void duplicate_instance_renderer::_write_animated_transform(unsigned int track)
+	{
+		// the reference path writes the evaluated transform, otherwise the vertex stage animates the rest transform
+		const auto& t = _tracks[track];
+		if(t.slot == NO_SLOT)
+		{
+			return;
+		}
+		const auto evaluate = _cpu_animation && _animation_time >= 0.0f && !t.keys.empty();
+		_cpu_transform_buffer[t.slot] = evaluate ? evaluate_track(t.keys.data(), t.keys.size(), t.pivot, _animation_time, t.rest) : t.rest;
+		_dirty_transforms.mark(t.slot * sizeof(mat34), sizeof(mat34));
+		_moved_instances.push_back(t.slot);
+	}
+
+	bool duplicate_instance_renderer::_is_animating_on_gpu() const
+	{
+		return _animated_slots > 0 && _animation_time >= 0.0f && !_cpu_animation;
+	}
+
+	void duplicate_instance_renderer::_merge_low_count_meshes()
+	{
+		// 1. take meshes with few instances out of the instanced path
+		const auto unique_mesh_count = _unique_meshes.size();
+		vector<point_set> merged;
+		unsigned int instanced_bytes = 0;
+		for(auto itr = _unique_meshes.begin(); itr != _unique_meshes.end();)
+		{
+			auto& ps = itr->second;
+			if(ps.transforms.size() >= _merge_threshold)
+			{
+				++itr;
+				continue;
+			}
+
+			const auto vertex_bytes = ps.mesh.vertices.size() * sizeof(tess::vertex);
+			const auto element_bytes = ps.mesh.elements.size() * sizeof(tess::element);
+			instanced_bytes += vertex_bytes + element_bytes + ps.transforms.size() * (sizeof(mat34) + sizeof(unsigned char));
+			_total_vbo_size_bytes -= vertex_bytes;
+			_total_ebo_size_bytes -= element_bytes;
+			_total_memory -= vertex_bytes + element_bytes;
+			_total_geometries -= ps.transforms.size();
+			_total_triangles -= ps.transforms.size() * ps.mesh.elements.size() / 3;
+
+			merged.push_back(std::move(ps));
+			itr = _unique_meshes.erase(itr);
+		}
+
+		if(merged.empty())
+		{
+			return;
+		}
+
+		// 2. world bounds of every merged instance, in morton order of their centers
+		struct merged_instance
+		{
+			unsigned int mesh = 0;
+			unsigned int transform = 0;
+			bounding_sphere bounds;
+		};
+		vector<merged_instance> instances;
+		bbox centers;
+		for(unsigned int m = 0; m < merged.size(); ++m)
+		{
+			bbox mesh_bounds;
+			for(const auto& v : merged[m].mesh.vertices)
+			{
+				mesh_bounds.expand(v.position);
+			}
+			const auto center = (mesh_bounds.min + mesh_bounds.max) * 0.5f;
+			float radius = 0.0f;
+			for(const auto& v : merged[m].mesh.vertices)
+			{
+				const auto d = v.position - center;
+				radius = math::max(radius, std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z));
+			}
+
+			for(unsigned int t = 0; t < merged[m].transforms.size(); ++t)
+			{
+				merged_instance instance;
+				instance.mesh = m;
+				instance.transform = t;
+				instance.bounds.center = merged[m].transforms[t].mul(center);
+				instance.bounds.radius = radius * merged[m].transforms[t].max_scale();
+				centers.expand(instance.bounds.center);
+				instances.push_back(instance);
+			}
+		}
+
+		vector<std::pair<unsigned int, unsigned int>> codes(instances.size());
+		for(unsigned int i = 0; i < instances.size(); ++i)
+		{
+			codes[i] = std::make_pair(morton_code(instances[i].bounds.center, centers), i);
+		}
+		std::sort(codes.begin(), codes.end());
+
+		// 3. pre-transform instances into batches of bounded vertex count
+		vector<merged_vertex> vertices;
+		vector<unsigned int> elements;
+		vector<bounding_sphere> batch_instances;
+		vector<vector<unsigned char>> mesh_edges(merged.size());
+		vector<unsigned char> edge_masks;
+		auto close_batch = [&]()
+		{
+			merged_batch batch;
+			batch.element_byte_offset = (_batches.empty() ? 0 : _batches.back().element_byte_offset + _batches.back().element_count * sizeof(unsigned int));
+			batch.element_count = elements.size() - batch.element_byte_offset / sizeof(unsigned int);
+			batch.bounds = enclosing_sphere(batch_instances.data(), batch_instances.size());
+			_batches.push_back(batch);
+			batch_instances.clear();
+		};
+
+		unsigned int batch_vertices = 0;
+		for(const auto& code : codes)
+		{
+			const auto& instance = instances[code.second];
+			const auto& ps = merged[instance.mesh];
+			if(!batch_instances.empty() && batch_vertices + ps.mesh.vertices.size() > MERGED_BATCH_MAX_VERTICES)
+			{
+				close_batch();
+				batch_vertices = 0;
+			}
+
+			const auto transform = ps.transforms[instance.transform].as_mat4();
+			const auto normal_transform = transform.to_normal_matrix();
+			const unsigned int base_vertex = vertices.size();
+			for(const auto& v : ps.mesh.vertices)
+			{
+				merged_vertex mv;
+				mv.position = transform.mul(v.position);
+				mv.normal = normal_transform.mul3x3(v.normal);
+				mv.color_id = ps.color_ids[instance.transform];
+				vertices.push_back(mv);
+			}
+			for(const auto e : ps.mesh.elements)
+			{
+				elements.push_back(base_vertex + e);
+			}
+
+			// creases do not change under the instance transform, masks are computed once per mesh
+			auto& masks = mesh_edges[instance.mesh];
+			if(masks.empty())
+			{
+				masks = compute_feature_edges(ps.mesh.elements, ps.mesh.vertices, FEATURE_CREASE_ANGLE);
+			}
+			edge_masks.insert(edge_masks.end(), masks.begin(), masks.end());
+
+			batch_vertices += ps.mesh.vertices.size();
+			batch_instances.push_back(instance.bounds);
+		}
+		close_batch();
+
+		// 4. both policies, one call per unique mesh against one per remaining mesh and batch
+		const auto merged_bytes = vertices.size() * sizeof(merged_vertex) + elements.size() * sizeof(unsigned int) + edge_masks.size() * sizeof(unsigned char);
+		_total_memory += merged_bytes;
+		io::print("merged meshes:", merged.size(), "with", instances.size(), "instances into", _batches.size(), "batches");
+		io::print("draw calls instanced:", unique_mesh_count, "merged:", _unique_meshes.size() + _batches.size());
+		io::print("memory of merged meshes instanced:", instanced_bytes / 1024.0f / 1024.0f, "MB merged:", merged_bytes / 1024.0f / 1024.0f, "MB");
+
+		// 5. the batches are sent by end_upload
+		_merged_vertices.swap(vertices);
+		_merged_elements.swap(elements);
+		_merged_edge_masks.swap(edge_masks);
+	}
+
+	void duplicate_instance_renderer::_upload_merged_batches()
+	{
+		glGenVertexArrays(1, &_merged_vao);
+		glBindVertexArray(_merged_vao);
+
+		glGenBuffers(1, &_merged_vertex_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, _merged_vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, _merged_vertices.size() * sizeof(merged_vertex), _merged_vertices.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(merged_vertex), GLB_BYTE_OFFSET(0));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(merged_vertex), GLB_BYTE_OFFSET(sizeof(vec3)));
+		glEnableVertexAttribArray(INSTANCE_ATTRIB);
+		glVertexAttribIPointer(INSTANCE_ATTRIB, 1, GL_UNSIGNED_INT, sizeof(merged_vertex), GLB_BYTE_OFFSET(2 * sizeof(vec3)));
+
+		glGenBuffers(1, &_merged_element_buffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _merged_element_buffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, _merged_elements.size() * sizeof(unsigned int), _merged_elements.data(), GL_STATIC_DRAW);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+		glb::buffer edges_buffer;
+		edges_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, _merged_edge_masks.size() * sizeof(unsigned char));
+		edges_buffer.add(_merged_edge_masks.data(), _merged_edge_masks.size());
+		_merged_edges_texture.create(EDGES_TEX_UNIT, glb::target_texture_buffer);
+		_merged_edges_texture.set_data_source(glb::internal_format_r8ui, edges_buffer);
+
+		vector<merged_vertex>().swap(_merged_vertices);
+		vector<unsigned int>().swap(_merged_elements);
+		vector<unsigned char>().swap(_merged_edge_masks);
+	}
+
+	instance_handle duplicate_instance_renderer::_add_mesh(const tess::triangle_mesh& mesh, const mat4& transform, bool remove_duplicate_vertices /*= false*/)
 	{
 		// 1. apply transform to mesh
 		auto new_mesh = mesh;
@@ -641,8 +2709,7 @@ namespace app
 		{
 			// 4.1 estimate transformation from candidate mesh to new mesh
 			double error = 0.0;
-			auto m = estimate_transform_3x3(itr->second.src, itr->second.src_mean, itr->second.src_local, itr->second.Aqq,
-											dst, dst_mean, dst_local, error);
+			auto m = estimate_transform_3x3(itr->second.points, dst, dst_mean, dst_local, error);
 
 			// 4.2 save best match so far
 			if(error < best_error)
@@ -653,14 +2720,35 @@ namespace app
 			}
 		}
 
+		// 5. after end_upload the instance goes straight into the set of its mesh
+		const instance_handle handle = _slots.get_handle_count();
+		if(_uploaded)
+		{
+			auto set = best_match != range.second ? best_match->second.set : 0u;
+			if(best_match == range.second)
+			{
+				point_set ps;
+				ps.points = new_points;
+				ps.set = set = _append_instance_set(new_mesh);
+				_unique_meshes.emplace(new_points.size(), ps);
+			}
+
+			++_total_geometries;
+			_total_triangles += new_mesh.elements.size()/3;
+			_slots.add(mat34(transform));
+			_insert_instance(set, handle, mat34(best_matrix), _current_color_id);
+			return handle;
+		}
+
 		if(best_match != range.second)
 		{
 			best_match->second.transforms.push_back(mat34(best_matrix));
 			best_match->second.color_ids.push_back(_current_color_id);
+			best_match->second.handles.push_back(handle);
 		}
 		else
 		{
-			// 5. if no candidate matched, add new mesh as a new candidate
+			// 6. if no candidate matched, add new mesh as a new candidate
 			_total_vbo_size_bytes += new_mesh.vertices.size() * sizeof(tess::vertex);
 			_total_ebo_size_bytes += new_mesh.elements.size() * sizeof(tess::element);
 
@@ -668,11 +2756,9 @@ namespace app
 			ps.mesh = new_mesh;
 			ps.transforms.push_back(mat34(mat4::IDENTITY));
 			ps.color_ids.push_back(_current_color_id);
+			ps.handles.push_back(handle);
 
-			ps.src = dst;
-			ps.src_mean = dst.rowwise().mean();
-			ps.src_local = dst.colwise() - ps.src_mean;
-			ps.Aqq = (ps.src_local * ps.src_local.transpose()).inverse();
+			ps.points = new_points;
 
 			_unique_meshes.emplace(new_points.size(), ps);
 
@@ -683,5 +2769,392 @@ namespace app
 
 		++_total_geometries;
 		_total_triangles += new_mesh.elements.size()/3;
+
+		_slots.add(mat34(transform));
+		return handle;
+	}
+
+	unsigned int duplicate_instance_renderer::_append_instance_set(tess::triangle_mesh& mesh)
+	{
+		// 1. same optimizations as end_upload, connectivity is not looked up among the uploaded meshes
+		optimize_vertex_cache(mesh.elements, mesh.vertices.size());
+		optimize_overdraw(mesh.elements, mesh.vertices);
+		optimize_vertex_fetch(mesh.elements, mesh.vertices);
+
+		instance_set instances;
+		instances.element_count = mesh.elements.size();
+
+		// 2. bounding sphere in mesh space
+		bbox bounds;
+		for(const auto& v : mesh.vertices)
+		{
+			bounds.expand(v.position);
+		}
+		instances.center = (bounds.min + bounds.max) * 0.5f;
+		for(const auto& v : mesh.vertices)
+		{
+			const auto d = v.position - instances.center;
+			instances.radius = math::max(instances.radius, std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z));
+		}
+
+		// 3. simplification chain after the full elements, offsets relative to the set until its range is allocated
+		vector<tess::element> elements = mesh.elements;
+		vector<lod> lods(1);
+		lods[0].element_count = instances.element_count;
+		if(instances.element_count / 3 >= static_cast<int>(MIN_LOD_TRIANGLES))
+		{
+			vector<tess::element> previous = mesh.elements;
+			for(unsigned int resolution = LOD_MAX_GRID_RESOLUTION; resolution >= 2 && lods.size() < MAX_LODS; resolution /= 2)
+			{
+				float error = 0.0f;
+				auto simplified = simplify_clustered(previous, mesh.vertices, resolution, error);
+				if(simplified.empty())
+				{
+					break;
+				}
+				if(simplified.size() > previous.size() * LOD_MIN_REDUCTION)
+				{
+					continue;
+				}
+				optimize_vertex_cache(simplified, mesh.vertices.size());
+
+				lod l;
+				l.element_count = simplified.size();
+				l.element_byte_offset = elements.size() * sizeof(tess::element);
+				l.error = error;
+				lods.push_back(l);
+				elements.insert(elements.end(), simplified.begin(), simplified.end());
+
+				previous.swap(simplified);
+			}
+		}
+
+		// 4. vertices followed by the center point of the set, and every level, appended to the shared buffers
+		auto vertices = mesh.vertices;
+		tess::vertex point;
+		point.position = instances.center;
+		point.normal = vec3(0.0f, 0.0f, 1.0f);
+		vertices.push_back(point);
+		const auto vertex_offset = _vertex_allocator.allocate(vertices.data(), vertices.size() * sizeof(tess::vertex), sizeof(tess::vertex));
+		const auto element_offset = _element_allocator.allocate(elements.data(), elements.size() * sizeof(tess::element), 3 * sizeof(tess::element));
+		instances.base_vertex = vertex_offset / sizeof(tess::vertex);
+		instances.point_vertex = instances.base_vertex + mesh.vertices.size();
+		instances.element_byte_offset = element_offset;
+
+		// 5. feature edges of every level, the masks grow with the element buffer
+		const auto first_triangle = element_offset / (3 * sizeof(tess::element));
+		_edge_masks.resize(first_triangle + elements.size() / 3, UNKNOWN_EDGES);
+		for(const auto& l : lods)
+		{
+			const auto first = l.element_byte_offset / sizeof(tess::element);
+			const vector<tess::element> range(elements.begin() + first, elements.begin() + first + l.element_count);
+			const auto masks = compute_feature_edges(range, mesh.vertices, FEATURE_CREASE_ANGLE);
+			std::copy(masks.begin(), masks.end(), _edge_masks.begin() + first_triangle + first / 3);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, _edges_buffer_id);
+		if(_edge_masks.size() > _edges_capacity)
+		{
+			_edges_capacity = math::max(static_cast<unsigned int>(_edge_masks.size()), _element_allocator.get_capacity() / static_cast<unsigned int>(3 * sizeof(tess::element)));
+			glBufferData(GL_TEXTURE_BUFFER, _edges_capacity * sizeof(unsigned char), nullptr, GL_STATIC_DRAW);
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, _edge_masks.size() * sizeof(unsigned char), _edge_masks.data());
+		}
+		else
+		{
+			glBufferSubData(GL_TEXTURE_BUFFER, first_triangle, elements.size() / 3, _edge_masks.data() + first_triangle);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		// 6. meshlets of the full level
+		if(instances.element_count / 3 >= static_cast<int>(MIN_MESHLET_TRIANGLES))
+		{
+			const auto meshlets = build_meshlets(mesh.elements, mesh.vertices);
+			instances.first_meshlet = _meshlets.size();
+			instances.meshlet_count = meshlets.size();
+			_meshlets.insert(_meshlets.end(), meshlets.begin(), meshlets.end());
+		}
+
+		// 7. the first instance sits on the mesh as given, large meshes are candidate occluders
+		_set_occluder_mesh.push_back(-1);
+		if(instances.radius >= OCCLUDER_MIN_RADIUS)
+		{
+			unsigned int level = 0;
+			while(level + 1 < lods.size() && static_cast<unsigned int>(lods[level].element_count / 3) > OCCLUDER_MAX_TRIANGLES)
+			{
+				++level;
+			}
+
+			occluder_mesh occluder;
+			const auto first = elements.begin() + lods[level].element_byte_offset / sizeof(tess::element);
+			occluder.elements.assign(first, first + lods[level].element_count);
+			occluder.positions.reserve(mesh.vertices.size());
+			for(const auto& v : mesh.vertices)
+			{
+				occluder.positions.push_back(v.position);
+			}
+			_set_occluder_mesh.back() = _occluder_meshes.size();
+			_occluder_meshes.push_back(std::move(occluder));
+		}
+
+		instances.first_lod = _lods.size();
+		instances.lod_count = lods.size();
+		for(auto& l : lods)
+		{
+			l.element_byte_offset += element_offset;
+			_lods.push_back(l);
+		}
+
+		// 8. no slots until the next layout
+		instances.tex_offset = _cpu_transform_buffer.size();
+		instances.first_range = _instance_ranges.size();
+		_instance_sets.push_back(instances);
+		_set_commands_dirty = true;
+		_total_memory += vertices.size() * sizeof(tess::vertex) + elements.size() * sizeof(tess::element);
+		return _instance_sets.size() - 1;
+	}
+
+	void duplicate_instance_renderer::_insert_instance(unsigned int set, instance_handle handle, const mat34& transform, unsigned char color_id)
+	{
+		auto& instances = _instance_sets[set];
+		_set_commands_dirty = true;
+		if(instances.count < instances.capacity)
+		{
+			// spare slot of the set, only its pages go up
+			_write_slot(instances.tex_offset + instances.count++, handle, transform, color_id);
+			return;
+		}
+
+		// full sets grow when the next frame lays out the sets again
+		instance_slots::pending_instance p;
+		p.transform = transform;
+		p.handle = handle;
+		p.set = set;
+		p.color_id = color_id;
+		_slots.add_pending(p);
+		_layout_dirty = true;
+	}
+
+	void duplicate_instance_renderer::_write_slot(unsigned int slot, instance_handle handle, const mat34& transform, unsigned char color_id)
+	{
+		_slots.place(handle, slot, transform);
+		_cpu_transform_buffer[slot] = transform;
+		_dirty_transforms.mark(slot * sizeof(mat34), sizeof(mat34));
+		_moved_instances.push_back(slot);
+		_upload_color_ids[slot] = color_id;
+		_write_color_id(slot, color_id);
+		_write_flags(slot, 0);
+	}
+
+	void duplicate_instance_renderer::_move_slot(unsigned int from, unsigned int to)
+	{
+		_slots.move(from, to);
+		_cpu_transform_buffer[to] = _cpu_transform_buffer[from];
+		_dirty_transforms.mark(to * sizeof(mat34), sizeof(mat34));
+		_moved_instances.push_back(to);
+		_upload_color_ids[to] = _upload_color_ids[from];
+		_write_color_id(to, _cpu_color_id_buffer[from]);
+
+		// flags move without changing the hidden count, the emptied slot is left clear
+		_cpu_flag_buffer[to] = _cpu_flag_buffer[from];
+		_cpu_flag_buffer[from] = 0;
+		_dirty_flags.mark(to * sizeof(unsigned char), sizeof(unsigned char));
+
+		if(from < _slot_tracks.size() && _slot_tracks[from] >= 0)
+		{
+			_tracks[_slot_tracks[from]].slot = to;
+			_slot_tracks[to] = _slot_tracks[from];
+			_slot_tracks[from] = -1;
+			_tracks_dirty = true;
+		}
+	}
+
+	bool duplicate_instance_renderer::_is_live_slot(unsigned int slot) const
+	{
+		const auto& instances = _instance_sets[_instance_set_index[slot]];
+		return static_cast<int>(slot) - instances.tex_offset < instances.count;
+	}
+
+	void duplicate_instance_renderer::_repack_slots()
+	{
+		// 1. new block of every set: its instances, those waiting for a slot, and room to grow for a set that had to grow
+		vector<unsigned int> waiting(_instance_sets.size(), 0);
+		for(const auto& p : _slots.get_pending())
+		{
+			++waiting[p.set];
+		}
+
+		const unsigned int old_slots = _cpu_transform_buffer.size();
+		vector<unsigned int> remap(old_slots, NO_SLOT);
+		unsigned int slots = 0;
+		for(unsigned int s = 0; s < _instance_sets.size(); ++s)
+		{
+			auto& instances = _instance_sets[s];
+			for(int i = 0; i < instances.count; ++i)
+			{
+				remap[instances.tex_offset + i] = slots + i;
+			}
+			const int count = instances.count + waiting[s];
+			instances.tex_offset = slots;
+			instances.capacity = waiting[s] > 0 ? count + count / 2 : count;
+			slots += instances.capacity;
+		}
+
+		// 2. instances keep their order within the set, the waiting ones follow
+		vector<mat34> transforms(slots);
+		vector<unsigned char> color_ids(slots, 0);
+		vector<unsigned char> upload_color_ids(slots, 0);
+		vector<unsigned char> flags(slots, 0);
+		vector<bounding_sphere> bounds(slots);
+		vector<unsigned int> set_index(slots, 0);
+		for(unsigned int slot = 0; slot < old_slots; ++slot)
+		{
+			const auto to = remap[slot];
+			if(to == NO_SLOT)
+			{
+				continue;
+			}
+			transforms[to] = _cpu_transform_buffer[slot];
+			color_ids[to] = _cpu_color_id_buffer[slot];
+			upload_color_ids[to] = _upload_color_ids[slot];
+			flags[to] = _cpu_flag_buffer[slot];
+			bounds[to] = _instance_bounds[slot];
+		}
+		_slots.remap(remap, slots);
+		for(const auto& p : _slots.get_pending())
+		{
+			auto& instances = _instance_sets[p.set];
+			const auto to = instances.tex_offset + instances.count++;
+			transforms[to] = p.transform;
+			color_ids[to] = upload_color_ids[to] = p.color_id;
+			bounds[to].center = p.transform.mul(instances.center);
+			bounds[to].radius = instances.radius * p.transform.max_scale();
+			_slots.place(p.handle, to, p.transform);
+		}
+		_slots.clear_pending();
+
+		// 3. empty slots repeat the first instance of their set, its ranges and the hierarchy stay as tight as the instances
+		for(unsigned int s = 0; s < _instance_sets.size(); ++s)
+		{
+			const auto& instances = _instance_sets[s];
+			const unsigned int first = instances.tex_offset;
+			std::fill(set_index.begin() + first, set_index.begin() + first + instances.capacity, s);
+			for(auto slot = first + instances.count; slot < first + instances.capacity; ++slot)
+			{
+				transforms[slot] = transforms[first];
+				bounds[slot] = bounds[first];
+			}
+		}
+
+		_cpu_transform_buffer.swap(transforms);
+		_cpu_color_id_buffer.swap(color_ids);
+		_upload_color_ids.swap(upload_color_ids);
+		_cpu_flag_buffer.swap(flags);
+		_instance_bounds.swap(bounds);
+		_instance_set_index.swap(set_index);
+		_moved_instances.clear();
+
+		// 4. tracks and occluders follow their instances
+		if(!_slot_tracks.empty())
+		{
+			_slot_tracks.assign(slots, -1);
+			for(unsigned int t = 0; t < _tracks.size(); ++t)
+			{
+				auto& track = _tracks[t];
+				if(track.slot != NO_SLOT)
+				{
+					track.slot = remap[track.slot];
+					_slot_tracks[track.slot] = t;
+				}
+			}
+			_tracks_dirty = true;
+		}
+
+		_occluder_instances.clear();
+		for(unsigned int s = 0; s < _instance_sets.size(); ++s)
+		{
+			const auto& instances = _instance_sets[s];
+			if(_set_occluder_mesh[s] < 0)
+			{
+				continue;
+			}
+			for(int i = 0; i < instances.count; ++i)
+			{
+				if(_instance_bounds[instances.tex_offset + i].radius >= OCCLUDER_MIN_RADIUS)
+				{
+					_occluder_instances.push_back(instances.tex_offset + i);
+				}
+			}
+		}
+
+		// 5. culling ranges over every slot of a set, added instances are not sorted into morton order
+		_instance_ranges.clear();
+		for(auto& instances : _instance_sets)
+		{
+			instances.first_range = _instance_ranges.size();
+			for(int first = 0; first < instances.capacity; first += INSTANCE_RANGE_SIZE)
+			{
+				instance_range range;
+				range.first = first;
+				range.count = math::min(static_cast<unsigned int>(instances.capacity - first), INSTANCE_RANGE_SIZE);
+				range.bounds = enclosing_sphere(_instance_bounds.data() + instances.tex_offset + first, range.count);
+				_instance_ranges.push_back(range);
+			}
+			instances.range_count = _instance_ranges.size() - instances.first_range;
+		}
+		_bvh.build(_instance_bounds);
+		_lists_valid = false;
+
+		// 6. the streams get stores of the new size under their names, the buffer textures keep viewing them
+		auto bytes = respecify_buffer(_transform_buffer_id, _cpu_transform_buffer.data(), slots * sizeof(mat34));
+		bytes += respecify_buffer(_color_id_buffer_id, _cpu_color_id_buffer.data(), slots * sizeof(unsigned char));
+		bytes += respecify_buffer(_flag_buffer_id, _cpu_flag_buffer.data(), slots * sizeof(unsigned char));
+		_dirty_transforms.resize(slots * sizeof(mat34));
+		_dirty_color_ids.resize(slots * sizeof(unsigned char));
+		_dirty_flags.resize(slots * sizeof(unsigned char));
+		_upload_stats.uploaded_bytes += bytes;
+		_upload_stats.full_bytes = _dirty_transforms.get_size_bytes() + _dirty_color_ids.get_size_bytes();
+
+		if(_transform_ring.is_created())
+		{
+			_transform_ring.destroy();
+			set_dynamic_transforms(_dynamic_transforms);
+		}
+
+		// 7. identity range over the new slots, the per-frame lists start past it
+		_list_offset = slots;
+		vector<unsigned int> identity(slots);
+		for(unsigned int i = 0; i < slots; ++i)
+		{
+			identity[i] = i;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, 2 * slots * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, identity.size() * sizeof(unsigned int), identity.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		_set_commands_dirty = true;
+		_layout_dirty = false;
+		++_repacks;
+	}
+
+	void duplicate_instance_renderer::_upload_set_commands()
+	{
+		vector<draw_command> set_commands;
+		set_commands.reserve(_instance_sets.size());
+		for(const auto& instances : _instance_sets)
+		{
+			draw_command command;
+			command.count = instances.element_count;
+			command.instance_count = instances.count;
+			command.first_index = instances.element_byte_offset / sizeof(tess::element);
+			command.base_vertex = instances.base_vertex;
+			command.base_instance = instances.tex_offset;
+			set_commands.push_back(command);
+		}
+		_set_command_count = set_commands.size();
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _set_commands_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, set_commands.size() * sizeof(draw_command), set_commands.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		_set_commands_dirty = false;
 	}
 } // namespace app
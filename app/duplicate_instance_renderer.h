@@ -1,6 +1,14 @@
 #pragma once
 #include <app/base_renderer.h>
 #include <app/transformation.h>
+#include <app/meshlet.h>
+#include <app/bvh.h>
+#include <app/occlusion_buffer.h>
+#include <app/transform_ring.h>
+#include <app/dirty_pages.h>
+#include <app/animation_track.h>
+#include <app/buffer_suballocator.h>
+#include <app/instance_slots.h>
 #include <glb/shader_program.h>
 #include <glb/vertex_array_builder.h>
 #include <glb/texture.h>
@@ -18,23 +26,111 @@ namespace app
 	typedef Eigen::Matrix<double, 3, Eigen::Dynamic> EigenVec3Array;
 	typedef Eigen::Matrix<double, 4, Eigen::Dynamic> EigenVec4Array;
 
+	static const int MAX_LODS = 4;
+
+	// color ids are bytes, the palette has an entry for each
+	static const unsigned int PALETTE_SIZE = 256;
+
+	// per-instance flag bits, hidden instances are left out of the draw lists and the others change how they are shaded
+	enum instance_flag
+	{
+		instance_hidden = 1 << 0,
+		instance_highlighted = 1 << 1,
+		instance_ghosted = 1 << 2
+	};
+
 	class duplicate_instance_renderer : public app::base_renderer
 	{
 	public:
 		virtual void set_current_color(unsigned char color_id) override;
-		virtual void add_box(const box& b, const mat4& transform) override;
-		virtual void add_circular_torus(const circular_torus& ct, const mat4& transform) override;
-		virtual void add_cone(const cone& c, const mat4& transform) override;
-		virtual void add_cone_offset(const cone_offset& c, const mat4& transform) override;
-		virtual void add_cylinder(const cylinder& c, const mat4& transform) override;
-		virtual void add_cylinder_offset(const cylinder_offset& c, const mat4& transform) override;
-		virtual void add_cylinder_slope(const cylinder_slope& c, const mat4& transform) override;
-		virtual void add_dish(const dish& d, const mat4& transform) override;
-		virtual void add_mesh(const tess::triangle_mesh& m, const mat4& transform) override;
-		virtual void add_pyramid(const pyramid& p, const mat4& transform) override;
-		virtual void add_rectangular_torus(const rectangular_torus& rt, const mat4& transform) override;
-		virtual void add_sphere(const sphere& s, const mat4& transform) override;
+		virtual instance_handle add_box(const box& b, const mat4& transform) override;
+		virtual instance_handle add_circular_torus(const circular_torus& ct, const mat4& transform) override;
+		virtual instance_handle add_cone(const cone& c, const mat4& transform) override;
+		virtual instance_handle add_cone_offset(const cone_offset& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder(const cylinder& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder_offset(const cylinder_offset& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder_slope(const cylinder_slope& c, const mat4& transform) override;
+		virtual instance_handle add_dish(const dish& d, const mat4& transform) override;
+		virtual instance_handle add_mesh(const tess::triangle_mesh& m, const mat4& transform) override;
+		virtual instance_handle add_pyramid(const pyramid& p, const mat4& transform) override;
+		virtual instance_handle add_rectangular_torus(const rectangular_torus& rt, const mat4& transform) override;
+		virtual instance_handle add_sphere(const sphere& s, const mat4& transform) override;
 		virtual void end_upload() override;
+		virtual void set_view(const frustum& f) override;
+
+		// the CPU half of end_upload: lays out the sets, builds meshlets, levels of detail and the culling hierarchy without
+		// touching OpenGL, end_upload calls it when it was not; the culling counters work after it alone, add_* must wait for end_upload
+		void prepare_upload();
+
+		// after end_upload add_* matches the mesh against the unique meshes kept from the upload: a match joins its instance set and
+		// a new mesh gets a set of its own, appended to the vertex and element buffers; an instance placed in a full set, or in a
+		// new one, gets its slot when the next frame lays out the sets again and cannot be addressed until then
+		// parametric shapes of the combined renderer are not added this way
+
+		// another instance of the mesh behind source, which must not be merged
+		instance_handle add_instance_of(instance_handle source, const mat4& transform);
+
+		// the last instance of the set takes the slot of the removed one, the sets are packed again once a quarter of the slots
+		// is left empty; the handle stays allocated and is ignored by every call
+		// returns false for an unknown or already removed handle and for a merged instance, whose geometry is baked into its batch
+		bool remove_instance(instance_handle handle);
+
+		// instances placed or waiting for a slot
+		unsigned int get_instance_count() const;
+		unsigned int get_unique_mesh_count() const;
+
+		// handles of merged instances cannot be addressed, culling bounds follow moved instances and the written pages
+		// are uploaded once by the first pass of the next frame
+		virtual void set_transform(instance_handle handle, const mat4& transform) override;
+		virtual void set_color(instance_handle handle, unsigned char color_id) override;
+
+		// color ids of many instances at once, each returns the number of instances whose color changed
+		// only the pages holding changed ids are uploaded, merged instances keep their color
+		unsigned int set_colors(const vector<instance_handle>& handles, const vector<unsigned char>& color_ids);
+
+		// overlay from an attribute by handle: a value indexes the palette ids, values past them show the upload color and
+		// handles past the values keep theirs, walks the slots in order so a million instances take a few milliseconds
+		unsigned int map_colors(const vector<unsigned char>& values, const vector<unsigned char>& palette);
+
+		// back to the color ids given at upload
+		unsigned int reset_colors();
+
+		// the CAD materials take the first palette entries, overlays set their colors past them
+		void set_palette_color(unsigned char color_id, const vec3& rgb);
+		unsigned int get_material_count() const;
+
+		// same as set_transform, without the conversion from mat4
+		// an instance added with a singular transform has no local transform to carry a new one, it keeps its upload transform:
+		// set_transform, animation tracks and add_instance_of ignore it
+		void set_transform(instance_handle handle, const mat34& transform);
+		bool is_pinned(instance_handle handle) const;
+
+		// transform given to add_* or to the last set_transform, identity for handles past get_handle_count
+		const mat34& get_transform(instance_handle handle) const;
+		unsigned int get_handle_count() const;
+
+		// flag bits of many instances at once, the set bits are applied after the cleared ones and only changed pages are
+		// uploaded, merged instances cannot be flagged
+		void set_flags(const vector<instance_handle>& handles, unsigned char set, unsigned char clear);
+		void set_flags(instance_handle handle, unsigned char flags);
+		unsigned char get_flags(instance_handle handle) const;
+
+		// clears the given bits on every instance
+		void clear_flags(unsigned char flags);
+		unsigned int get_hidden_count() const;
+
+		// keyframed motion of an instance about the center of its rest bounds, uploaded once and evaluated by the vertex stage
+		// on top of the transform set_transform writes, merged instances cannot be animated and an empty track removes it
+		void set_animation_track(instance_handle handle, const vector<keyframe>& keys);
+		void clear_animation_tracks();
+
+		// seconds into the tracks, negative draws every animated instance at rest
+		void set_animation_time(float time);
+		float get_animation_time() const;
+
+		// reference path: tracks are evaluated on the CPU into the transform stream, to check the vertex stage against
+		void set_cpu_animation(bool enabled);
+		bool get_cpu_animation() const;
 
 		virtual bool initialize(glb::framebuffer& fbuffer, glb::camera& cam) override;
 		virtual bool finalize() override;
@@ -42,44 +138,166 @@ namespace app
 
 		void render_color(const vec3& color);
 
-	private:
-		void _add_mesh(const tess::triangle_mesh& mesh, const mat4& transform, bool remove_duplicate_vertices = false);
+		// same draws as render with depth-only programs, for a pre-pass
+		void render_depth();
 
-	private:
-		struct mat34
+		// same draws as render writing instance and primitive ids
+		void render_visibility();
+
+		// same draws as render with triangle edges blended over the shading in a single pass
+		void render_wireframe();
+
+		// color ids and palette on their texture units, for passes that resolve instance ids to colors
+		void bind_color_textures();
+
+		struct cull_stats
+		{
+			unsigned int culled_instances = 0;
+			unsigned int hidden_instances = 0;
+			unsigned int occluded_instances = 0;
+			unsigned int small_instances = 0;
+			unsigned int saved_triangles = 0;
+			unsigned int culled_triangles = 0;
+			unsigned int drawn_triangles = 0;
+			unsigned int draw_calls = 0;
+		};
+
+		void set_meshlet_culling(bool enabled);
+		bool get_meshlet_culling() const;
+		void set_lod_selection(bool enabled);
+		bool get_lod_selection() const;
+		void set_multi_draw(bool enabled);
+		bool get_multi_draw() const;
+		void set_instance_culling(bool enabled);
+		bool get_instance_culling() const;
+
+		// culls and draws whole ranges of spatially close instances, without per-instance lists
+		void set_range_culling(bool enabled);
+		bool get_range_culling() const;
+
+		// unique meshes with fewer instances are pre-transformed into static batches by end_upload, 0 keeps every mesh instanced
+		void set_merge_threshold(unsigned int instances);
+		unsigned int get_merge_threshold() const;
+
+		// sets, and merged batches, are drawn nearest first
+		void set_front_to_back(bool enabled);
+		bool get_front_to_back() const;
+
+		// transforms are streamed through a ring of persistently mapped frames instead of the static buffer
+		// the frames are never read back, so the CPU stages testing instance bounds stand down while it is on: instance, range,
+		// meshlet and occlusion culling, level of detail, small features and occluders; merged batches do not move and stay culled
+		void set_dynamic_transforms(bool enabled);
+		bool get_dynamic_transforms() const;
+
+		// transforms of the next frame in upload order, written straight into mapped memory: every transform must be written
+		// nullptr unless dynamic transforms are enabled
+		mat34* map_transforms();
+
+		// set_transform that also writes the frame last returned by map_transforms, for updates that must show this frame
+		void set_transform(mat34* frame, instance_handle handle, const mat34& transform);
+
+		// upload-time transforms in the order of map_transforms
+		const vector<mat34>& get_transforms() const;
+
+		// frames map_transforms had to wait for the GPU to release
+		unsigned int get_transform_stalls() const;
+
+		// bytes sent by the sub-range uploads of the last frame against re-sending both whole streams
+		struct upload_stats
+		{
+			unsigned int uploaded_bytes = 0;
+			unsigned int ranges = 0;
+			unsigned int full_bytes = 0;
+
+			// culling hierarchy nodes refitted around moved instances
+			unsigned int refit_nodes = 0;
+		};
+
+		const upload_stats& get_upload_stats() const;
+
+		// slots of the sets and how many of them are empty, layouts of the sets since end_upload and bytes of the geometry buffers
+		struct layout_stats
 		{
-			mat34(){}
-
-			explicit mat34(const mat4& m)
-			{
-				int i = 0;
-				data[i++] = m.at(0,0);
-				data[i++] = m.at(0,1);
-				data[i++] = m.at(0,2);
-				data[i++] = m.at(0,3);
-
-				data[i++] = m.at(1,0);
-				data[i++] = m.at(1,1);
-				data[i++] = m.at(1,2);
-				data[i++] = m.at(1,3);
-
-				data[i++] = m.at(2,0);
-				data[i++] = m.at(2,1);
-				data[i++] = m.at(2,2);
-				data[i++] = m.at(2,3);
-			}
-
-			mat4 as_mat4() const
-			{
-				return mat4(data[0], data[1], data[2], data[3],
-							data[4], data[5], data[6], data[7],
-							data[8], data[9], data[10], data[11],
-							0,0,0,1);
-			}
-
-			float data[12];
+			unsigned int slots = 0;
+			unsigned int spare_slots = 0;
+			unsigned int pending_instances = 0;
+			unsigned int repacks = 0;
+			unsigned int vertex_bytes = 0;
+			unsigned int element_bytes = 0;
+			unsigned int buffer_grows = 0;
 		};
 
+		layout_stats get_layout_stats() const;
+
+		// the wireframe pass only draws open edges and creases, multi-draw is bypassed to address the masks of each draw
+		void set_feature_edges(bool enabled);
+		bool get_feature_edges() const;
+
+		void set_small_feature_mode(small_feature_mode mode);
+		small_feature_mode get_small_feature_mode() const;
+
+		// projected radius in pixels below which an instance is a small feature
+		void set_small_feature_pixels(float pixels);
+		float get_small_feature_pixels() const;
+
+		// visible instances are also tested against the buffer, nullptr disables occlusion culling
+		void set_occlusion_buffer(const occlusion_buffer* buffer);
+
+		// rasterizes the largest candidate occluders in view, call after set_view
+		void add_occluders(occlusion_buffer& buffer) const;
+		const cull_stats& get_cull_stats() const;
+
+		// CPU-only meshlet culling pass for the given camera, does not touch OpenGL and works after prepare_upload
+		unsigned int count_culled_triangles(const frustum& f) const;
+
+		// CPU-only instance culling pass for the given camera, does not touch OpenGL and works after prepare_upload
+		unsigned int count_visible_instances(const frustum& f) const;
+
+	private:
+		struct instance_set;
+		struct instance_draw;
+
+		instance_handle _add_mesh(const tess::triangle_mesh& mesh, const mat4& transform, bool remove_duplicate_vertices = false);
+		unsigned int _append_instance_set(tess::triangle_mesh& mesh);
+		void _insert_instance(unsigned int set, instance_handle handle, const mat34& transform, unsigned char color_id);
+		void _write_slot(unsigned int slot, instance_handle handle, const mat34& transform, unsigned char color_id);
+		void _move_slot(unsigned int from, unsigned int to);
+		bool _is_live_slot(unsigned int slot) const;
+		void _repack_slots();
+		void _upload_set_commands();
+		void _merge_low_count_meshes();
+		void _upload_merged_batches();
+		void _render_pass(render_pass pass, glb::shader_program& program);
+		void _draw_batches();
+		void _order_sets();
+		void _draw_instance_sets();
+		void _draw_instance_lists();
+		void _build_instance_lists();
+		void _draw_instance_ranges(const instance_set& instances);
+		void _append_meshlet_draws(const instance_set& instances, int instance, vector<instance_draw>& draws);
+		void _draw_elements(int element_count, int element_byte_offset, int instance_count, int base_vertex, int base_instance);
+		void _draw_points(int first_vertex, int instance_count, int base_instance);
+		int _select_lod(const instance_set& instances, int instance) const;
+		bool _is_culling_instances() const;
+		void _bind_transforms();
+		void _upload_dirty_ranges();
+		void _refit_moved_instances();
+		unsigned int _write_color_id(unsigned int slot, unsigned char color_id);
+		void _write_flags(unsigned int slot, unsigned char flags);
+		void _upload_animation_tracks();
+		void _write_animated_transform(unsigned int track);
+		bool _is_animating_on_gpu() const;
+		// bounds follow the transform stream, which dynamic frames written straight to mapped memory leave behind
+		bool _is_testing_bounds() const { return !_dynamic_transforms; }
+		bool _is_selecting_lods() const { return _lod_selection && _is_testing_bounds(); }
+		bool _is_culling_ranges() const { return _range_culling && _is_testing_bounds(); }
+		bool _is_filtering_small_features() const { return _small_feature_mode != small_feature_draw && _is_testing_bounds(); }
+		// meshlet cones and bounds are tested against the transform stream, which the vertex stage no longer follows
+		bool _is_culling_meshlets() const { return _meshlet_culling && !_is_animating_on_gpu() && _is_testing_bounds(); }
+		bool _is_drawing_feature_edges() const { return _pass == render_pass_wireframe && _feature_edges; }
+		void _submit_draw_commands();
+
+	private:
 		struct color
 		{
 			unsigned char rgba[4];
@@ -89,25 +307,120 @@ namespace app
 		{
 			int element_count = 0;
 			int element_byte_offset = 0;
+			int base_vertex = 0;
 			int tex_offset = 0;
 			int count = 0;
+			int capacity = 0;
+			int first_meshlet = 0;
+			int meshlet_count = 0;
+			int first_lod = 0;
+			int lod_count = 0;
+			int point_vertex = 0;
+			int first_range = 0;
+			int range_count = 0;
+			vec3 center;
+			float radius = 0.0f;
 			vec3 color;
 		};
 
+		struct lod
+		{
+			int element_count = 0;
+			int element_byte_offset = 0;
+			float error = 0.0f;
+		};
+
+		struct instance_draw
+		{
+			int element_count = 0;
+			int element_byte_offset = 0;
+			int base_vertex = 0;
+			int first_instance = 0;
+			int count = 0;
+		};
+
+		// pre-transformed vertex of a merged batch, the color id replaces the instance index
+		struct merged_vertex
+		{
+			vec3 position;
+			vec3 normal;
+			unsigned int color_id = 0;
+		};
+
+		// spatially close instances of low-count meshes merged into one element range
+		struct merged_batch
+		{
+			bounding_sphere bounds;
+			int element_count = 0;
+			int element_byte_offset = 0;
+		};
+
+		// instances [first, first + count) of a set, in morton order
+		struct instance_range
+		{
+			bounding_sphere bounds;
+			unsigned int first = 0;
+			unsigned int count = 0;
+		};
+
+		// layout of DrawElementsIndirectCommand
+		struct draw_command
+		{
+			unsigned int count = 0;
+			unsigned int instance_count = 0;
+			unsigned int first_index = 0;
+			int base_vertex = 0;
+			unsigned int base_instance = 0;
+		};
+
+		// layout of DrawArraysIndirectCommand
+		struct point_command
+		{
+			unsigned int count = 0;
+			unsigned int instance_count = 0;
+			unsigned int first = 0;
+			unsigned int base_instance = 0;
+		};
+
+		// keys of one animated slot, its transform without the track, and the furthest the track takes its bounds
+		struct animation_track
+		{
+			vector<keyframe> keys;
+			unsigned int slot = 0;
+			mat34 rest;
+			vec3 pivot;
+			float reach = 0.0f;
+		};
+
+		// simplified positions of a large unique mesh used for software occlusion
+		struct occluder_mesh
+		{
+			vector<vec3> positions;
+			vector<unsigned int> elements;
+		};
+
 		struct point_set
 		{
 			tess::triangle_mesh mesh;
 			vector<mat34> transforms;
 			vector<unsigned char> color_ids;
-			EigenVec3Array src;
-			EigenVec3 src_mean;
-			EigenVec3Array src_local;
-			EigenMat3 Aqq;
+			vector<instance_handle> handles;
+
+			// reference points in single precision, the centered copy and Aqq are rebuilt for each match
+			vector<vec3> points;
+			unsigned int set = 0;
 		};
 
 		unsigned char _current_color_id = 0;
-		glb::vertex_array_builder _vao_builder;
+
+		// after end_upload only the reference points and the set of each unique mesh are kept, for matching late meshes
 		hash_multimap<unsigned int, point_set> _unique_meshes;
+		bool _prepared = false;
+		bool _uploaded = false;
+
+		// geometry laid out by prepare_upload for end_upload to send
+		vector<tess::vertex> _upload_vertices;
+		vector<tess::element> _upload_elements;
 
 		unsigned int _total_vbo_size_bytes = 0;
 		unsigned int _total_ebo_size_bytes = 0;
@@ -117,17 +430,161 @@ namespace app
 		unsigned int _total_memory = 0;
 
 		glb::shader_program _shader;
+		glb::shader_program _depth_shader;
+		glb::shader_program _visibility_shader;
+		glb::shader_program _wireframe_shader;
+		render_pass _pass = render_pass_color;
 		glb::texture _transform_texture;
 		glb::texture _color_ids_texture;
 		glb::texture _colors_texture;
-		glb::vertex_array _main_vao;
+		unsigned int _main_vao = 0;
+		unsigned int _vertex_buffer = 0;
+		unsigned int _element_buffer = 0;
+		unsigned int _instance_buffer = 0;
 		vector<instance_set> _instance_sets;
 
+		// meshlet culling
+		vector<meshlet> _meshlets;
+		vector<draw_range> _draw_ranges;
+		frustum _frustum;
+		bool _meshlet_culling = false;
+		cull_stats _stats;
+
+		// instance frustum culling, visible instances are regrouped by set
+		bvh _bvh;
+		bool _instance_culling = false;
+		vector<unsigned int> _instance_set_index;
+		vector<unsigned int> _visible;
+		vector<unsigned int> _visible_by_set;
+		vector<unsigned int> _set_offsets;
+		vector<bounding_sphere> _instance_bounds;
+
+		// instance range culling
+		vector<instance_range> _instance_ranges;
+		bool _range_culling = false;
+
+		// occlusion culling
+		const occlusion_buffer* _occlusion = nullptr;
+		vector<occluder_mesh> _occluder_meshes;
+		vector<int> _set_occluder_mesh;
+		vector<unsigned int> _occluder_instances;
+
+		// per-instance level of detail
+		vector<lod> _lods;
+		bool _lod_selection = false;
+		vector<unsigned int> _lod_buckets[MAX_LODS];
+		vector<unsigned int> _cpu_instance_list;
+		vector<instance_draw> _instance_draws;
+		vector<instance_draw> _meshlet_draws;
+
+		// lists are built by the first pass after set_view or a change to the instances, the other passes of the frame replay them
+		bool _lists_valid = false;
+		cull_stats _list_stats;
+
+		// static batches of merged low-count meshes
+		unsigned int _merge_threshold = 0;
+		glb::shader_program _merged_shader;
+		glb::shader_program _merged_depth_shader;
+		glb::shader_program _merged_visibility_shader;
+		glb::shader_program _merged_wireframe_shader;
+		glb::texture _merged_edges_texture;
+		unsigned int _merged_vao = 0;
+		unsigned int _merged_vertex_buffer = 0;
+		unsigned int _merged_element_buffer = 0;
+		vector<merged_batch> _batches;
+		vector<merged_vertex> _merged_vertices;
+		vector<unsigned int> _merged_elements;
+		vector<unsigned char> _merged_edge_masks;
+		vector<std::pair<float, unsigned int>> _visible_batches;
+		vector<int> _batch_counts;
+		vector<const void*> _batch_offsets;
+
+		// front to back order of the sets by their nearest instance range
+		bool _front_to_back = false;
+		vector<std::pair<float, unsigned int>> _set_order;
+
+		// dynamic transforms
+		transform_ring _transform_ring;
+		bool _dynamic_transforms = false;
+
+		// feature edge masks of every triangle in the element buffer, addressed by the first triangle of each draw
+		glb::texture _edges_texture;
+		vector<unsigned char> _edge_masks;
+		glb::buffer _edges_buffer;
+		unsigned int _edges_buffer_id = 0;
+		unsigned int _edges_capacity = 0;
+		bool _feature_edges = false;
+		int _triangle_base_location = -1;
+		int _merged_triangle_base_location = -1;
+
+		// small features, drawn as the center point of their set when not culled
+		small_feature_mode _small_feature_mode = small_feature_draw;
+		float _small_feature_pixels = 0.5f;
+		vector<unsigned int> _point_bucket;
+		vector<instance_draw> _point_draws;
+
+		// multi draw indirect: static commands for every set, and commands gathered each frame by culling and lod selection
+		bool _multi_draw = false;
+		unsigned int _set_commands_buffer = 0;
+		unsigned int _set_command_count = 0;
+		bool _set_commands_dirty = false;
+		unsigned int _frame_commands_buffer = 0;
+		vector<draw_command> _draw_commands;
+		vector<point_command> _point_commands;
+
 		// dynamic data
 		vector<mat34> _cpu_transform_buffer;
-		vector<mat34> _cpu_transform_buffer2;
 		glb::buffer _transform_buffer;
 		vector<unsigned char> _cpu_color_id_buffer;
 		glb::buffer _color_id_buffer;
+
+		// pages of the two streams written since their last upload, and the buffers behind their textures
+		dirty_pages _dirty_transforms;
+		dirty_pages _dirty_color_ids;
+		unsigned int _transform_buffer_id = 0;
+		unsigned int _color_id_buffer_id = 0;
+		vector<unsigned int> _moved_instances;
+		vector<byte_range> _dirty_ranges;
+		upload_stats _upload_stats;
+
+		// color ids given at upload, and the palette behind them
+		vector<unsigned char> _upload_color_ids;
+		vector<color> _palette;
+		glb::buffer _colors_buffer;
+		unsigned int _colors_buffer_id = 0;
+		unsigned int _material_count = 0;
+		bool _palette_dirty = false;
+
+		// flag bits of every slot, and the number of hidden ones
+		vector<unsigned char> _cpu_flag_buffer;
+		glb::buffer _flag_buffer;
+		glb::texture _flags_texture;
+		dirty_pages _dirty_flags;
+		unsigned int _flag_buffer_id = 0;
+		unsigned int _hidden_instances = 0;
+
+		// slot of every handle and handle of every slot, with the instances waiting for one
+		instance_slots _slots;
+
+		// incremental changes after end_upload: each set owns slots [tex_offset, tex_offset + capacity) with its instances
+		// first, the per-frame instance lists start past every slot and new geometry is appended to the shared buffers
+		buffer_suballocator _vertex_allocator;
+		buffer_suballocator _element_allocator;
+		unsigned int _list_offset = 0;
+		unsigned int _repacks = 0;
+		bool _layout_dirty = false;
+
+		// keyframe animation: track of every slot or -1, and the tracks as packed for the vertex stage
+		vector<animation_track> _tracks;
+		vector<int> _slot_tracks;
+		vector<unsigned int> _free_tracks;
+		unsigned int _animated_slots = 0;
+		float _animation_time = -1.0f;
+		bool _cpu_animation = false;
+		bool _tracks_dirty = false;
+		vector<float> _track_texels;
+		unsigned int _tracks_buffer = 0;
+		unsigned int _tracks_texture = 0;
+		int _animation_time_locations[4] = {-1, -1, -1, -1};
 	};
 } // namespace app
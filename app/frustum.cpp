@@ -0,0 +1,95 @@
+#include <app/frustum.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static plane make_plane(const mat4& m, int row, float sign)
+	{
+		plane p;
+		p.normal = vec3(m.at(3,0) + sign * m.at(row,0), m.at(3,1) + sign * m.at(row,1), m.at(3,2) + sign * m.at(row,2));
+		p.distance = m.at(3,3) + sign * m.at(row,3);
+
+		const auto length = std::sqrt(p.normal.x*p.normal.x + p.normal.y*p.normal.y + p.normal.z*p.normal.z);
+		p.normal = p.normal * (1.0f / length);
+		p.distance /= length;
+		return p;
+	}
+
+	static float signed_distance(const plane& p, const vec3& v)
+	{
+		return p.normal.x*v.x + p.normal.y*v.y + p.normal.z*v.z + p.distance;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void frustum::set(const mat4& view, const mat4& projection, int viewport_height)
+	{
+		// 1. extract clip planes from the combined matrix (Gribb and Hartmann), normals point inside
+		_view_projection = projection.mul(view);
+		_projection = projection;
+		const auto& view_projection = _view_projection;
+		_planes[0] = make_plane(view_projection, 0,  1.0f); // left
+		_planes[1] = make_plane(view_projection, 0, -1.0f); // right
+		_planes[2] = make_plane(view_projection, 1,  1.0f); // bottom
+		_planes[3] = make_plane(view_projection, 1, -1.0f); // top
+		_planes[4] = make_plane(view_projection, 2,  1.0f); // near
+		_planes[5] = make_plane(view_projection, 2, -1.0f); // far
+
+		// 2. camera position is -R^T * t for a rigid view matrix
+		const vec3 t(view.at(0,3), view.at(1,3), view.at(2,3));
+		_eye = vec3(-(view.at(0,0)*t.x + view.at(1,0)*t.y + view.at(2,0)*t.z),
+					-(view.at(0,1)*t.x + view.at(1,1)*t.y + view.at(2,1)*t.z),
+					-(view.at(0,2)*t.x + view.at(1,2)*t.y + view.at(2,2)*t.z));
+
+		// 3. pixels per unit of size at unit distance
+		_pixel_scale = projection.at(1,1) * viewport_height * 0.5f;
+	}
+
+	bool frustum::is_sphere_outside(const vec3& center, float radius) const
+	{
+		for(const auto& p : _planes)
+		{
+			if(signed_distance(p, center) < -radius)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	containment frustum::classify_box(const vec3& min, const vec3& max) const
+	{
+		auto result = containment_inside;
+		for(const auto& p : _planes)
+		{
+			// corners furthest along and against the plane normal
+			const vec3 positive(p.normal.x >= 0.0f ? max.x : min.x, p.normal.y >= 0.0f ? max.y : min.y, p.normal.z >= 0.0f ? max.z : min.z);
+			const vec3 negative(p.normal.x >= 0.0f ? min.x : max.x, p.normal.y >= 0.0f ? min.y : max.y, p.normal.z >= 0.0f ? min.z : max.z);
+			if(signed_distance(p, positive) < 0.0f)
+			{
+				return containment_outside;
+			}
+			if(signed_distance(p, negative) < 0.0f)
+			{
+				result = containment_intersecting;
+			}
+		}
+		return result;
+	}
+
+	float frustum::projected_radius(const vec3& center, float radius) const
+	{
+		const auto d = center - _eye;
+		const auto distance = std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z);
+		if(distance <= radius)
+		{
+			return math::limit_posf();
+		}
+		return radius * _pixel_scale / distance;
+	}
+} // namespace app
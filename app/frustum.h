@@ -0,0 +1,56 @@
+#pragma once
+#include <bl/bl.h>
+
+namespace app
+{
+	struct plane
+	{
+		vec3 normal;
+		float distance = 0.0f;
+	};
+
+	struct bounding_sphere
+	{
+		vec3 center;
+		float radius = 0.0f;
+	};
+
+	enum containment
+	{
+		containment_outside,
+		containment_intersecting,
+		containment_inside
+	};
+
+	// view volume of the current camera, extracted on the CPU for culling
+	class frustum
+	{
+	public:
+		void set(const mat4& view, const mat4& projection, int viewport_height);
+
+		bool is_sphere_outside(const vec3& center, float radius) const;
+
+		containment classify_box(const vec3& min, const vec3& max) const;
+
+		// clip planes with normals pointing inside: left, right, bottom, top, near, far
+		const plane& get_plane(int i) const { return _planes[i]; }
+
+		// radius in pixels of a sphere projected onto the viewport
+		float projected_radius(const vec3& center, float radius) const;
+
+		const vec3& get_eye() const { return _eye; }
+
+		const mat4& get_view_projection() const { return _view_projection; }
+		const mat4& get_projection() const { return _projection; }
+
+		// pixels covered by one unit of size at unit distance from the eye
+		float get_pixel_scale() const { return _pixel_scale; }
+
+	private:
+		plane _planes[6];
+		mat4 _view_projection = mat4::IDENTITY;
+		mat4 _projection = mat4::IDENTITY;
+		vec3 _eye;
+		float _pixel_scale = 1.0f;
+	};
+} // namespace app
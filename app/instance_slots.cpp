@@ -0,0 +1,156 @@
+#include <app/instance_slots.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// transform of handles that were never added
+	static const mat34 NO_TRANSFORM = mat34(mat4::IDENTITY);
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	instance_handle instance_slots::add(const mat34& transform)
+	{
+		const instance_handle handle = _handle_transforms.size();
+		_handle_transforms.push_back(transform);
+		_handle_slots.push_back(NO_SLOT);
+		return handle;
+	}
+
+	const mat34& instance_slots::get_transform(instance_handle handle) const
+	{
+		if(handle >= _handle_transforms.size())
+		{
+			return NO_TRANSFORM;
+		}
+		return _handle_transforms[handle];
+	}
+
+	void instance_slots::set_transform(instance_handle handle, const mat34& transform)
+	{
+		if(handle < _handle_transforms.size())
+		{
+			_handle_transforms[handle] = transform;
+		}
+	}
+
+	unsigned int instance_slots::get_slot(instance_handle handle) const
+	{
+		return handle < _handle_slots.size() ? _handle_slots[handle] : NO_SLOT;
+	}
+
+	instance_handle instance_slots::get_handle(unsigned int slot) const
+	{
+		return slot < _slot_handles.size() ? _slot_handles[slot] : INVALID_INSTANCE;
+	}
+
+	mat34 instance_slots::get_slot_transform(instance_handle handle, const mat34& transform) const
+	{
+		return transform.mul(_slot_locals[_handle_slots[handle]]);
+	}
+
+	bool instance_slots::is_pinned(instance_handle handle) const
+	{
+		return !_pinned_handles.empty() && _pinned_handles.find(handle) != _pinned_handles.end();
+	}
+
+	void instance_slots::reset(unsigned int count)
+	{
+		_handle_slots.assign(_handle_transforms.size(), NO_SLOT);
+		_slot_handles.clear();
+		_slot_handles.reserve(count);
+		_slot_locals.clear();
+		_slot_locals.reserve(count);
+		_pending_instances.clear();
+		_placed = 0;
+	}
+
+	void instance_slots::place(instance_handle handle, unsigned int slot, const mat34& slot_transform)
+	{
+		if(slot >= _slot_handles.size())
+		{
+			_slot_handles.resize(slot + 1, INVALID_INSTANCE);
+			_slot_locals.resize(slot + 1);
+		}
+		_placed += _slot_handles[slot] == INVALID_INSTANCE ? 1 : 0;
+		_handle_slots[handle] = slot;
+		_slot_handles[slot] = handle;
+		_slot_locals[slot] = _local_transform(handle, slot_transform);
+	}
+
+	void instance_slots::move(unsigned int from, unsigned int to)
+	{
+		const auto handle = _slot_handles[from];
+		_placed -= _slot_handles[to] != INVALID_INSTANCE ? 1 : 0;
+		_handle_slots[handle] = to;
+		_slot_handles[to] = handle;
+		_slot_handles[from] = INVALID_INSTANCE;
+		_slot_locals[to] = _slot_locals[from];
+	}
+
+	void instance_slots::release(instance_handle handle)
+	{
+		const auto slot = get_slot(handle);
+		if(slot == NO_SLOT)
+		{
+			return;
+		}
+		_slot_handles[slot] = INVALID_INSTANCE;
+		_handle_slots[handle] = NO_SLOT;
+		--_placed;
+	}
+
+	void instance_slots::remap(const vector<unsigned int>& remap, unsigned int slots)
+	{
+		vector<instance_handle> handles(slots, INVALID_INSTANCE);
+		vector<mat34> locals(slots);
+		for(unsigned int slot = 0; slot < remap.size(); ++slot)
+		{
+			const auto to = remap[slot];
+			const auto handle = _slot_handles[slot];
+			if(to == NO_SLOT || handle == INVALID_INSTANCE)
+			{
+				continue;
+			}
+			handles[to] = handle;
+			locals[to] = _slot_locals[slot];
+			_handle_slots[handle] = to;
+		}
+		_slot_handles.swap(handles);
+		_slot_locals.swap(locals);
+	}
+
+	bool instance_slots::remove_pending(instance_handle handle, unsigned int& set)
+	{
+		for(auto p = _pending_instances.begin(); p != _pending_instances.end(); ++p)
+		{
+			if(p->handle == handle)
+			{
+				set = p->set;
+				_pending_instances.erase(p);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	mat34 instance_slots::_local_transform(instance_handle handle, const mat34& slot_transform)
+	{
+		// a flattened upload transform cannot be undone, the slot transform is kept as it is and the handle pinned
+		const auto& t = _handle_transforms[handle];
+		if(t.is_singular())
+		{
+			_pinned_handles.insert(handle);
+			return slot_transform;
+		}
+		return t.inverse().mul(slot_transform);
+	}
+} // namespace app
@@ -0,0 +1,79 @@
+#pragma once
+#include <app/base_renderer.h>
+#include <app/transformation.h>
+
+namespace app
+{
+	// slot of the handles of merged, removed or waiting instances
+	static const unsigned int NO_SLOT = 0xFFFFFFFFu;
+
+	// handles of a renderer and the slots of the transform stream that draw them
+	// a handle keeps the transform given to add_*, a slot the local transform that carries it to the reference mesh of the slot
+	class instance_slots
+	{
+	public:
+		// instance added after upload to a set without spare slots
+		struct pending_instance
+		{
+			mat34 transform;
+			instance_handle handle = 0;
+			unsigned int set = 0;
+			unsigned char color_id = 0;
+		};
+
+		// new handle without a slot
+		instance_handle add(const mat34& transform);
+		unsigned int get_handle_count() const { return _handle_transforms.size(); }
+
+		// transform given to add or to the last set_transform, identity for handles past get_handle_count
+		const mat34& get_transform(instance_handle handle) const;
+		void set_transform(instance_handle handle, const mat34& transform);
+
+		// NO_SLOT for handles past get_handle_count, INVALID_INSTANCE for empty slots
+		unsigned int get_slot(instance_handle handle) const;
+		instance_handle get_handle(unsigned int slot) const;
+		bool has_slot(instance_handle handle) const { return get_slot(handle) != NO_SLOT; }
+
+		// what the slot of a handle with a slot is given for a handle transform, carried to the reference mesh of the slot
+		mat34 get_slot_transform(instance_handle handle, const mat34& transform) const;
+
+		// a handle added with a singular transform has no local transform, its slot keeps the transform it was placed with
+		bool is_pinned(instance_handle handle) const;
+		unsigned int get_pinned_count() const { return _pinned_handles.size(); }
+
+		// takes every handle out of its slot and makes room for count slots
+		void reset(unsigned int count);
+
+		// slot_transform is the transform of the reference mesh of the slot, slots past the last one are appended
+		void place(instance_handle handle, unsigned int slot, const mat34& slot_transform);
+
+		// the handle of from takes to, from is left empty
+		void move(unsigned int from, unsigned int to);
+		void release(instance_handle handle);
+
+		// old slot i becomes remap[i] of slots, empty ones are dropped and waiting instances are placed afterwards
+		void remap(const vector<unsigned int>& remap, unsigned int slots);
+
+		// instances waiting for the next layout, remove_pending returns the set of the removed one
+		void add_pending(const pending_instance& p) { _pending_instances.push_back(p); }
+		bool remove_pending(instance_handle handle, unsigned int& set);
+		const vector<pending_instance>& get_pending() const { return _pending_instances; }
+		void clear_pending() { _pending_instances.clear(); }
+
+		// slots laid out, and those of them without a handle
+		unsigned int get_slot_count() const { return _slot_handles.size(); }
+		unsigned int get_spare_count() const { return _slot_handles.size() - _placed; }
+
+	private:
+		mat34 _local_transform(instance_handle handle, const mat34& slot_transform);
+
+		// transform of every handle in add order, slot of every handle, handle and local transform of every slot
+		vector<mat34> _handle_transforms;
+		vector<unsigned int> _handle_slots;
+		vector<instance_handle> _slot_handles;
+		vector<mat34> _slot_locals;
+		hash_set<instance_handle> _pinned_handles;
+		vector<pending_instance> _pending_instances;
+		unsigned int _placed = 0;
+	};
+} // namespace app
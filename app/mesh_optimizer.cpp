@@ -0,0 +1,565 @@
+#include <app/mesh_optimizer.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global definitions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	struct triangle_adjacency
+	{
+		vector<unsigned int> offsets;
+		vector<unsigned int> counts;
+		vector<unsigned int> triangles;
+
+		triangle_adjacency(const vector<tess::element>& elements, unsigned int vertex_count)
+		{
+			offsets.resize(vertex_count, 0);
+			counts.resize(vertex_count, 0);
+			triangles.resize(elements.size());
+
+			for(const auto e : elements)
+			{
+				++counts[e];
+			}
+
+			unsigned int offset = 0;
+			for(unsigned int v = 0; v < vertex_count; ++v)
+			{
+				offsets[v] = offset;
+				offset += counts[v];
+			}
+
+			vector<unsigned int> fill = offsets;
+			for(unsigned int i = 0; i < elements.size(); ++i)
+			{
+				triangles[fill[elements[i]]++] = i / 3;
+			}
+		}
+	};
+
+	struct quadric
+	{
+		// symmetric 4x4 plane quadric: a2 ab ac ad b2 bc bd c2 cd d2
+		double q[10] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+		void add_plane(double a, double b, double c, double d, double weight)
+		{
+			q[0] += weight*a*a; q[1] += weight*a*b; q[2] += weight*a*c; q[3] += weight*a*d;
+			q[4] += weight*b*b; q[5] += weight*b*c; q[6] += weight*b*d;
+			q[7] += weight*c*c; q[8] += weight*c*d;
+			q[9] += weight*d*d;
+		}
+
+		double error(const vec3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			return q[0]*x*x + 2.0*q[1]*x*y + 2.0*q[2]*x*z + 2.0*q[3]*x +
+				   q[4]*y*y + 2.0*q[5]*y*z + 2.0*q[6]*y +
+				   q[7]*z*z + 2.0*q[8]*z +
+				   q[9];
+		}
+	};
+
+	struct grid_cell
+	{
+		quadric q;
+		int representative = -1;
+		vector<unsigned int> copies; // vertices sharing the representative position, one per normal
+	};
+
+	struct cluster
+	{
+		unsigned int first_triangle = 0;
+		unsigned int triangle_count = 0;
+		float sort_key = 0.0f;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static float dot3(const vec3& a, const vec3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	static vec3 cross3(const vec3& a, const vec3& b)
+	{
+		return vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+
+	static int skip_dead_end(vector<unsigned int>& dead_end, const vector<unsigned int>& live, unsigned int& cursor)
+	{
+		// 1. look for a recently used vertex that still has triangles to emit
+		while(!dead_end.empty())
+		{
+			const auto d = dead_end.back();
+			dead_end.pop_back();
+			if(live[d] > 0)
+			{
+				return d;
+			}
+		}
+
+		// 2. otherwise continue with the next vertex in input order
+		while(cursor < live.size())
+		{
+			if(live[cursor] > 0)
+			{
+				return cursor;
+			}
+			++cursor;
+		}
+
+		return -1;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	float compute_acmr(const vector<tess::element>& elements, unsigned int vertex_count, unsigned int cache_size /*= VERTEX_CACHE_SIZE*/)
+	{
+		if(elements.empty())
+		{
+			return 0.0f;
+		}
+
+		// cache_time holds the miss counter value when the vertex entered the FIFO
+		vector<unsigned int> cache_time(vertex_count, 0);
+		unsigned int misses = 0;
+		for(const auto e : elements)
+		{
+			if(cache_time[e] == 0 || misses + 1 - cache_time[e] > cache_size)
+			{
+				++misses;
+				cache_time[e] = misses;
+			}
+		}
+
+		return static_cast<float>(misses) / static_cast<float>(elements.size() / 3);
+	}
+
+	void optimize_vertex_cache(vector<tess::element>& elements, unsigned int vertex_count, unsigned int cache_size /*= VERTEX_CACHE_SIZE*/)
+	{
+		const unsigned int triangle_count = elements.size() / 3;
+		if(triangle_count == 0)
+		{
+			return;
+		}
+
+		const triangle_adjacency adjacency(elements, vertex_count);
+
+		vector<unsigned int> live = adjacency.counts;
+		vector<unsigned int> cache_time(vertex_count, 0);
+		vector<bool> emitted(triangle_count, false);
+		vector<unsigned int> dead_end;
+		vector<unsigned int> candidates;
+
+		vector<tess::element> output;
+		output.reserve(elements.size());
+
+		unsigned int timestamp = cache_size + 1;
+		unsigned int cursor = 0;
+		int fanning = elements[0];
+
+		while(fanning >= 0)
+		{
+			// 1. emit all remaining triangles around the fanning vertex
+			candidates.clear();
+			const auto first = adjacency.offsets[fanning];
+			const auto last = first + adjacency.counts[fanning];
+			for(unsigned int a = first; a < last; ++a)
+			{
+				const auto t = adjacency.triangles[a];
+				if(emitted[t])
+				{
+					continue;
+				}
+
+				for(unsigned int k = 0; k < 3; ++k)
+				{
+					const auto v = elements[t*3+k];
+					output.push_back(v);
+					dead_end.push_back(v);
+					candidates.push_back(v);
+					--live[v];
+					if(timestamp - cache_time[v] > cache_size)
+					{
+						cache_time[v] = timestamp++;
+					}
+				}
+				emitted[t] = true;
+			}
+
+			// 2. choose the candidate that will still be in cache after its remaining triangles are emitted
+			int best = -1;
+			int best_priority = -1;
+			for(const auto v : candidates)
+			{
+				if(live[v] == 0)
+				{
+					continue;
+				}
+				int priority = 0;
+				if(timestamp - cache_time[v] + 2 * live[v] <= cache_size)
+				{
+					priority = timestamp - cache_time[v];
+				}
+				if(priority > best_priority)
+				{
+					best_priority = priority;
+					best = v;
+				}
+			}
+
+			// 3. restart from a dead-end vertex when no candidate is left
+			fanning = best >= 0 ? best : skip_dead_end(dead_end, live, cursor);
+		}
+
+		elements.swap(output);
+	}
+
+	void optimize_overdraw(vector<tess::element>& elements, const vector<tess::vertex>& vertices, unsigned int cache_size /*= VERTEX_CACHE_SIZE*/)
+	{
+		const unsigned int triangle_count = elements.size() / 3;
+		if(triangle_count < 2)
+		{
+			return;
+		}
+
+		// 1. split cache-optimized triangle sequence into clusters wherever the cache was completely flushed
+		vector<cluster> clusters;
+		vector<unsigned int> cache_time(vertices.size(), 0);
+		unsigned int misses = 0;
+		for(unsigned int t = 0; t < triangle_count; ++t)
+		{
+			unsigned int triangle_misses = 0;
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				const auto v = elements[t*3+k];
+				if(cache_time[v] == 0 || misses + 1 - cache_time[v] > cache_size)
+				{
+					++misses;
+					++triangle_misses;
+					cache_time[v] = misses;
+				}
+			}
+
+			if(clusters.empty() || triangle_misses == 3)
+			{
+				cluster c;
+				c.first_triangle = t;
+				clusters.push_back(c);
+			}
+			++clusters.back().triangle_count;
+		}
+
+		if(clusters.size() < 2)
+		{
+			return;
+		}
+
+		// 2. compute mesh centroid
+		vec3 mesh_centroid(0.0f, 0.0f, 0.0f);
+		for(const auto& v : vertices)
+		{
+			mesh_centroid = mesh_centroid + v.position;
+		}
+		mesh_centroid = mesh_centroid * (1.0f / vertices.size());
+
+		// 3. sort clusters by how much they face away from the mesh centroid: outer surfaces occlude inner ones
+		for(auto& c : clusters)
+		{
+			vec3 centroid(0.0f, 0.0f, 0.0f);
+			vec3 normal(0.0f, 0.0f, 0.0f);
+			float area = 0.0f;
+			for(unsigned int t = c.first_triangle; t < c.first_triangle + c.triangle_count; ++t)
+			{
+				const auto& p0 = vertices[elements[t*3+0]].position;
+				const auto& p1 = vertices[elements[t*3+1]].position;
+				const auto& p2 = vertices[elements[t*3+2]].position;
+				const auto n = cross3(p1 - p0, p2 - p0);
+				const auto a = std::sqrt(dot3(n, n));
+				centroid = centroid + (p0 + p1 + p2) * (a / 3.0f);
+				normal = normal + n;
+				area += a;
+			}
+			if(area > 0.0f)
+			{
+				centroid = centroid * (1.0f / area);
+			}
+			c.sort_key = dot3(centroid - mesh_centroid, normal);
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const cluster& a, const cluster& b){ return a.sort_key > b.sort_key; });
+
+		// 4. rebuild elements in cluster order
+		vector<tess::element> output;
+		output.reserve(elements.size());
+		for(const auto& c : clusters)
+		{
+			output.insert(output.end(), elements.begin() + c.first_triangle*3, elements.begin() + (c.first_triangle + c.triangle_count)*3);
+		}
+		elements.swap(output);
+	}
+
+	vector<unsigned int> optimize_vertex_fetch(vector<tess::element>& elements, vector<tess::vertex>& vertices)
+	{
+		static const unsigned int UNUSED = ~0u;
+
+		// 1. number vertices in order of first reference
+		vector<unsigned int> remap(vertices.size(), UNUSED);
+		unsigned int next = 0;
+		for(auto& e : elements)
+		{
+			if(remap[e] == UNUSED)
+			{
+				remap[e] = next++;
+			}
+			e = remap[e];
+		}
+
+		// 2. keep unreferenced vertices at the end so that vertex counts still match between shared topologies
+		for(auto& r : remap)
+		{
+			if(r == UNUSED)
+			{
+				r = next++;
+			}
+		}
+
+		remap_vertices(vertices, remap);
+		return remap;
+	}
+
+	vector<tess::element> simplify_clustered(const vector<tess::element>& elements, const vector<tess::vertex>& vertices,
+											 unsigned int grid_resolution, float& error)
+	{
+		vector<tess::element> output;
+		error = 0.0f;
+		if(vertices.empty() || grid_resolution == 0)
+		{
+			return output;
+		}
+
+		// 1. cubic grid cells over the mesh bounds
+		vec3 min = vertices[0].position;
+		vec3 max = vertices[0].position;
+		for(const auto& v : vertices)
+		{
+			min = vec3(math::min(min.x, v.position.x), math::min(min.y, v.position.y), math::min(min.z, v.position.z));
+			max = vec3(math::max(max.x, v.position.x), math::max(max.y, v.position.y), math::max(max.z, v.position.z));
+		}
+		const auto extents = max - min;
+		const auto cell_size = math::max(extents.x, math::max(extents.y, extents.z)) / grid_resolution;
+		if(cell_size <= 0.0f)
+		{
+			return output;
+		}
+		const auto inv_cell_size = 1.0f / cell_size;
+
+		hash_map<bl::uint64, unsigned int> cell_ids;
+		vector<grid_cell> cells;
+		vector<unsigned int> vertex_cells(vertices.size());
+		for(unsigned int i = 0; i < vertices.size(); ++i)
+		{
+			const auto p = (vertices[i].position - min) * inv_cell_size;
+			const bl::uint64 x = math::min(static_cast<unsigned int>(p.x), grid_resolution - 1);
+			const bl::uint64 y = math::min(static_cast<unsigned int>(p.y), grid_resolution - 1);
+			const bl::uint64 z = math::min(static_cast<unsigned int>(p.z), grid_resolution - 1);
+			const auto key = x | (y << 21) | (z << 42);
+
+			auto itr = cell_ids.find(key);
+			if(itr == cell_ids.end())
+			{
+				itr = cell_ids.emplace(key, cells.size()).first;
+				cells.push_back(grid_cell());
+			}
+			vertex_cells[i] = itr->second;
+		}
+
+		// 2. accumulate area weighted triangle planes into the cells touched by each triangle
+		for(unsigned int i = 0; i + 2 < elements.size(); i += 3)
+		{
+			const auto& p0 = vertices[elements[i+0]].position;
+			const auto& p1 = vertices[elements[i+1]].position;
+			const auto& p2 = vertices[elements[i+2]].position;
+			auto n = cross3(p1 - p0, p2 - p0);
+			const auto area = std::sqrt(dot3(n, n));
+			if(area <= 0.0f)
+			{
+				continue;
+			}
+			n = n * (1.0f / area);
+			const auto d = -dot3(n, p0);
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				cells[vertex_cells[elements[i+k]]].q.add_plane(n.x, n.y, n.z, d, area);
+			}
+		}
+
+		// 3. each cell keeps the input vertex of least error, together with its copies for other normals
+		vector<double> cell_errors(cells.size(), 0.0);
+		for(unsigned int i = 0; i < vertices.size(); ++i)
+		{
+			auto& c = cells[vertex_cells[i]];
+			const auto e = c.q.error(vertices[i].position);
+			if(c.representative < 0 || e < cell_errors[vertex_cells[i]])
+			{
+				c.representative = i;
+				cell_errors[vertex_cells[i]] = e;
+			}
+		}
+		for(unsigned int i = 0; i < vertices.size(); ++i)
+		{
+			auto& c = cells[vertex_cells[i]];
+			const auto& r = vertices[c.representative].position;
+			if(r.x == vertices[i].position.x && r.y == vertices[i].position.y && r.z == vertices[i].position.z)
+			{
+				c.copies.push_back(i);
+			}
+		}
+
+		// 4. map corners onto the representative copy with the closest normal and drop collapsed triangles
+		output.reserve(elements.size());
+		for(unsigned int i = 0; i + 2 < elements.size(); i += 3)
+		{
+			const auto c0 = vertex_cells[elements[i+0]];
+			const auto c1 = vertex_cells[elements[i+1]];
+			const auto c2 = vertex_cells[elements[i+2]];
+			if(c0 == c1 || c1 == c2 || c0 == c2)
+			{
+				continue;
+			}
+
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				const auto& v = vertices[elements[i+k]];
+				const auto& c = cells[vertex_cells[elements[i+k]]];
+				auto best = c.copies.front();
+				auto best_dot = dot3(v.normal, vertices[best].normal);
+				for(const auto copy : c.copies)
+				{
+					const auto d = dot3(v.normal, vertices[copy].normal);
+					if(d > best_dot)
+					{
+						best = copy;
+						best_dot = d;
+					}
+				}
+				output.push_back(best);
+			}
+		}
+
+		error = cell_size * std::sqrt(3.0f);
+		return output;
+	}
+
+	void remap_vertices(vector<tess::vertex>& vertices, const vector<unsigned int>& remap)
+	{
+		vector<tess::vertex> output(vertices.size());
+		for(unsigned int i = 0; i < vertices.size(); ++i)
+		{
+			output[remap[i]] = vertices[i];
+		}
+		vertices.swap(output);
+	}
+
+	vector<unsigned char> compute_feature_edges(const vector<tess::element>& elements, const vector<tess::vertex>& vertices, float crease_angle)
+	{
+		const unsigned int triangle_count = elements.size() / 3;
+		vector<unsigned char> masks(triangle_count, 0);
+
+		// 1. weld vertices by position, normals split along creases must not open the mesh
+		vector<unsigned int> order(vertices.size());
+		for(unsigned int i = 0; i < vertices.size(); ++i)
+		{
+			order[i] = i;
+		}
+		auto less = [&](unsigned int a, unsigned int b)
+		{
+			const auto& pa = vertices[a].position;
+			const auto& pb = vertices[b].position;
+			return pa.x < pb.x || (pa.x == pb.x && (pa.y < pb.y || (pa.y == pb.y && pa.z < pb.z)));
+		};
+		std::sort(order.begin(), order.end(), less);
+		vector<unsigned int> welded(vertices.size());
+		unsigned int position_count = 0;
+		for(unsigned int i = 0; i < order.size(); ++i)
+		{
+			if(i > 0 && less(order[i-1], order[i]))
+			{
+				++position_count;
+			}
+			welded[order[i]] = position_count;
+		}
+
+		// 2. unit face normals, zero for degenerate triangles
+		vector<vec3> normals(triangle_count);
+		for(unsigned int t = 0; t < triangle_count; ++t)
+		{
+			const auto& p0 = vertices[elements[t*3+0]].position;
+			const auto& p1 = vertices[elements[t*3+1]].position;
+			const auto& p2 = vertices[elements[t*3+2]].position;
+			const auto n = cross3(p1 - p0, p2 - p0);
+			const auto length = std::sqrt(dot3(n, n));
+			normals[t] = length > 0.0f ? n * (1.0f / length) : vec3(0.0f, 0.0f, 0.0f);
+		}
+
+		// 3. the triangles around each welded edge, only the first two are kept
+		struct edge_faces
+		{
+			unsigned int faces[2];
+			unsigned int count;
+		};
+		hash_map<bl::uint64, unsigned int> edge_ids;
+		vector<edge_faces> edges;
+		vector<unsigned int> triangle_edges(triangle_count * 3, 0);
+		for(unsigned int t = 0; t < triangle_count; ++t)
+		{
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				const bl::uint64 a = welded[elements[t*3 + (k+1)%3]];
+				const bl::uint64 b = welded[elements[t*3 + (k+2)%3]];
+				const auto key = a < b ? (a << 32) | b : (b << 32) | a;
+
+				auto itr = edge_ids.find(key);
+				if(itr == edge_ids.end())
+				{
+					itr = edge_ids.emplace(key, edges.size()).first;
+					edges.push_back(edge_faces{{t, t}, 0});
+				}
+				auto& e = edges[itr->second];
+				if(e.count < 2)
+				{
+					e.faces[e.count] = t;
+				}
+				++e.count;
+				triangle_edges[t*3+k] = itr->second;
+			}
+		}
+
+		// 4. features are open and non-manifold edges and creases between non-degenerate triangles
+		const auto min_cos = std::cos(crease_angle);
+		for(unsigned int t = 0; t < triangle_count; ++t)
+		{
+			if(dot3(normals[t], normals[t]) == 0.0f)
+			{
+				continue;
+			}
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				const auto& e = edges[triangle_edges[t*3+k]];
+				const auto other = e.faces[0] == t ? e.faces[1] : e.faces[0];
+				const auto& n = normals[other];
+				if(e.count != 2 || (dot3(n, n) > 0.0f && dot3(normals[t], n) < min_cos))
+				{
+					masks[t] |= 1 << k;
+				}
+			}
+		}
+		return masks;
+	}
+} // namespace app
@@ -0,0 +1,31 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+
+namespace app
+{
+	static const unsigned int VERTEX_CACHE_SIZE = 16;
+
+	// average cache miss ratio: vertices transformed per triangle with a FIFO post-transform cache
+	float compute_acmr(const vector<tess::element>& elements, unsigned int vertex_count, unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+	// reorder triangles for post-transform cache hits (Tipsify, Sander et al. 2007)
+	void optimize_vertex_cache(vector<tess::element>& elements, unsigned int vertex_count, unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+	// reorder cache-friendly clusters of triangles so that outward-facing clusters are drawn first
+	void optimize_overdraw(vector<tess::element>& elements, const vector<tess::vertex>& vertices, unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+	// reorder vertices by first use in elements, returns the old -> new vertex index remap
+	vector<unsigned int> optimize_vertex_fetch(vector<tess::element>& elements, vector<tess::vertex>& vertices);
+
+	// simplify by clustering vertices on a regular grid, each cell collapses onto its vertex of least quadric error
+	// output only references input vertices, error is the cell diagonal in mesh units
+	vector<tess::element> simplify_clustered(const vector<tess::element>& elements, const vector<tess::vertex>& vertices,
+											 unsigned int grid_resolution, float& error);
+
+	// apply a remap returned by optimize_vertex_fetch to another vertex list with the same connectivity
+	void remap_vertices(vector<tess::vertex>& vertices, const vector<unsigned int>& remap);
+
+	// one mask per triangle, bit k marks the edge opposite corner k as a feature edge:
+	// open, shared by more than two triangles or folded by more than crease_angle radians
+	vector<unsigned char> compute_feature_edges(const vector<tess::element>& elements, const vector<tess::vertex>& vertices, float crease_angle);
+} // namespace app
@@ -0,0 +1,220 @@
+#include <app/meshlet.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static float dot3(const vec3& a, const vec3& b)
+	{
+		return a.x*b.x + a.y*b.y + a.z*b.z;
+	}
+
+	static vec3 cross3(const vec3& a, const vec3& b)
+	{
+		return vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+
+	static float length3(const vec3& v)
+	{
+		return std::sqrt(dot3(v, v));
+	}
+
+	// rotation, mirror and uniform scale only: equal column lengths and pairwise orthogonal columns
+	static bool is_similarity(const mat34& t)
+	{
+		const auto* d = t.data;
+		const vec3 c0(d[0], d[4], d[8]);
+		const vec3 c1(d[1], d[5], d[9]);
+		const vec3 c2(d[2], d[6], d[10]);
+		const auto s = t.squared_scale();
+		const auto max_s = math::max(s.x, math::max(s.y, s.z));
+		const auto min_s = math::min(s.x, math::min(s.y, s.z));
+		const auto tolerance = max_s * 0.02f;
+		return min_s > max_s - tolerance &&
+			   std::abs(dot3(c0, c1)) < tolerance && std::abs(dot3(c0, c2)) < tolerance && std::abs(dot3(c1, c2)) < tolerance;
+	}
+
+	static void compute_bounds(meshlet& m, const vector<tess::element>& elements, const vector<tess::vertex>& vertices)
+	{
+		const auto first = m.first_element;
+		const auto last = m.first_element + m.element_count;
+
+		// 1. bounding sphere (Ritter): start from the two most distant points along the first vertex
+		const auto& p0 = vertices[elements[first]].position;
+		auto pa = p0;
+		for(auto i = first; i < last; ++i)
+		{
+			const auto& p = vertices[elements[i]].position;
+			if(dot3(p - p0, p - p0) > dot3(pa - p0, pa - p0))
+			{
+				pa = p;
+			}
+		}
+		auto pb = pa;
+		for(auto i = first; i < last; ++i)
+		{
+			const auto& p = vertices[elements[i]].position;
+			if(dot3(p - pa, p - pa) > dot3(pb - pa, pb - pa))
+			{
+				pb = p;
+			}
+		}
+		m.center = (pa + pb) * 0.5f;
+		m.radius = length3(pb - pa) * 0.5f;
+		for(auto i = first; i < last; ++i)
+		{
+			const auto& p = vertices[elements[i]].position;
+			const auto d = length3(p - m.center);
+			if(d > m.radius)
+			{
+				// grow sphere just enough to enclose p
+				const auto new_radius = (m.radius + d) * 0.5f;
+				m.center = m.center + (p - m.center) * ((new_radius - m.radius) / d);
+				m.radius = new_radius;
+			}
+		}
+
+		// 2. normal cone from face normals, turned to the side of the shading normals: mirrored geometry has inverted winding
+		vector<vec3> normals;
+		normals.reserve(m.element_count / 3);
+		vec3 axis(0.0f, 0.0f, 0.0f);
+		for(auto i = first; i < last; i += 3)
+		{
+			const auto& a = vertices[elements[i+0]];
+			const auto& b = vertices[elements[i+1]];
+			const auto& c = vertices[elements[i+2]];
+			auto n = cross3(b.position - a.position, c.position - a.position);
+			if(dot3(n, a.normal + b.normal + c.normal) < 0.0f)
+			{
+				n = n * -1.0f;
+			}
+			const auto l = length3(n);
+			if(l > 0.0f)
+			{
+				normals.push_back(n * (1.0f / l));
+				axis = axis + normals.back();
+			}
+		}
+
+		const auto axis_length = length3(axis);
+		if(normals.empty() || axis_length == 0.0f)
+		{
+			return;
+		}
+		m.cone_axis = axis * (1.0f / axis_length);
+
+		float min_dot = 1.0f;
+		for(const auto& n : normals)
+		{
+			min_dot = math::min(min_dot, dot3(n, m.cone_axis));
+		}
+
+		// cone wider than a hemisphere can never be back facing as a whole
+		m.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	vector<meshlet> build_meshlets(const vector<tess::element>& elements, const vector<tess::vertex>& vertices,
+								   unsigned int max_vertices /*= MESHLET_MAX_VERTICES*/, unsigned int max_triangles /*= MESHLET_MAX_TRIANGLES*/)
+	{
+		vector<meshlet> meshlets;
+
+		// greedily cut the cache-optimized triangle order into ranges, neighboring triangles already share vertices
+		vector<unsigned int> last_use(vertices.size(), ~0u);
+		meshlet current;
+		unsigned int vertex_count = 0;
+
+		for(unsigned int i = 0; i < elements.size(); i += 3)
+		{
+			unsigned int new_vertices = 0;
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				new_vertices += last_use[elements[i+k]] != meshlets.size() ? 1 : 0;
+			}
+
+			if(current.element_count / 3 == max_triangles || vertex_count + new_vertices > max_vertices)
+			{
+				compute_bounds(current, elements, vertices);
+				meshlets.push_back(current);
+				current = meshlet();
+				current.first_element = i;
+				vertex_count = 0;
+			}
+
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				auto& use = last_use[elements[i+k]];
+				if(use != meshlets.size())
+				{
+					use = meshlets.size();
+					++vertex_count;
+				}
+			}
+			current.element_count += 3;
+		}
+
+		if(current.element_count > 0)
+		{
+			compute_bounds(current, elements, vertices);
+			meshlets.push_back(current);
+		}
+
+		return meshlets;
+	}
+
+	unsigned int cull_meshlets(const meshlet* meshlets, unsigned int count, const mat34& transform, const frustum& f, vector<draw_range>& ranges)
+	{
+		// normal cones are only preserved by similarity transforms
+		// a mirror keeps the outside of a closed surface at M * n even though it flips the winding, and no pass culls by winding
+		const bool test_cones = is_similarity(transform);
+		const auto max_scale = transform.max_scale();
+
+		const auto first_range = ranges.size();
+		unsigned int culled_triangles = 0;
+
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			const auto& m = meshlets[i];
+			const auto center = transform.mul(m.center);
+			const auto radius = m.radius * max_scale;
+
+			// 1. view frustum
+			bool culled = f.is_sphere_outside(center, radius);
+
+			// 2. back facing cluster
+			if(!culled && test_cones && m.cone_cutoff < 1.0f)
+			{
+				auto axis = transform.mul3x3(m.cone_axis);
+				axis = axis * (1.0f / length3(axis));
+				const auto view = center - f.get_eye();
+				culled = dot3(view, axis) >= m.cone_cutoff * length3(view) + radius;
+			}
+
+			if(culled)
+			{
+				culled_triangles += m.element_count / 3;
+				continue;
+			}
+
+			// 3. merge with previous range when contiguous
+			if(ranges.size() > first_range && ranges.back().first_element + ranges.back().element_count == m.first_element)
+			{
+				ranges.back().element_count += m.element_count;
+			}
+			else
+			{
+				draw_range r;
+				r.first_element = m.first_element;
+				r.element_count = m.element_count;
+				ranges.push_back(r);
+			}
+		}
+
+		return culled_triangles;
+	}
+} // namespace app
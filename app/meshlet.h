@@ -0,0 +1,33 @@
+#pragma once
+#include <app/frustum.h>
+#include <app/transformation.h>
+#include <tess/triangle_mesh.h>
+
+namespace app
+{
+	static const unsigned int MESHLET_MAX_VERTICES = 64;
+	static const unsigned int MESHLET_MAX_TRIANGLES = 126;
+
+	// contiguous range of triangles in a mesh element list with its bounds in mesh space
+	struct meshlet
+	{
+		unsigned int first_element = 0;
+		unsigned int element_count = 0;
+		vec3 center;
+		float radius = 0.0f;
+		vec3 cone_axis;
+		float cone_cutoff = 1.0f;
+	};
+
+	struct draw_range
+	{
+		unsigned int first_element = 0;
+		unsigned int element_count = 0;
+	};
+
+	vector<meshlet> build_meshlets(const vector<tess::element>& elements, const vector<tess::vertex>& vertices,
+								   unsigned int max_vertices = MESHLET_MAX_VERTICES, unsigned int max_triangles = MESHLET_MAX_TRIANGLES);
+
+	// appends visible meshlets of one instance as merged element ranges, returns the number of culled triangles
+	unsigned int cull_meshlets(const meshlet* meshlets, unsigned int count, const mat34& transform, const frustum& f, vector<draw_range>& ranges);
+} // namespace app
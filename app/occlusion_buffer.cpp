@@ -0,0 +1,269 @@
+#include <app/occlusion_buffer.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE 1
+#include <xmmintrin.h>
+#else
+#define OCCLUSION_SSE 0
+#endif
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// vertices closer to the eye plane are not projected, their triangles are skipped
+	static const float MIN_W = 1e-3f;
+
+	static const unsigned int BOX_ELEMENTS[36] =
+	{
+		0, 2, 1,  1, 2, 3,
+		4, 5, 6,  5, 7, 6,
+		0, 1, 4,  1, 5, 4,
+		2, 6, 3,  3, 6, 7,
+		0, 4, 2,  2, 4, 6,
+		1, 3, 5,  3, 7, 5
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	occlusion_buffer::occlusion_buffer(int width /*= OCCLUSION_BUFFER_WIDTH*/, int height /*= OCCLUSION_BUFFER_HEIGHT*/) : _width(width), _height(height)
+	{
+		_depth.assign(_width * _height, 0.0f);
+		for(int i = 0; i < 16; ++i)
+		{
+			_view_projection[i] = 0.0f;
+		}
+	}
+
+	void occlusion_buffer::begin(const frustum& f)
+	{
+		std::fill(_depth.begin(), _depth.end(), 0.0f);
+		_rasterized_triangles = 0;
+
+		const auto& m = f.get_view_projection();
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				_view_projection[r*4 + c] = m.at(r,c);
+			}
+		}
+	}
+
+	void occlusion_buffer::rasterize(const vector<vec3>& positions, const vector<unsigned int>& elements, const mat34& transform)
+	{
+		// 1. project every vertex once
+		vector<screen_vertex> projected(positions.size());
+		vector<char> valid(positions.size());
+		for(unsigned int i = 0; i < positions.size(); ++i)
+		{
+			valid[i] = _project(transform.mul(positions[i]), projected[i]);
+		}
+
+		// 2. both faces are drawn, occluders need not be consistently wound
+		for(unsigned int i = 0; i + 2 < elements.size(); i += 3)
+		{
+			const auto a = elements[i+0];
+			const auto b = elements[i+1];
+			const auto c = elements[i+2];
+			if(valid[a] && valid[b] && valid[c])
+			{
+				_rasterize_triangle(projected[a], projected[b], projected[c]);
+			}
+		}
+	}
+
+	void occlusion_buffer::rasterize_box(const mat34& transform)
+	{
+		screen_vertex corners[8];
+		for(int i = 0; i < 8; ++i)
+		{
+			const vec3 p((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+			if(!_project(transform.mul(p), corners[i]))
+			{
+				return;
+			}
+		}
+
+		for(int i = 0; i < 36; i += 3)
+		{
+			_rasterize_triangle(corners[BOX_ELEMENTS[i+0]], corners[BOX_ELEMENTS[i+1]], corners[BOX_ELEMENTS[i+2]]);
+		}
+	}
+
+	bool occlusion_buffer::is_sphere_visible(const vec3& center, float radius) const
+	{
+		// 1. screen rectangle and nearest depth of the sphere's bounding box
+		float min_x = math::limit_posf(), min_y = math::limit_posf();
+		float max_x = math::limit_negf(), max_y = math::limit_negf();
+		float nearest = 0.0f;
+		for(int i = 0; i < 8; ++i)
+		{
+			const vec3 corner(center.x + ((i & 1) ? radius : -radius), center.y + ((i & 2) ? radius : -radius), center.z + ((i & 4) ? radius : -radius));
+			screen_vertex v;
+			if(!_project(corner, v))
+			{
+				return true;
+			}
+			min_x = math::min(min_x, v.x);
+			min_y = math::min(min_y, v.y);
+			max_x = math::max(max_x, v.x);
+			max_y = math::max(max_y, v.y);
+			nearest = math::max(nearest, v.inverse_w);
+		}
+
+		// occluders cover a pixel when they cover its center, so the rectangle grows by a pixel on each side: a sphere reaching
+		// past a silhouette by less than half a pixel then still meets an empty neighbour
+		const int x0 = math::max(0, static_cast<int>(std::floor(min_x)) - 1);
+		const int y0 = math::max(0, static_cast<int>(std::floor(min_y)) - 1);
+		const int x1 = math::min(_width - 1, static_cast<int>(std::floor(max_x)) + 1);
+		const int y1 = math::min(_height - 1, static_cast<int>(std::floor(max_y)) + 1);
+		if(x0 > x1 || y0 > y1)
+		{
+			return true;
+		}
+
+		// 2. visible as soon as one pixel is empty or holds an occluder behind the sphere
+		for(int y = y0; y <= y1; ++y)
+		{
+			const auto row = _depth.data() + y * _width;
+#if OCCLUSION_SSE
+			const auto sphere_depth = _mm_set1_ps(nearest);
+			for(int x = x0 & ~3; x <= x1; x += 4)
+			{
+				auto mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(row + x), sphere_depth));
+				if(x < x0)
+				{
+					mask &= ~((1 << (x0 - x)) - 1);
+				}
+				if(x + 3 > x1)
+				{
+					mask &= (1 << (x1 - x + 1)) - 1;
+				}
+				if(mask)
+				{
+					return true;
+				}
+			}
+#else
+			for(int x = x0; x <= x1; ++x)
+			{
+				if(row[x] < nearest)
+				{
+					return true;
+				}
+			}
+#endif
+		}
+		return false;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	bool occlusion_buffer::_project(const vec3& p, screen_vertex& v) const
+	{
+		const auto* m = _view_projection;
+		const auto w = m[12]*p.x + m[13]*p.y + m[14]*p.z + m[15];
+		if(w < MIN_W)
+		{
+			return false;
+		}
+
+		const auto x = m[0]*p.x + m[1]*p.y + m[2]*p.z + m[3];
+		const auto y = m[4]*p.x + m[5]*p.y + m[6]*p.z + m[7];
+		v.inverse_w = 1.0f / w;
+		v.x = (x * v.inverse_w * 0.5f + 0.5f) * _width;
+		v.y = (y * v.inverse_w * 0.5f + 0.5f) * _height;
+		return true;
+	}
+
+	void occlusion_buffer::_rasterize_triangle(screen_vertex a, screen_vertex b, screen_vertex c)
+	{
+		// 1. counter-clockwise order so that inside is where all edge functions are positive
+		auto area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if(area < 0.0f)
+		{
+			std::swap(b, c);
+			area = -area;
+		}
+		if(area <= 0.0f)
+		{
+			return;
+		}
+
+		const int x0 = math::max(0, static_cast<int>(std::floor(math::min(a.x, math::min(b.x, c.x)))));
+		const int y0 = math::max(0, static_cast<int>(std::floor(math::min(a.y, math::min(b.y, c.y)))));
+		const int x1 = math::min(_width - 1, static_cast<int>(std::floor(math::max(a.x, math::max(b.x, c.x)))));
+		const int y1 = math::min(_height - 1, static_cast<int>(std::floor(math::max(a.y, math::max(b.y, c.y)))));
+		if(x0 > x1 || y0 > y1)
+		{
+			return;
+		}
+		++_rasterized_triangles;
+
+		// 2. edge functions and 1/w are linear in screen space: value at the first pixel center plus per pixel steps
+		const auto px = (x0 & ~3) + 0.5f;
+		const auto py = y0 + 0.5f;
+
+		const auto e_bc = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+		const auto e_ca = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+		const auto e_ab = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+		const float dx_bc = -(c.y - b.y), dy_bc = c.x - b.x;
+		const float dx_ca = -(a.y - c.y), dy_ca = a.x - c.x;
+		const float dx_ab = -(b.y - a.y), dy_ab = b.x - a.x;
+
+		const auto inverse_area = 1.0f / area;
+		const auto z = (e_bc * a.inverse_w + e_ca * b.inverse_w + e_ab * c.inverse_w) * inverse_area;
+		const auto dx_z = (dx_bc * a.inverse_w + dx_ca * b.inverse_w + dx_ab * c.inverse_w) * inverse_area;
+		const auto dy_z = (dy_bc * a.inverse_w + dy_ca * b.inverse_w + dy_ab * c.inverse_w) * inverse_area;
+
+		// 3. keep the closest depth of every covered pixel center, 4 pixels at a time
+		for(int y = y0; y <= y1; ++y)
+		{
+			const auto rows = static_cast<float>(y - y0);
+			auto row = _depth.data() + y * _width;
+#if OCCLUSION_SSE
+			const auto steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			auto v_bc = _mm_add_ps(_mm_set1_ps(e_bc + rows * dy_bc), _mm_mul_ps(steps, _mm_set1_ps(dx_bc)));
+			auto v_ca = _mm_add_ps(_mm_set1_ps(e_ca + rows * dy_ca), _mm_mul_ps(steps, _mm_set1_ps(dx_ca)));
+			auto v_ab = _mm_add_ps(_mm_set1_ps(e_ab + rows * dy_ab), _mm_mul_ps(steps, _mm_set1_ps(dx_ab)));
+			auto v_z = _mm_add_ps(_mm_set1_ps(z + rows * dy_z), _mm_mul_ps(steps, _mm_set1_ps(dx_z)));
+			const auto step_bc = _mm_set1_ps(4.0f * dx_bc);
+			const auto step_ca = _mm_set1_ps(4.0f * dx_ca);
+			const auto step_ab = _mm_set1_ps(4.0f * dx_ab);
+			const auto step_z = _mm_set1_ps(4.0f * dx_z);
+			const auto zero = _mm_setzero_ps();
+
+			for(int x = x0 & ~3; x <= x1; x += 4)
+			{
+				const auto inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(v_bc, zero), _mm_cmpge_ps(v_ca, zero)), _mm_cmpge_ps(v_ab, zero));
+				if(_mm_movemask_ps(inside))
+				{
+					const auto depth = _mm_loadu_ps(row + x);
+					const auto closest = _mm_max_ps(depth, v_z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, depth)));
+				}
+				v_bc = _mm_add_ps(v_bc, step_bc);
+				v_ca = _mm_add_ps(v_ca, step_ca);
+				v_ab = _mm_add_ps(v_ab, step_ab);
+				v_z = _mm_add_ps(v_z, step_z);
+			}
+#else
+			for(int x = x0 & ~3; x <= x1; ++x)
+			{
+				const auto columns = static_cast<float>(x - (x0 & ~3));
+				if(e_bc + rows * dy_bc + columns * dx_bc >= 0.0f && e_ca + rows * dy_ca + columns * dx_ca >= 0.0f && e_ab + rows * dy_ab + columns * dx_ab >= 0.0f)
+				{
+					row[x] = math::max(row[x], z + rows * dy_z + columns * dx_z);
+				}
+			}
+#endif
+		}
+	}
+} // namespace app
@@ -0,0 +1,51 @@
+#pragma once
+#include <app/frustum.h>
+#include <app/transformation.h>
+
+namespace app
+{
+	static const int OCCLUSION_BUFFER_WIDTH = 256;
+	static const int OCCLUSION_BUFFER_HEIGHT = 128;
+
+	// low resolution depth buffer rasterized on the CPU from a few large occluders
+	// stores 1/w per pixel, 0 where nothing was drawn, so larger values are closer to the eye
+	class occlusion_buffer
+	{
+	public:
+		// width must be a multiple of 4
+		explicit occlusion_buffer(int width = OCCLUSION_BUFFER_WIDTH, int height = OCCLUSION_BUFFER_HEIGHT);
+
+		// clear and take the camera of the next frame
+		void begin(const frustum& f);
+
+		void rasterize(const vector<vec3>& positions, const vector<unsigned int>& elements, const mat34& transform);
+
+		// unit cube centered on the origin
+		void rasterize_box(const mat34& transform);
+
+		// conservative: true unless every pixel covered by the sphere, and every pixel next to them, holds an occluder in front of it
+		bool is_sphere_visible(const vec3& center, float radius) const;
+
+		int get_width() const { return _width; }
+		int get_height() const { return _height; }
+		const vector<float>& get_depth() const { return _depth; }
+		unsigned int get_rasterized_triangles() const { return _rasterized_triangles; }
+
+	private:
+		struct screen_vertex
+		{
+			float x = 0.0f;
+			float y = 0.0f;
+			float inverse_w = 0.0f;
+		};
+
+		bool _project(const vec3& p, screen_vertex& v) const;
+		void _rasterize_triangle(screen_vertex a, screen_vertex b, screen_vertex c);
+
+		int _width;
+		int _height;
+		vector<float> _depth;
+		float _view_projection[16];
+		unsigned int _rasterized_triangles = 0;
+	};
+} // namespace app
@@ -7,18 +7,190 @@
 
 namespace app
 {
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global definitions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	struct circular_torus_data
+	{
+		vec3 scale; float radius_in;
+		vec3 rotation; float radius_out;
+		vec3 translation; float sweep_angle;
+	};
+
+	struct cone_data
+	{
+		vec3 scale; float pad;
+		vec3 rotation; float bottom_radius;
+		vec3 translation; float top_radius;
+	};
+
+	struct cone_offset_data
+	{
+		vec3 scale; float pad;
+		vec3 rotation; float pad2;
+		vec3 translation; float pad3;
+		float bottom_radius; float top_radius; vec2 offset;
+	};
+
+	struct cylinder_offset_data
+	{
+		vec3 scale; float offset_x;
+		vec3 rotation; float offset_y;
+		vec3 translation; float radius;
+	};
+
+	struct cylinder_slope_data
+	{
+		vec3 scale; float radius;
+		vec3 rotation; float height;
+		vec3 translation; float pad;
+		vec2 bottom_angles; vec2 top_angles;
+	};
+
+	struct pyramid_data
+	{
+		vec3 scale; float offset_x;
+		vec3 rotation; float offset_y;
+		vec3 translation; float height;
+		vec2 bottom_lenghts; vec2 top_lenghts;
+	};
+
+	struct rectangular_torus_data
+	{
+		vec3 scale; float radius_in;
+		vec3 rotation; float radius_out;
+		vec3 translation; float sweep_angle;
+	};
+
+	// how each primitive type is stored and drawn
+	struct primitive_info
+	{
+		const char* name;
+		const char* vertex_shader;
+		unsigned int format;
+		unsigned int stride;
+		bool flat;
+		bool caps;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static const int TRANSFORM_TEXTURE_UNIT = 0;
+	static const int COLOR_ATTRIB = 7;
+
+	// coarsest level, the finest is 16 segments around
+	static const unsigned int MIN_RESOLUTION_FLAT = 4;
+	static const unsigned int MIN_RESOLUTION_SMOOTH_X = 4;
+	static const unsigned int MIN_RESOLUTION_SMOOTH_Y = 2;
+
+	// largest chord error in pixels allowed on screen
+	static const float LOD_PIXEL_ERROR = 0.5f;
+
+	// largest slope tangent accounted for in the bounds of a sloped cylinder
+	static const float MAX_SLOPE_TANGENT = 10.0f;
+
+	// boxes with a larger world radius are candidate occluders, in model units
+	static const float OCCLUDER_MIN_RADIUS = 2.0f;
+	static const float OCCLUDER_MIN_PIXELS = 32.0f;
+	static const unsigned int MAX_OCCLUDERS = 64;
+
+	// indexed by primitive_type
+	static const primitive_info PRIMITIVES[PRIMITIVE_TYPES] =
+	{
+		{"box",               "../shaders/environ/box.vert",              GL_RGB32F,  sizeof(transformation),         true,  true},
+		{"pyramid",           "../shaders/environ/pyramid.vert",          GL_RGBA32F, sizeof(pyramid_data),           true,  true},
+		{"rectangular torus", "../shaders/environ/rectangularTorus.vert", GL_RGBA32F, sizeof(rectangular_torus_data), true,  false},
+		{"circular torus",    "../shaders/environ/circularTorus.vert",    GL_RGBA32F, sizeof(circular_torus_data),    false, false},
+		{"cone",              "../shaders/environ/cone.vert",             GL_RGBA32F, sizeof(cone_data),              false, true},
+		{"cone offset",       "../shaders/environ/coneOffset.vert",       GL_RGBA32F, sizeof(cone_offset_data),       false, true},
+		{"cylinder",          "../shaders/environ/cylinder.vert",         GL_RGB32F,  sizeof(transformation),         false, true},
+		{"cylinder offset",   "../shaders/environ/cylinderOffset.vert",   GL_RGBA32F, sizeof(cylinder_offset_data),   false, true},
+		{"cylinder slope",    "../shaders/environ/cylinderSlope.vert",    GL_RGBA32F, sizeof(cylinder_slope_data),    false, true},
+		{"dish",              "../shaders/environ/dish.vert",             GL_RGB32F,  sizeof(transformation),         false, false},
+		{"sphere",            "../shaders/environ/sphere.vert",           GL_RGB32F,  sizeof(transformation),         false, false},
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static float length2(float x, float y)
+	{
+		return std::sqrt(x*x + y*y);
+	}
+
+	// every pass shares the vertex stage, visibility programs write the type of the program as object id
+	// and the wireframe stage outlines the quads of the parametric surface instead of reading edge masks
+	static bool build_program(glb::shader_program_builder& builder, const char* vertex_shader, render_pass pass,
+							  glb::framebuffer& fbuffer, glb::camera& cam, glb::shader_program& program)
+	{
+		if(!begin_pass_program(builder, vertex_shader, "../shaders/visibility_object.frag", pass))
+		{
+			return false;
+		}
+		builder.bind_vertex_attrib("in_position", 0);
+		builder.bind_vertex_attrib("in_color", COLOR_ATTRIB);
+		if(!end_pass_program(builder, pass, fbuffer, cam, program))
+		{
+			return false;
+		}
+		program.set_uniform("tex_transforms", TRANSFORM_TEXTURE_UNIT);
+		if(pass == render_pass_wireframe)
+		{
+			program.set_uniform("triangle_base", -1);
+		}
+		return true;
+	}
+
+	// scale, rotation and translation lead every record, packed or as the xyz of the first three texels
+	static void write_transformation(char* record, primitive_type type, const transformation& t)
+	{
+		const auto step = PRIMITIVES[type].format == GL_RGB32F ? sizeof(vec3) : 4 * sizeof(float);
+		const vec3* parts[] = {&t.scale, &t.rotation, &t.translation};
+		for(int i = 0; i < 3; ++i)
+		{
+			const auto bytes = reinterpret_cast<const char*>(parts[i]);
+			std::copy(bytes, bytes + sizeof(vec3), record + i * step);
+		}
+	}
+
+	// capped flats are a single segment at every level
+	static bool has_lods(primitive_type type)
+	{
+		return !(PRIMITIVES[type].flat && PRIMITIVES[type].caps);
+	}
+
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// public
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 
-	void parametric_instance_renderer::add_box(const box& b, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_box(const box& b, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= b.extents;
-		_box.transforms_buffer.add(t);
+		const auto handle = _add_instance(primitive_box, t, transform, 0.5f * std::sqrt(b.extents.x*b.extents.x + b.extents.y*b.extents.y + b.extents.z*b.extents.z), b.extents);
+
+		if(_instances.back().bounds.radius >= OCCLUDER_MIN_RADIUS)
+		{
+			box_occluder occluder;
+			occluder.transform = mat34(transform);
+			for(int r = 0; r < 3; ++r)
+			{
+				occluder.transform.data[r*4 + 0] *= b.extents.x;
+				occluder.transform.data[r*4 + 1] *= b.extents.y;
+				occluder.transform.data[r*4 + 2] *= b.extents.z;
+			}
+			occluder.instance = handle;
+			_instances.back().occluder = _box_occluders.size();
+			_box_occluders.push_back(occluder);
+		}
+		return handle;
 	}
 
-	void parametric_instance_renderer::add_circular_torus(const circular_torus& c, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_circular_torus(const circular_torus& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		circular_torus_data ctd;
@@ -28,10 +200,10 @@ namespace app
 		ctd.radius_in = c.in_radius;
 		ctd.radius_out = c.out_radius;
 		ctd.sweep_angle = c.sweep_angle;
-		_circular_torus.transforms_buffer.add(ctd);
+		return _add_instance(primitive_circular_torus, ctd, transform, c.in_radius + c.out_radius, vec3(1.0f));
 	}
 
-	void parametric_instance_renderer::add_cone(const cone& c, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_cone(const cone& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		cone_data cd;
@@ -40,10 +212,10 @@ namespace app
 		cd.translation = t.translation;
 		cd.bottom_radius = c.bottom_radius;
 		cd.top_radius = c.top_radius;
-		_cone.transforms_buffer.add(cd);
+		return _add_instance(primitive_cone, cd, transform, length2(math::max(c.bottom_radius, c.top_radius), 0.5f * c.height), vec3(1.0f, 1.0f, c.height));
 	}
 
-	void parametric_instance_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		cone_offset_data cod;
@@ -53,17 +225,18 @@ namespace app
 		cod.bottom_radius = c.bottom_radius;
 		cod.top_radius = c.top_radius;
 		cod.offset = c.offset;
-		_cone_offset.transforms_buffer.add(cod);
+		const auto offset = length2(c.offset.x, c.offset.y);
+		return _add_instance(primitive_cone_offset, cod, transform, length2(math::max(c.bottom_radius, c.top_radius) + offset, 0.5f * c.height), vec3(1.0f, 1.0f, c.height));
 	}
 
-	void parametric_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(c.radius, c.radius, c.height);
-		_cylinder.transforms_buffer.add(t);
+		return _add_instance(primitive_cylinder, t, transform, length2(c.radius, 0.5f * c.height), vec3(c.radius, c.radius, c.height));
 	}
 
-	void parametric_instance_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		cylinder_offset_data cod;
@@ -73,10 +246,10 @@ namespace app
 		cod.offset_x = c.offset.x;
 		cod.offset_y = c.offset.y;
 		cod.radius = c.radius;
-		_cylinder_offset.transforms_buffer.add(cod);
+		return _add_instance(primitive_cylinder_offset, cod, transform, length2(c.radius + length2(c.offset.x, c.offset.y), 0.5f * c.height), vec3(1.0f, 1.0f, c.height));
 	}
 
-	void parametric_instance_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		cylinder_slope_data csd;
@@ -87,17 +260,24 @@ namespace app
 		csd.top_angles  = c.top_slope_angles;
 		csd.height = c.height;
 		csd.radius = c.radius;
-		_cylinder_slope.transforms_buffer.add(csd);
+
+		// sloped caps reach further along the axis than the straight body
+		float slope = 0.0f;
+		for(auto angle : {c.bottom_slope_angles.x, c.bottom_slope_angles.y, c.top_slope_angles.x, c.top_slope_angles.y})
+		{
+			slope = math::max(slope, math::min(std::abs(std::tan(angle)), MAX_SLOPE_TANGENT));
+		}
+		return _add_instance(primitive_cylinder_slope, csd, transform, length2(c.radius, 0.5f * c.height + c.radius * slope), vec3(1.0f));
 	}
 
-	void parametric_instance_renderer::add_dish(const dish& d, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_dish(const dish& d, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(d.radius, d.radius, d.height);
-		_dish.transforms_buffer.add(t);
+		return _add_instance(primitive_dish, t, transform, length2(d.radius, d.height), vec3(d.radius, d.radius, d.height));
 	}
 
-	void parametric_instance_renderer::add_pyramid(const pyramid& p, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_pyramid(const pyramid& p, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		pyramid_data pd;
@@ -109,10 +289,12 @@ namespace app
 		pd.height = p.height;
 		pd.bottom_lenghts = p.bottom_extents;
 		pd.top_lenghts = p.top_extents;
-		_pyramid.transforms_buffer.add(pd);
+		const auto bottom = 0.5f * length2(p.bottom_extents.x, p.bottom_extents.y);
+		const auto top = 0.5f * length2(p.top_extents.x, p.top_extents.y) + length2(p.offset.x, p.offset.y);
+		return _add_instance(primitive_pyramid, pd, transform, length2(math::max(bottom, top), 0.5f * p.height), vec3(1.0f));
 	}
 
-	void parametric_instance_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		rectangular_torus_data rtd;
@@ -122,422 +304,175 @@ namespace app
 		rtd.radius_in = rt.in_radius;
 		rtd.radius_out = rt.out_radius;
 		rtd.sweep_angle = rt.sweep_angle;
-		_rectangular_torus.transforms_buffer.add(rtd);
+		return _add_instance(primitive_rectangular_torus, rtd, transform, length2(math::max(rt.in_radius, rt.out_radius), rt.in_height), vec3(1.0f, 1.0f, rt.in_height));
 	}
 
-	void parametric_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
+	instance_handle parametric_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(s.radius);
-		_sphere.transforms_buffer.add(t);
+		return _add_instance(primitive_sphere, t, transform, s.radius, vec3(s.radius));
 	}
 
 	void parametric_instance_renderer::end_upload()
 	{
-		unsigned int total = 0;
-
-		total += _box.transforms_buffer.get_size_bytes();
-		total += _circular_torus.transforms_buffer.get_size_bytes();
-		total += _cone.transforms_buffer.get_size_bytes();
-		total += _cone_offset.transforms_buffer.get_size_bytes();
-		total += _cylinder.transforms_buffer.get_size_bytes();
-		total += _cylinder_offset.transforms_buffer.get_size_bytes();
-		total += _cylinder_slope.transforms_buffer.get_size_bytes();
-		total += _dish.transforms_buffer.get_size_bytes();
-		total += _pyramid.transforms_buffer.get_size_bytes();
-		total += _rectangular_torus.transforms_buffer.get_size_bytes();
-		total += _sphere.transforms_buffer.get_size_bytes();
-		io::print("-- memory parametric:", (double)total / 1024.0 / 1024.0, "MB");
-
-		io::print("total box:", _box.transforms_buffer.get_count());
-		io::print("total circular torus:", _circular_torus.transforms_buffer.get_count());
-		io::print("total cone:", _cone.transforms_buffer.get_count());
-		io::print("total cone offset:", _cone_offset.transforms_buffer.get_count());
-		io::print("total cylinder:", _cylinder.transforms_buffer.get_count());
-		io::print("total cylinder offset:", _cylinder_offset.transforms_buffer.get_count());
-		io::print("total cylinder slope:", _cylinder_slope.transforms_buffer.get_count());
-		io::print("total dish:", _dish.transforms_buffer.get_count());
-		io::print("total pyramid:", _pyramid.transforms_buffer.get_count());
-		io::print("total rectangular torus:", _rectangular_torus.transforms_buffer.get_count());
-		io::print("total sphere:", _sphere.transforms_buffer.get_count());
-	}
-
-	bool parametric_instance_renderer::initialize(glb::framebuffer& fbuffer, glb::camera& cam)
-	{
-		// create base meshes
-		cad::ParametricBuilder paramBuilder;
-		paramBuilder.setMinimumResolutionFlat(16);
-		paramBuilder.setMinimumResolutionSmooth(16, 8);
-
-		_flat_vao = paramBuilder.createFlatVAO(1, &_draw_flat_with_caps, &_draw_flat_no_caps);
-
-		if(_flat_vao == 0)
+		if(!_prepared)
 		{
-			return false;
+			prepare_upload();
 		}
 
-		_smooth_vao = paramBuilder.createSmoothVAO(1, &_draw_smooth_with_caps, &_draw_smooth_no_caps);
+		// upload pool and create one view per type
+		glGenBuffers(1, &_pool_buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, _pool_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, _records.size(), _records.data(), GL_STATIC_DRAW);
 
-		if(_smooth_vao == 0)
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
 		{
-			return false;
+			auto& d = _drawables[type];
+			if(d.count > 0)
+			{
+				glGenTextures(1, &d.texture);
+				glBindTexture(GL_TEXTURE_BUFFER, d.texture);
+				glTexBufferRange(GL_TEXTURE_BUFFER, PRIMITIVES[type].format, _pool_buffer, d.byte_offset, d.count * PRIMITIVES[type].stride);
+			}
 		}
 
-		int transform_texture_unit = 0;
-		glb::shader_program_builder shader_builder;
-		auto rc = make_random(0.0f, 0.7f);
-
-		// box ---------------------------------------------------------------------------------------------------------
+		// compacted per-level records are streamed to their own buffer every frame
+		glGenBuffers(1, &_frame_buffer);
+		glGenTextures(1, &_frame_texture);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/box.vert"))
+		io::print("-- memory parametric:", (double)_records.size() / 1024.0 / 1024.0, "MB");
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
 		{
-			return false;
+			io::print(string("total ") + PRIMITIVES[type].name + ":", _drawables[type].count);
 		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_box.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(transformation)))
-		{
-			return false;
-		}
-		if(!_box.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
-		{
-			return false;
-		}
-		_box.transforms_texture.set_data_source(glb::internal_format_rgb32f, _box.transforms_buffer);
-		_box.shader = shader_builder.get_shader_program();
-		_box.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_box.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_box.color = {rc(), rc(), rc()};
-
-		// circular torus ----------------------------------------------------------------------------------------------
+	}
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/circularTorus.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
+	void parametric_instance_renderer::prepare_upload()
+	{
+		// regroup records by type, each type starts at an offset a buffer texture can view
+		unsigned int size = 0;
+		for(auto& d : _drawables)
 		{
-			return false;
+			d.count = 0;
 		}
-		if(!_circular_torus.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(circular_torus_data)))
+		for(const auto& instance : _instances)
 		{
-			return false;
+			++_drawables[instance.type].count;
 		}
-		if(!_circular_torus.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
 		{
-			return false;
+			auto& d = _drawables[type];
+			size = _align(size);
+			d.byte_offset = size;
+			size += d.count * PRIMITIVES[type].stride;
 		}
-		_circular_torus.transforms_texture.set_data_source(glb::internal_format_rgba32f, _circular_torus.transforms_buffer);
-		_circular_torus.shader = shader_builder.get_shader_program();
-		_circular_torus.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_circular_torus.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_circular_torus.color = {rc(), rc(), rc()};
-
-		// cone --------------------------------------------------------------------------------------------------------
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/cone.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_cone.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(cone_data)))
+		unsigned int next[PRIMITIVE_TYPES];
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
 		{
-			return false;
-		}
-		if(!_cone.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
-		{
-			return false;
+			next[type] = _drawables[type].byte_offset;
 		}
-		_cone.transforms_texture.set_data_source(glb::internal_format_rgba32f, _cone.transforms_buffer);
-		_cone.shader = shader_builder.get_shader_program();
-		_cone.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_cone.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_cone.color = {rc(), rc(), rc()};
 
-		// cone offset -------------------------------------------------------------------------------------------------
-
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/coneOffset.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
+		vector<char> records(size);
+		for(auto& instance : _instances)
 		{
-			return false;
+			const auto stride = PRIMITIVES[instance.type].stride;
+			std::copy(_records.begin() + instance.record_offset, _records.begin() + instance.record_offset + stride, records.begin() + next[instance.type]);
+			instance.record_offset = next[instance.type];
+			next[instance.type] += stride;
 		}
-		if(!_cone_offset.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(cone_offset_data)))
-		{
-			return false;
-		}
-		if(!_cone_offset.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
-		{
-			return false;
-		}
-		_cone_offset.transforms_texture.set_data_source(glb::internal_format_rgba32f, _cone_offset.transforms_buffer);
-		_cone_offset.shader = shader_builder.get_shader_program();
-		_cone_offset.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_cone_offset.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_cone_offset.color = {rc(), rc(), rc()};
-
-		// cylinder ----------------------------------------------------------------------------------------------------
+		_records.swap(records);
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/cylinder.vert"))
+		_bounds.clear();
+		_bounds.reserve(_instances.size());
+		for(const auto& instance : _instances)
 		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
+			_bounds.push_back(instance.bounds);
 		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_cylinder.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 2000000 * sizeof(transformation)))
-		{
-			return false;
-		}
-		if(!_cylinder.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
-		{
-			return false;
-		}
-		_cylinder.transforms_texture.set_data_source(glb::internal_format_rgb32f, _cylinder.transforms_buffer);
-		_cylinder.shader = shader_builder.get_shader_program();
-		_cylinder.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_cylinder.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_cylinder.color = {rc(), rc(), rc()};
-
-		// cylinder offset ---------------------------------------------------------------------------------------------
+		_bvh.build(_bounds);
+		_dirty_records.resize(_records.size());
+		_prepared = true;
+	}
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/cylinderOffset.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_cylinder_offset.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(cylinder_offset_data)))
-		{
-			return false;
-		}
-		if(!_cylinder_offset.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
-		{
-			return false;
-		}
-		_cylinder_offset.transforms_texture.set_data_source(glb::internal_format_rgba32f, _cylinder_offset.transforms_buffer);
-		_cylinder_offset.shader = shader_builder.get_shader_program();
-		_cylinder_offset.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_cylinder_offset.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_cylinder_offset.color = {rc(), rc(), rc()};
+	bool parametric_instance_renderer::initialize(glb::framebuffer& fbuffer, glb::camera& cam)
+	{
+		// create base meshes
+		cad::ParametricBuilder paramBuilder;
+		paramBuilder.setMinimumResolutionFlat(MIN_RESOLUTION_FLAT);
+		paramBuilder.setMinimumResolutionSmooth(MIN_RESOLUTION_SMOOTH_X, MIN_RESOLUTION_SMOOTH_Y);
 
-		// cylinder slope ---------------------------------------------------------------------------------------------
+		_flat_vao = paramBuilder.createFlatVAO(PARAMETRIC_LODS, _draw_flat_with_caps, _draw_flat_no_caps);
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/cylinderSlope.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_cylinder_slope.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(cylinder_slope_data)))
-		{
-			return false;
-		}
-		if(!_cylinder_slope.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
+		if(_flat_vao == 0)
 		{
 			return false;
 		}
-		_cylinder_slope.transforms_texture.set_data_source(glb::internal_format_rgba32f, _cylinder_slope.transforms_buffer);
-		_cylinder_slope.shader = shader_builder.get_shader_program();
-		_cylinder_slope.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_cylinder_slope.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_cylinder_slope.color = {rc(), rc(), rc()};
 
-		// dish --------------------------------------------------------------------------------------------------------
+		_smooth_vao = paramBuilder.createSmoothVAO(PARAMETRIC_LODS, _draw_smooth_with_caps, _draw_smooth_no_caps);
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/dish.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_dish.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(transformation)))
-		{
-			return false;
-		}
-		if(!_dish.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
+		if(_smooth_vao == 0)
 		{
 			return false;
 		}
-		_dish.transforms_texture.set_data_source(glb::internal_format_rgb32f, _dish.transforms_buffer);
-		_dish.shader = shader_builder.get_shader_program();
-		_dish.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_dish.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_dish.color = {rc(), rc(), rc()};
 
-		// pyramid------- ----------------------------------------------------------------------------------------------
-
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/pyramid.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
+		// flat and smooth levels have the same number of segments around
+		for(int l = 0; l < PARAMETRIC_LODS; ++l)
 		{
-			return false;
+			const auto segments = MIN_RESOLUTION_SMOOTH_X << (PARAMETRIC_LODS - 1 - l);
+			_lod_errors[l] = 1.0f - std::cos(math::to_radians(180.0f) / segments);
 		}
-		if(!_pyramid.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(pyramid_data)))
-		{
-			return false;
-		}
-		if(!_pyramid.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
-		{
-			return false;
-		}
-		_pyramid.transforms_texture.set_data_source(glb::internal_format_rgba32f, _pyramid.transforms_buffer);
-		_pyramid.shader = shader_builder.get_shader_program();
-		_pyramid.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_pyramid.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_pyramid.color = {rc(), rc(), rc()};
 
-		// rectangular torus -------------------------------------------------------------------------------------------
+		int alignment = 1;
+		glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		_texture_alignment = math::max(alignment, 1);
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/rectangularTorus.vert"))
-		{
-			return false;
-		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_rectangular_torus.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(rectangular_torus_data)))
-		{
-			return false;
-		}
-		if(!_rectangular_torus.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
-		{
-			return false;
-		}
-		_rectangular_torus.transforms_texture.set_data_source(glb::internal_format_rgba32f, _rectangular_torus.transforms_buffer);
-		_rectangular_torus.shader = shader_builder.get_shader_program();
-		_rectangular_torus.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_rectangular_torus.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_rectangular_torus.color = {rc(), rc(), rc()};
-
-		// sphere ------------------------------------------------------------------------------------------------------
+		glb::shader_program_builder shader_builder;
+		auto rc = make_random(0.0f, 0.7f);
 
-		shader_builder.begin();
-		if(!shader_builder.add_file(glb::shader_vertex, "../shaders/environ/sphere.vert"))
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
 		{
-			return false;
+			auto& d = _drawables[type];
+			if(!build_program(shader_builder, PRIMITIVES[type].vertex_shader, render_pass_color, fbuffer, cam, d.shader))
+			{
+				return false;
+			}
+			if(!build_program(shader_builder, PRIMITIVES[type].vertex_shader, render_pass_depth, fbuffer, cam, d.depth_shader))
+			{
+				return false;
+			}
+			if(!build_program(shader_builder, PRIMITIVES[type].vertex_shader, render_pass_visibility, fbuffer, cam, d.visibility_shader))
+			{
+				return false;
+			}
+			d.visibility_shader.set_uniform("object_id", static_cast<int>(VISIBILITY_PARAMETRIC_TYPE | type));
+			if(!build_program(shader_builder, PRIMITIVES[type].vertex_shader, render_pass_wireframe, fbuffer, cam, d.wireframe_shader))
+			{
+				return false;
+			}
+			d.color = {rc(), rc(), rc()};
 		}
-		if(!shader_builder.add_file(glb::shader_fragment, "../shaders/per_pixel_lighting_color.frag"))
-		{
-			return false;
-		}
-		shader_builder.bind_vertex_attrib("in_position", 0);
-		shader_builder.bind_vertex_attrib("in_color", 7);
-		shader_builder.bind_draw_buffer("out_color", fbuffer.get_color_buffer_to_display());
-		if(!shader_builder.end())
-		{
-			return false;
-		}
-		if(!_sphere.transforms_buffer.create(glb::target_texture_buffer, glb::usage_static_draw, 1000000 * sizeof(transformation)))
+
+		// small features are streamed as world space points
+		if(!build_program(shader_builder, "../shaders/parametric_point.vert", render_pass_color, fbuffer, cam, _point_shader))
 		{
 			return false;
 		}
-		if(!_sphere.transforms_texture.create(transform_texture_unit, glb::target_texture_buffer))
+		if(!build_program(shader_builder, "../shaders/parametric_point.vert", render_pass_visibility, fbuffer, cam, _point_visibility_shader))
 		{
 			return false;
 		}
-		_sphere.transforms_texture.set_data_source(glb::internal_format_rgb32f, _sphere.transforms_buffer);
-		_sphere.shader = shader_builder.get_shader_program();
-		_sphere.shader.bind_uniform_buffer("camera_uniform_block", cam.get_uniform_buffer());
-		_sphere.shader.set_uniform("tex_transforms", transform_texture_unit);
-		_sphere.color = {rc(), rc(), rc()};
+
+		glGenVertexArrays(1, &_point_vao);
+		glBindVertexArray(_point_vao);
+		glGenBuffers(1, &_point_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, _point_buffer);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), GLB_BYTE_OFFSET(0));
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		return true;
 	}
@@ -549,124 +484,414 @@ namespace app
 
 	void parametric_instance_renderer::render()
 	{
-		// flats -------------------------------------------------------------------------------------------------------
-
-		glBindVertexArray(_flat_vao);
-
-		_box.shader.bind();
-		_box.transforms_texture.bind();
-		glVertexAttrib3fv(7, _box.color.data());
-		glDrawElementsInstanced(_draw_flat_with_caps.mode, _draw_flat_with_caps.count, _draw_flat_with_caps.type, GLB_BYTE_OFFSET(_draw_flat_with_caps.elemOffsetBytes), _box.transforms_buffer.get_count());
-
-		_pyramid.shader.bind();
-		_pyramid.transforms_texture.bind();
-		glVertexAttrib3fv(7, _pyramid.color.data());
-		glDrawElementsInstanced(_draw_flat_with_caps.mode, _draw_flat_with_caps.count, _draw_flat_with_caps.type, GLB_BYTE_OFFSET(_draw_flat_with_caps.elemOffsetBytes), _pyramid.transforms_buffer.get_count());
-
-		_rectangular_torus.shader.bind();
-		_rectangular_torus.transforms_texture.bind();
-		glVertexAttrib3fv(7, _rectangular_torus.color.data());
-		glDrawElementsInstanced(_draw_flat_no_caps.mode, _draw_flat_no_caps.count, _draw_flat_no_caps.type, GLB_BYTE_OFFSET(_draw_flat_no_caps.elemOffsetBytes), _rectangular_torus.transforms_buffer.get_count());
+		_render(true);
+	}
 
-		// smooths -----------------------------------------------------------------------------------------------------
+	void parametric_instance_renderer::set_view(const frustum& f)
+	{
+		_frustum = f;
+		_compacted = false;
+	}
 
-		glBindVertexArray(_smooth_vao);
+	void parametric_instance_renderer::set_transform(instance_handle handle, const mat4& transform)
+	{
+		if(handle >= _instances.size())
+		{
+			return;
+		}
 
-		_circular_torus.shader.bind();
-		_circular_torus.transforms_texture.bind();
-		glVertexAttrib3fv(7, _circular_torus.color.data());
-		glDrawArraysInstanced(_draw_smooth_no_caps.mode, _draw_smooth_no_caps.first, _draw_smooth_no_caps.count, _circular_torus.transforms_buffer.get_count());
+		auto& instance = _instances[handle];
+		auto t = transformation(transform);
+		t.scale *= instance.shape_scale;
+		write_transformation(_records.data() + instance.record_offset, instance.type, t);
+		_dirty_records.mark(instance.record_offset, PRIMITIVES[instance.type].stride);
 
-		_cone.shader.bind();
-		_cone.transforms_texture.bind();
-		glVertexAttrib3fv(7, _cone.color.data());
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cone.transforms_buffer.get_count());
+		instance.bounds.center = transform.get_translation();
+		instance.bounds.radius = instance.radius * mat34(transform).max_scale();
+		_moved_instances.push_back(handle);
 
-		_cone_offset.shader.bind();
-		_cone_offset.transforms_texture.bind();
-		glVertexAttrib3fv(7, _cone_offset.color.data());
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cone_offset.transforms_buffer.get_count());
+		if(instance.occluder >= 0)
+		{
+			auto& occluder = _box_occluders[instance.occluder];
+			occluder.transform = mat34(transform);
+			for(int r = 0; r < 3; ++r)
+			{
+				occluder.transform.data[r*4 + 0] *= instance.shape_scale.x;
+				occluder.transform.data[r*4 + 1] *= instance.shape_scale.y;
+				occluder.transform.data[r*4 + 2] *= instance.shape_scale.z;
+			}
+		}
+	}
 
-		_cylinder.shader.bind();
-		_cylinder.transforms_texture.bind();
-		glVertexAttrib3fv(7, _cylinder.color.data());
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cylinder.transforms_buffer.get_count());
+	void parametric_instance_renderer::render_color(const vec3& color)
+	{
+		glVertexAttrib3fv(COLOR_ATTRIB, color.data());
+		_render(false);
+	}
 
-		_cylinder_offset.shader.bind();
-		_cylinder_offset.transforms_texture.bind();
-		glVertexAttrib3fv(7, _cylinder_offset.color.data());
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cylinder_offset.transforms_buffer.get_count());
+	void parametric_instance_renderer::render_depth()
+	{
+		_pass = render_pass_depth;
+		_render(false);
+		_pass = render_pass_color;
+	}
 
-		_cylinder_slope.shader.bind();
-		_cylinder_slope.transforms_texture.bind();
-		glVertexAttrib3fv(7, _cylinder_slope.color.data());
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cylinder_slope.transforms_buffer.get_count());
+	void parametric_instance_renderer::render_visibility()
+	{
+		_pass = render_pass_visibility;
+		_render(false);
+		_pass = render_pass_color;
+	}
 
-		_dish.shader.bind();
-		_dish.transforms_texture.bind();
-		glVertexAttrib3fv(7, _dish.color.data());
-		glDrawArraysInstanced(_draw_smooth_no_caps.mode, _draw_smooth_no_caps.first, _draw_smooth_no_caps.count, _dish.transforms_buffer.get_count());
+	void parametric_instance_renderer::render_wireframe()
+	{
+		_pass = render_pass_wireframe;
+		_render(true);
+		_pass = render_pass_color;
+	}
 
-		_sphere.shader.bind();
-		_sphere.transforms_texture.bind();
-		glVertexAttrib3fv(7, _sphere.color.data());
-		glDrawArraysInstanced(_draw_smooth_no_caps.mode, _draw_smooth_no_caps.first, _draw_smooth_no_caps.count, _sphere.transforms_buffer.get_count());
+	void parametric_instance_renderer::set_feature_edges(bool enabled)
+	{
+		_feature_edges = enabled;
+		for(auto& d : _drawables)
+		{
+			d.wireframe_shader.set_uniform("feature_edges", enabled ? 1 : 0);
+		}
 	}
 
-	void parametric_instance_renderer::render_color(const vec3& color)
+	unsigned int parametric_instance_renderer::count_visible_instances(const frustum& f) const
 	{
-		glVertexAttrib3fv(7, color.data());
+		vector<unsigned int> visible;
+		return _bvh.cull(f, visible);
+	}
 
-		// flats -------------------------------------------------------------------------------------------------------
+	void parametric_instance_renderer::add_occluders(occlusion_buffer& buffer) const
+	{
+		// largest boxes on screen first
+		vector<std::pair<float, unsigned int>> candidates;
+		for(unsigned int i = 0; i < _box_occluders.size(); ++i)
+		{
+			const auto& b = _instances[_box_occluders[i].instance].bounds;
+			if(_frustum.is_sphere_outside(b.center, b.radius))
+			{
+				continue;
+			}
+			const auto pixels = _frustum.projected_radius(b.center, b.radius);
+			if(pixels >= OCCLUDER_MIN_PIXELS)
+			{
+				candidates.emplace_back(pixels, i);
+			}
+		}
 
-		glBindVertexArray(_flat_vao);
+		const auto count = math::min(static_cast<unsigned int>(candidates.size()), MAX_OCCLUDERS);
+		std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), std::greater<std::pair<float, unsigned int>>());
 
-		_box.shader.bind();
-		_box.transforms_texture.bind();
-		glDrawElementsInstanced(_draw_flat_with_caps.mode, _draw_flat_with_caps.count, _draw_flat_with_caps.type, GLB_BYTE_OFFSET(_draw_flat_with_caps.elemOffsetBytes), _box.transforms_buffer.get_count());
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			buffer.rasterize_box(_box_occluders[candidates[i].second].transform);
+		}
+	}
 
-		_pyramid.shader.bind();
-		_pyramid.transforms_texture.bind();
-		glDrawElementsInstanced(_draw_flat_with_caps.mode, _draw_flat_with_caps.count, _draw_flat_with_caps.type, GLB_BYTE_OFFSET(_draw_flat_with_caps.elemOffsetBytes), _pyramid.transforms_buffer.get_count());
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 
-		_rectangular_torus.shader.bind();
-		_rectangular_torus.transforms_texture.bind();
-		glDrawElementsInstanced(_draw_flat_no_caps.mode, _draw_flat_no_caps.count, _draw_flat_no_caps.type, GLB_BYTE_OFFSET(_draw_flat_no_caps.elemOffsetBytes), _rectangular_torus.transforms_buffer.get_count());
+	void parametric_instance_renderer::_render(bool use_colors)
+	{
+		_vertex_count = 0;
+		_upload_dirty_records();
 
-		// smooths -----------------------------------------------------------------------------------------------------
+		const auto filtering = _is_filtering_instances();
+		const bool compacted = _lod_selection || filtering;
+		if(compacted && !_compacted)
+		{
+			_compact_instances();
+			_compacted = true;
+		}
 
-		glBindVertexArray(_smooth_vao);
+		bool flat = true;
+		glBindVertexArray(_flat_vao);
+		glActiveTexture(GL_TEXTURE0 + TRANSFORM_TEXTURE_UNIT);
+
+		for(int i = 0; i < PRIMITIVE_TYPES; ++i)
+		{
+			const auto type = static_cast<primitive_type>(i);
+			auto& d = _drawables[type];
+			if(d.count == 0)
+			{
+				continue;
+			}
+
+			if(PRIMITIVES[type].flat != flat)
+			{
+				flat = PRIMITIVES[type].flat;
+				glBindVertexArray(flat ? _flat_vao : _smooth_vao);
+			}
+
+			glb::shader_program* programs[] = {&d.shader, &d.depth_shader, &d.visibility_shader, &d.wireframe_shader};
+			programs[_pass]->bind();
+			if(use_colors)
+			{
+				glVertexAttrib3fv(COLOR_ATTRIB, d.color.data());
+			}
+
+			if(!compacted || (!filtering && !has_lods(type)))
+			{
+				glBindTexture(GL_TEXTURE_BUFFER, d.texture);
+				_draw(type, 0, d.count);
+				continue;
+			}
+
+			// each level views its compacted records in the frame buffer
+			glBindTexture(GL_TEXTURE_BUFFER, _frame_texture);
+			for(int l = 0; l < PARAMETRIC_LODS; ++l)
+			{
+				const auto& range = _lod_ranges[type * PARAMETRIC_LODS + l];
+				if(range.count > 0)
+				{
+					glTexBufferRange(GL_TEXTURE_BUFFER, PRIMITIVES[type].format, _frame_buffer, range.byte_offset, range.count * PRIMITIVES[type].stride);
+					_draw(type, l, range.count);
+				}
+			}
+		}
+
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		// no points in the depth pre-pass
+		if(_small_feature_mode == small_feature_point && _pass != render_pass_depth)
+		{
+			_draw_points(use_colors);
+		}
+	}
 
-		_circular_torus.shader.bind();
-		_circular_torus.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_no_caps.mode, _draw_smooth_no_caps.first, _draw_smooth_no_caps.count, _circular_torus.transforms_buffer.get_count());
+	void parametric_instance_renderer::_upload_dirty_records()
+	{
+		// 1. bounds of moved instances
+		if(!_moved_instances.empty())
+		{
+			for(auto i : _moved_instances)
+			{
+				if(i < _bounds.size())
+				{
+					_bounds[i] = _instances[i].bounds;
+				}
+			}
+			_bvh.refit(_bounds, _moved_instances);
+			_moved_instances.clear();
+			_compacted = false;
+		}
 
-		_cone.shader.bind();
-		_cone.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cone.transforms_buffer.get_count());
+		// 2. consecutive dirty pages of the pool go up as one range, compacted records are gathered from the CPU copy
+		_dirty_ranges.clear();
+		_dirty_records.take_ranges(_dirty_ranges);
+		if(_dirty_ranges.empty())
+		{
+			return;
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, _pool_buffer);
+		for(const auto& r : _dirty_ranges)
+		{
+			glBufferSubData(GL_TEXTURE_BUFFER, r.offset, r.size, _records.data() + r.offset);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
 
-		_cone_offset.shader.bind();
-		_cone_offset.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cone_offset.transforms_buffer.get_count());
+	void parametric_instance_renderer::_compact_instances()
+	{
+		for(auto& bucket : _lod_buckets)
+		{
+			bucket.clear();
+		}
+		for(auto& bucket : _point_buckets)
+		{
+			bucket.clear();
+		}
+
+		// 1. one pass over the visible part of the pool for all types
+		const auto culling = _is_culling_instances();
+		_culled_instances = 0;
+		_occluded_instances = 0;
+		_small_instances = 0;
+		_saved_vertices = 0;
+		if(culling)
+		{
+			_visible.clear();
+			_bvh.cull(_frustum, _visible);
+			_culled_instances = _instances.size() - _visible.size();
+
+			if(_occlusion)
+			{
+				const auto in_frustum = _visible.size();
+				_visible.erase(std::remove_if(_visible.begin(), _visible.end(), [this](unsigned int i)
+				{
+					const auto& b = _instances[i].bounds;
+					return !_occlusion->is_sphere_visible(b.center, b.radius);
+				}), _visible.end());
+				_occluded_instances = in_frustum - _visible.size();
+			}
+		}
+
+		const auto filtering = _is_filtering_instances();
+
+		// nearest first, buckets keep the order
+		if(_front_to_back)
+		{
+			const auto& eye = _frustum.get_eye();
+			const auto order_count = culling ? _visible.size() : _instances.size();
+			_instance_order.resize(order_count);
+			for(unsigned int k = 0; k < order_count; ++k)
+			{
+				const auto i = culling ? _visible[k] : k;
+				const auto d = _instances[i].bounds.center - eye;
+				_instance_order[k] = std::make_pair(d.x*d.x + d.y*d.y + d.z*d.z, i);
+			}
+			std::sort(_instance_order.begin(), _instance_order.end());
+		}
+
+		const auto count = culling ? _visible.size() : _instances.size();
+		for(unsigned int k = 0; k < count; ++k)
+		{
+			const auto& instance = _instances[_front_to_back ? _instance_order[k].second : (culling ? _visible[k] : k)];
+
+			// capped flats are drawn straight from the pool when nothing is filtered
+			if(!filtering && !has_lods(instance.type))
+			{
+				continue;
+			}
+
+			// coarsest level whose chord error stays under the pixel threshold
+			int lod = 0;
+			const auto pixels = _frustum.projected_radius(instance.bounds.center, instance.bounds.radius);
+			if(_lod_selection && has_lods(instance.type))
+			{
+				lod = PARAMETRIC_LODS - 1;
+				while(lod > 0 && _lod_errors[lod] * pixels > LOD_PIXEL_ERROR)
+				{
+					--lod;
+				}
+			}
+
+			// small features are dropped or reduced to their center
+			if(_small_feature_mode != small_feature_draw && pixels < _small_feature_pixels)
+			{
+				++_small_instances;
+				_saved_vertices += _count_vertices(instance.type, lod);
+				if(_small_feature_mode == small_feature_point)
+				{
+					_point_buckets[instance.type].push_back(instance.bounds.center);
+				}
+				continue;
+			}
+
+			_lod_buckets[instance.type * PARAMETRIC_LODS + lod].push_back(instance.record_offset);
+		}
+
+		// 2. gather records of each type and level into one buffer
+		_frame_records.clear();
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
+		{
+			const auto stride = PRIMITIVES[type].stride;
+			for(int l = 0; l < PARAMETRIC_LODS; ++l)
+			{
+				const auto& bucket = _lod_buckets[type * PARAMETRIC_LODS + l];
+				auto& range = _lod_ranges[type * PARAMETRIC_LODS + l];
+				range.byte_offset = _align(_frame_records.size());
+				range.count = bucket.size();
+
+				_frame_records.resize(range.byte_offset + range.count * stride);
+				auto output = _frame_records.begin() + range.byte_offset;
+				for(auto offset : bucket)
+				{
+					output = std::copy(_records.begin() + offset, _records.begin() + offset + stride, output);
+				}
+			}
+		}
+
+		// 3. single upload, orphaning last frame's records
+		glBindBuffer(GL_TEXTURE_BUFFER, _frame_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, _frame_records.size(), _frame_records.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		// 4. points of each type follow each other
+		_point_positions.clear();
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
+		{
+			_point_offsets[type] = _point_positions.size();
+			_point_positions.insert(_point_positions.end(), _point_buckets[type].begin(), _point_buckets[type].end());
+		}
+		_point_offsets[PRIMITIVE_TYPES] = _point_positions.size();
+
+		if(!_point_positions.empty())
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, _point_buffer);
+			glBufferData(GL_ARRAY_BUFFER, _point_positions.size() * sizeof(vec3), _point_positions.data(), GL_STREAM_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+	}
 
-		_cylinder.shader.bind();
-		_cylinder.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cylinder.transforms_buffer.get_count());
+	bool parametric_instance_renderer::_is_filtering_instances() const
+	{
+		// capped flats without levels are only compacted when the visible set or its order changes
+		return _is_culling_instances() || _small_feature_mode != small_feature_draw || _front_to_back;
+	}
 
-		_cylinder_offset.shader.bind();
-		_cylinder_offset.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cylinder_offset.transforms_buffer.get_count());
+	void parametric_instance_renderer::_draw(primitive_type type, int lod, unsigned int instance_count)
+	{
+		if(PRIMITIVES[type].flat)
+		{
+			const auto& draw = PRIMITIVES[type].caps ? _draw_flat_with_caps[lod] : _draw_flat_no_caps[lod];
+			glDrawElementsInstanced(draw.mode, draw.count, draw.type, GLB_BYTE_OFFSET(draw.elemOffsetBytes), instance_count);
+		}
+		else
+		{
+			const auto& draw = PRIMITIVES[type].caps ? _draw_smooth_with_caps[lod] : _draw_smooth_no_caps[lod];
+			glDrawArraysInstanced(draw.mode, draw.first, draw.count, instance_count);
+		}
+		_vertex_count += _count_vertices(type, lod) * instance_count;
+	}
 
-		_cylinder_slope.shader.bind();
-		_cylinder_slope.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_with_caps.mode, _draw_smooth_with_caps.first, _draw_smooth_with_caps.count, _cylinder_slope.transforms_buffer.get_count());
+	void parametric_instance_renderer::_draw_points(bool use_colors)
+	{
+		if(_point_positions.empty())
+		{
+			return;
+		}
+
+		const auto visibility = _pass == render_pass_visibility;
+		(visibility ? _point_visibility_shader : _point_shader).bind();
+		glBindVertexArray(_point_vao);
+		for(int type = 0; type < PRIMITIVE_TYPES; ++type)
+		{
+			const auto count = _point_offsets[type + 1] - _point_offsets[type];
+			if(count == 0)
+			{
+				continue;
+			}
+			if(use_colors)
+			{
+				glVertexAttrib3fv(COLOR_ATTRIB, _drawables[type].color.data());
+			}
+			if(visibility)
+			{
+				_point_visibility_shader.set_uniform("object_id", static_cast<int>(VISIBILITY_PARAMETRIC_TYPE | type));
+			}
+			glDrawArrays(GL_POINTS, _point_offsets[type], count);
+			_vertex_count += count;
+		}
+		glBindVertexArray(0);
+	}
 
-		_dish.shader.bind();
-		_dish.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_no_caps.mode, _draw_smooth_no_caps.first, _draw_smooth_no_caps.count, _dish.transforms_buffer.get_count());
+	unsigned int parametric_instance_renderer::_count_vertices(primitive_type type, int lod) const
+	{
+		if(PRIMITIVES[type].flat)
+		{
+			return (PRIMITIVES[type].caps ? _draw_flat_with_caps[lod] : _draw_flat_no_caps[lod]).count;
+		}
+		return (PRIMITIVES[type].caps ? _draw_smooth_with_caps[lod] : _draw_smooth_no_caps[lod]).count;
+	}
 
-		_sphere.shader.bind();
-		_sphere.transforms_texture.bind();
-		glDrawArraysInstanced(_draw_smooth_no_caps.mode, _draw_smooth_no_caps.first, _draw_smooth_no_caps.count, _sphere.transforms_buffer.get_count());
+	unsigned int parametric_instance_renderer::_align(unsigned int byte_offset) const
+	{
+		return (byte_offset + _texture_alignment - 1) / _texture_alignment * _texture_alignment;
 	}
 } // namespace app
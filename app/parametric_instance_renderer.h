@@ -1,5 +1,8 @@
 #pragma once
 #include <app/base_renderer.h>
+#include <app/bvh.h>
+#include <app/occlusion_buffer.h>
+#include <app/dirty_pages.h>
 #include <app/transformation.h>
 #include <glb/shader_program.h>
 #include <glb/vertex_array_builder.h>
@@ -8,107 +11,242 @@
 
 namespace app
 {
+	// base mesh levels, 0 is the finest and each level halves the resolution of the previous one
+	static const int PARAMETRIC_LODS = 3;
+
+	// type tag of a parametric instance, flat primitives first
+	enum primitive_type
+	{
+		primitive_box,
+		primitive_pyramid,
+		primitive_rectangular_torus,
+		primitive_circular_torus,
+		primitive_cone,
+		primitive_cone_offset,
+		primitive_cylinder,
+		primitive_cylinder_offset,
+		primitive_cylinder_slope,
+		primitive_dish,
+		primitive_sphere,
+		PRIMITIVE_TYPES
+	};
+
 	class parametric_instance_renderer : public app::base_renderer
 	{
 	public:
-		virtual void add_box(const box& b, const mat4& transform) override;
-		virtual void add_circular_torus(const circular_torus& c, const mat4& transform) override;
-		virtual void add_cone(const cone& c, const mat4& transform) override;
-		virtual void add_cone_offset(const cone_offset& c, const mat4& transform) override;
-		virtual void add_cylinder(const cylinder& c, const mat4& transform) override;
-		virtual void add_cylinder_offset(const cylinder_offset& c, const mat4& transform) override;
-		virtual void add_cylinder_slope(const cylinder_slope& c, const mat4& transform) override;
-		virtual void add_dish(const dish& d, const mat4& transform) override;
-		virtual void add_pyramid(const pyramid& p, const mat4& transform) override;
-		virtual void add_rectangular_torus(const rectangular_torus& rt, const mat4& transform) override;
-		virtual void add_sphere(const sphere& s, const mat4& transform) override;
+		virtual instance_handle add_box(const box& b, const mat4& transform) override;
+		virtual instance_handle add_circular_torus(const circular_torus& c, const mat4& transform) override;
+		virtual instance_handle add_cone(const cone& c, const mat4& transform) override;
+		virtual instance_handle add_cone_offset(const cone_offset& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder(const cylinder& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder_offset(const cylinder_offset& c, const mat4& transform) override;
+		virtual instance_handle add_cylinder_slope(const cylinder_slope& c, const mat4& transform) override;
+		virtual instance_handle add_dish(const dish& d, const mat4& transform) override;
+		virtual instance_handle add_pyramid(const pyramid& p, const mat4& transform) override;
+		virtual instance_handle add_rectangular_torus(const rectangular_torus& rt, const mat4& transform) override;
+		virtual instance_handle add_sphere(const sphere& s, const mat4& transform) override;
 		virtual void end_upload() override;
 
+		// the CPU half of end_upload: groups the records by type and builds the culling hierarchy without touching OpenGL,
+		// end_upload calls it when it was not and count_visible_instances works after it alone
+		void prepare_upload();
+
 		virtual bool initialize(glb::framebuffer& fbuffer, glb::camera& cam) override;
 		virtual bool finalize() override;
 		virtual void render() override;
+		virtual void set_view(const frustum& f) override;
+
+		// rewrites the transform part of the record in place, uploaded with culling bounds refitted by the next render call
+		// primitives are colored by type by vertex programs outside this tree, so set_color is deliberately left out and
+		// per-instance colors apply to meshes only
+		virtual void set_transform(instance_handle handle, const mat4& transform) override;
 
 		void render_color(const vec3& color);
 
+		// same draws as render with depth-only programs, for a pre-pass
+		void render_depth();
+
+		// same draws as render writing the primitive type and primitive ids
+		void render_visibility();
+
+		// same draws as render with triangle edges blended over the shading in a single pass
+		void render_wireframe();
+
+		// primitives have no precomputed creases, feature edges outline the quads of their tessellation
+		void set_feature_edges(bool enabled);
+		bool get_feature_edges() const { return _feature_edges; }
+
+		const vec3& get_type_color(primitive_type type) const { return _drawables[type].color; }
+
+		void set_lod_selection(bool enabled) { _lod_selection = enabled; }
+		bool get_lod_selection() const { return _lod_selection; }
+		void set_instance_culling(bool enabled) { _instance_culling = enabled; }
+		bool get_instance_culling() const { return _instance_culling; }
+		// visible instances of each type and level are drawn nearest first
+		void set_front_to_back(bool enabled) { _front_to_back = enabled; }
+		bool get_front_to_back() const { return _front_to_back; }
+
+		void set_small_feature_mode(small_feature_mode mode) { _small_feature_mode = mode; }
+		small_feature_mode get_small_feature_mode() const { return _small_feature_mode; }
+
+		// projected radius in pixels below which an instance is a small feature
+		void set_small_feature_pixels(float pixels) { _small_feature_pixels = pixels; }
+		float get_small_feature_pixels() const { return _small_feature_pixels; }
+
+		// visible instances are also tested against the buffer, nullptr disables occlusion culling
+		void set_occlusion_buffer(const occlusion_buffer* buffer) { _occlusion = buffer; }
+
+		// rasterizes the largest boxes in view, call after set_view
+		void add_occluders(occlusion_buffer& buffer) const;
+
+		// CPU-only instance culling pass for the given camera, does not touch OpenGL and works after prepare_upload
+		unsigned int count_visible_instances(const frustum& f) const;
+
+		// instances culled by the last render call
+		unsigned int get_culled_instance_count() const { return _culled_instances; }
+		unsigned int get_occluded_instance_count() const { return _occluded_instances; }
+
+		// small features of the last render call and the vertices they would have cost at their level
+		unsigned int get_small_instance_count() const { return _small_instances; }
+		unsigned int get_saved_vertex_count() const { return _saved_vertices; }
+
+		// vertices submitted by the last render call
+		unsigned int get_vertex_count() const { return _vertex_count; }
+
 	private:
+		// program and pool range of one primitive type
 		struct drawable
 		{
 			glb::shader_program shader;
-			glb::buffer transforms_buffer;
-			glb::texture transforms_texture;
+			glb::shader_program depth_shader;
+			glb::shader_program visibility_shader;
+			glb::shader_program wireframe_shader;
 			vec3 color;
+			unsigned int byte_offset = 0;
+			unsigned int count = 0;
+			unsigned int texture = 0;
 		};
 
-		struct circular_torus_data
+		// shape scale is folded into the scale of the record, radius is the local bounding radius
+		struct parametric_instance
 		{
-			vec3 scale; float radius_in;
-			vec3 rotation; float radius_out;
-			vec3 translation; float sweep_angle;
+			bounding_sphere bounds;
+			unsigned int record_offset = 0;
+			primitive_type type = primitive_box;
+			vec3 shape_scale;
+			float radius = 0.0f;
+			int occluder = -1;
 		};
 
-		struct cone_data
+		// large box scaled to the unit cube of the occlusion buffer
+		struct box_occluder
 		{
-			vec3 scale; float pad;
-			vec3 rotation; float bottom_radius;
-			vec3 translation; float top_radius;
+			mat34 transform;
+			unsigned int instance = 0;
 		};
 
-		struct cone_offset_data
+		// compacted records of one type and level in the per-frame buffer
+		struct record_range
 		{
-			vec3 scale; float pad;
-			vec3 rotation; float pad2;
-			vec3 translation; float pad3;
-			float bottom_radius; float top_radius; vec2 offset;
+			unsigned int byte_offset = 0;
+			unsigned int count = 0;
 		};
 
-		struct cylinder_offset_data
+		// handles are indices into the instances, whose order end_upload keeps
+		template<typename T>
+		instance_handle _add_instance(primitive_type type, const T& data, const mat4& transform, float radius, const vec3& shape_scale)
 		{
-			vec3 scale; float offset_x;
-			vec3 rotation; float offset_y;
-			vec3 translation; float radius;
-		};
-
-		struct cylinder_slope_data
-		{
-			vec3 scale; float radius;
-			vec3 rotation; float height;
-			vec3 translation; float pad;
-			vec2 bottom_angles; vec2 top_angles;
-		};
+			// primitives are centered on their local origin
+			parametric_instance instance;
+			instance.bounds.center = transform.get_translation();
+			instance.bounds.radius = radius * mat34(transform).max_scale();
+			instance.record_offset = _records.size();
+			instance.type = type;
+			instance.shape_scale = shape_scale;
+			instance.radius = radius;
+			_instances.push_back(instance);
 
-		struct pyramid_data
-		{
-			vec3 scale; float offset_x;
-			vec3 rotation; float offset_y;
-			vec3 translation; float height;
-			vec2 bottom_lenghts; vec2 top_lenghts;
-		};
+			const auto bytes = reinterpret_cast<const char*>(&data);
+			_records.insert(_records.end(), bytes, bytes + sizeof(T));
+			return _instances.size() - 1;
+		}
 
-		struct rectangular_torus_data
-		{
-			vec3 scale; float radius_in;
-			vec3 rotation; float radius_out;
-			vec3 translation; float sweep_angle;
-		};
+		void _render(bool use_colors);
+		void _upload_dirty_records();
+		void _compact_instances();
+		bool _is_filtering_instances() const;
+		bool _is_culling_instances() const { return _instance_culling || _occlusion != nullptr; }
+		void _draw(primitive_type type, int lod, unsigned int instance_count);
+		void _draw_points(bool use_colors);
+		unsigned int _count_vertices(primitive_type type, int lod) const;
+		unsigned int _align(unsigned int byte_offset) const;
 
 		unsigned int _flat_vao;
-		cad::DrawElementsData _draw_flat_with_caps;
-		cad::DrawElementsData _draw_flat_no_caps;
+		cad::DrawElementsData _draw_flat_with_caps[PARAMETRIC_LODS];
+		cad::DrawElementsData _draw_flat_no_caps[PARAMETRIC_LODS];
 
 		unsigned int _smooth_vao;
-		cad::DrawArraysData _draw_smooth_with_caps;
-		cad::DrawArraysData _draw_smooth_no_caps;
-
-		drawable _box;
-		drawable _circular_torus;
-		drawable _cone;
-		drawable _cone_offset;
-		drawable _cylinder;
-		drawable _cylinder_offset;
-		drawable _cylinder_slope;
-		drawable _dish;
-		drawable _pyramid;
-		drawable _rectangular_torus;
-		drawable _sphere;
+		cad::DrawArraysData _draw_smooth_with_caps[PARAMETRIC_LODS];
+		cad::DrawArraysData _draw_smooth_no_caps[PARAMETRIC_LODS];
+
+		drawable _drawables[PRIMITIVE_TYPES];
+
+		// parameter pool: records of every instance grouped by type, each type viewed by its own buffer texture
+		vector<parametric_instance> _instances;
+		vector<char> _records;
+		bool _prepared = false;
+		unsigned int _pool_buffer = 0;
+		unsigned int _texture_alignment = 1;
+
+		// pool pages rewritten by set_transform since the last render call
+		dirty_pages _dirty_records;
+		vector<byte_range> _dirty_ranges;
+		vector<bounding_sphere> _bounds;
+		vector<unsigned int> _moved_instances;
+
+		// instance frustum culling
+		bvh _bvh;
+		bool _instance_culling = false;
+		vector<unsigned int> _visible;
+		unsigned int _culled_instances = 0;
+
+		// occlusion culling
+		const occlusion_buffer* _occlusion = nullptr;
+		vector<box_occluder> _box_occluders;
+		unsigned int _occluded_instances = 0;
+
+		// small features, drawn as their world center when not culled
+		small_feature_mode _small_feature_mode = small_feature_draw;
+		float _small_feature_pixels = 0.5f;
+		unsigned int _small_instances = 0;
+		unsigned int _saved_vertices = 0;
+		vector<vec3> _point_buckets[PRIMITIVE_TYPES];
+		vector<vec3> _point_positions;
+		unsigned int _point_offsets[PRIMITIVE_TYPES + 1];
+		glb::shader_program _point_shader;
+		glb::shader_program _point_visibility_shader;
+		unsigned int _point_vao = 0;
+		unsigned int _point_buffer = 0;
+
+		// per-instance level of detail, chord error of each level relative to the primitive radius
+		float _lod_errors[PARAMETRIC_LODS];
+		bool _lod_selection = false;
+		frustum _frustum;
+
+		// visible records of each type and level, compacted by the first pass after set_view or a move, the other passes reuse them
+		bool _compacted = false;
+		vector<unsigned int> _lod_buckets[PRIMITIVE_TYPES * PARAMETRIC_LODS];
+		record_range _lod_ranges[PRIMITIVE_TYPES * PARAMETRIC_LODS];
+		vector<char> _frame_records;
+		unsigned int _frame_buffer = 0;
+		unsigned int _frame_texture = 0;
+
+		// front to back order of the compacted instances
+		bool _front_to_back = false;
+		vector<std::pair<float, unsigned int>> _instance_order;
+
+		render_pass _pass = render_pass_color;
+		bool _feature_edges = false;
+		unsigned int _vertex_count = 0;
 	};
 } // namespace app
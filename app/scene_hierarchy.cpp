@@ -0,0 +1,201 @@
+#include <app/scene_hierarchy.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	node_id scene_hierarchy::add_node(node_id parent, const mat34& local)
+	{
+		_node_parents.push_back(parent);
+		_node_locals.push_back(local);
+		_node_handles.push_back(INVALID_INSTANCE);
+		_layout_dirty = true;
+		return _node_parents.size() - 1;
+	}
+
+	node_id scene_hierarchy::add_instance(node_id parent, instance_handle handle, const mat34& world)
+	{
+		// world of the parent from its chain of locals, the layout is only rebuilt once adding is over
+		mat34 parent_world(mat4::IDENTITY);
+		for(auto n = parent; n != NO_NODE; n = _node_parents[n])
+		{
+			parent_world = _node_locals[n].mul(parent_world);
+		}
+
+		const auto node = add_node(parent, parent_world.inverse().mul(world));
+		_node_handles[node] = handle;
+		return node;
+	}
+
+	void scene_hierarchy::set_local(node_id node, const mat34& local)
+	{
+		_node_locals[node] = local;
+		if(!_layout_dirty)
+		{
+			_local[_positions[node]] = local;
+		}
+		_dirty_roots.push_back(node);
+	}
+
+	const mat34& scene_hierarchy::get_world(node_id node)
+	{
+		if(_layout_dirty)
+		{
+			_layout();
+		}
+		return _world[_positions[node]];
+	}
+
+	unsigned int scene_hierarchy::update(const std::function<void(instance_handle, const mat34&)>& apply)
+	{
+		if(_layout_dirty)
+		{
+			_layout();
+		}
+		if(_dirty_roots.empty())
+		{
+			return 0;
+		}
+
+		// 1. roots in layout order, an ancestor comes first and stamps the roots below it
+		for(auto& root : _dirty_roots)
+		{
+			root = _positions[root];
+		}
+		std::sort(_dirty_roots.begin(), _dirty_roots.end());
+		_dirty_roots.erase(std::unique(_dirty_roots.begin(), _dirty_roots.end()), _dirty_roots.end());
+		++_update;
+
+		// 2. each subtree level by level, every level is the contiguous range of children of the previous one
+		unsigned int updated = 0;
+		for(auto root : _dirty_roots)
+		{
+			if(_stamp[root] == _update)
+			{
+				continue;
+			}
+
+			auto begin = root;
+			auto end = root + 1;
+			while(begin < end)
+			{
+				for(auto i = begin; i < end; ++i)
+				{
+					_world[i] = _parent[i] == NO_NODE ? _local[i] : _world[_parent[i]].mul(_local[i]);
+					_stamp[i] = _update;
+					if(_handle[i] != INVALID_INSTANCE)
+					{
+						apply(_handle[i], _world[i]);
+					}
+				}
+				updated += end - begin;
+
+				const auto next_begin = _first_child[begin];
+				end = _first_child[end - 1] + _child_count[end - 1];
+				begin = next_begin;
+			}
+		}
+		_dirty_roots.clear();
+		return updated;
+	}
+
+	unsigned int scene_hierarchy::get_subtree_size(node_id node)
+	{
+		if(_layout_dirty)
+		{
+			_layout();
+		}
+
+		unsigned int size = 0;
+		auto begin = _positions[node];
+		auto end = begin + 1;
+		while(begin < end)
+		{
+			size += end - begin;
+			const auto next_begin = _first_child[begin];
+			end = _first_child[end - 1] + _child_count[end - 1];
+			begin = next_begin;
+		}
+		return size;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void scene_hierarchy::_layout()
+	{
+		const unsigned int count = _node_parents.size();
+
+		// 1. children of every id in add order
+		vector<unsigned int> offsets(count + 1, 0);
+		for(auto parent : _node_parents)
+		{
+			if(parent != NO_NODE)
+			{
+				++offsets[parent + 1];
+			}
+		}
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			offsets[i + 1] += offsets[i];
+		}
+		vector<node_id> children(offsets[count]);
+		vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+		for(unsigned int id = 0; id < count; ++id)
+		{
+			if(_node_parents[id] != NO_NODE)
+			{
+				children[cursor[_node_parents[id]]++] = id;
+			}
+		}
+
+		// 2. breadth first order: roots, then the children of each node in turn
+		vector<node_id> order;
+		order.reserve(count);
+		for(unsigned int id = 0; id < count; ++id)
+		{
+			if(_node_parents[id] == NO_NODE)
+			{
+				order.push_back(id);
+			}
+		}
+		const unsigned int roots = order.size();
+		for(unsigned int k = 0; k < order.size(); ++k)
+		{
+			order.insert(order.end(), children.begin() + offsets[order[k]], children.begin() + offsets[order[k] + 1]);
+		}
+
+		// 3. arrays by position, the children of position p start where those of p - 1 end
+		_positions.assign(count, 0);
+		for(unsigned int p = 0; p < count; ++p)
+		{
+			_positions[order[p]] = p;
+		}
+
+		_parent.resize(count);
+		_first_child.resize(count);
+		_child_count.resize(count);
+		_local.resize(count);
+		_world.resize(count);
+		_handle.resize(count);
+		_stamp.assign(count, 0);
+		_update = 0;
+
+		unsigned int next_child = roots;
+		for(unsigned int p = 0; p < count; ++p)
+		{
+			const auto id = order[p];
+			_parent[p] = _node_parents[id] == NO_NODE ? NO_NODE : _positions[_node_parents[id]];
+			_first_child[p] = next_child;
+			_child_count[p] = offsets[id + 1] - offsets[id];
+			next_child += _child_count[p];
+			_local[p] = _node_locals[id];
+			_world[p] = _parent[p] == NO_NODE ? _local[p] : _world[_parent[p]].mul(_local[p]);
+			_handle[p] = _node_handles[id];
+		}
+		_layout_dirty = false;
+	}
+} // namespace app
@@ -0,0 +1,61 @@
+#pragma once
+#include <app/base_renderer.h>
+#include <app/transformation.h>
+#include <functional>
+
+namespace app
+{
+	typedef unsigned int node_id;
+	static const node_id NO_NODE = 0xFFFFFFFFu;
+
+	// optional tree of local transforms over flattened instances (site, zone, equipment, primitives)
+	// nodes are laid out breadth first as structure of arrays: the children of consecutive nodes are consecutive,
+	// so every level of a subtree is one contiguous range and moving a subtree costs time proportional to its size
+	class scene_hierarchy
+	{
+	public:
+		// parent is NO_NODE for roots, ids stay valid as nodes are added
+		node_id add_node(node_id parent, const mat34& local);
+
+		// leaf placing an instance at the given world transform, its local transform is taken relative to the parent
+		node_id add_instance(node_id parent, instance_handle handle, const mat34& world);
+
+		// marks the subtree for the next update
+		void set_local(node_id node, const mat34& local);
+		const mat34& get_local(node_id node) const { return _node_locals[node]; }
+
+		// world transform as of the last update
+		const mat34& get_world(node_id node);
+
+		// recomputes the world transforms of every subtree marked since the last call, parents before children,
+		// and hands each moved instance to apply, returns the number of nodes recomputed
+		unsigned int update(const std::function<void(instance_handle, const mat34&)>& apply);
+
+		unsigned int get_node_count() const { return _node_parents.size(); }
+		unsigned int get_subtree_size(node_id node);
+
+	private:
+		void _layout();
+
+		// by id, in add order
+		vector<node_id> _node_parents;
+		vector<mat34> _node_locals;
+		vector<instance_handle> _node_handles;
+
+		// breadth first layout: position of each id, and by position parent position, range of children, world and local
+		// transforms, instance and the update that last recomputed the node
+		bool _layout_dirty = false;
+		vector<unsigned int> _positions;
+		vector<unsigned int> _parent;
+		vector<unsigned int> _first_child;
+		vector<unsigned int> _child_count;
+		vector<mat34> _local;
+		vector<mat34> _world;
+		vector<instance_handle> _handle;
+		vector<unsigned int> _stamp;
+		unsigned int _update = 0;
+
+		// subtree roots marked by set_local
+		vector<unsigned int> _dirty_roots;
+	};
+} // namespace app
@@ -21,64 +21,76 @@ namespace app
 		_vao_builder.begin();
 	}
 
-	void static_renderer::add_box(const box& b, const mat4& transform)
+	instance_handle static_renderer::add_box(const box& b, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_box(b.extents), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_circular_torus(const circular_torus& ct, const mat4& transform)
+	instance_handle static_renderer::add_circular_torus(const circular_torus& ct, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_circular_torus(ct.in_radius, ct.out_radius, ct.sweep_angle), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_cone(const cone& c, const mat4& transform)
+	instance_handle static_renderer::add_cone(const cone& c, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_cone(c.top_radius, c.bottom_radius, c.height), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
+	instance_handle static_renderer::add_cone_offset(const cone_offset& c, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_cone_offset(c.top_radius, c.bottom_radius, c.height, c.offset), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_cylinder(const cylinder& c, const mat4& transform)
+	instance_handle static_renderer::add_cylinder(const cylinder& c, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_cylinder(c.radius, c.height), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
+	instance_handle static_renderer::add_cylinder_offset(const cylinder_offset& c, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_cylinder_offset(c.radius, c.height, c.offset), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
+	instance_handle static_renderer::add_cylinder_slope(const cylinder_slope& c, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_cylinder_slope(c.radius, c.height, c.top_slope_angles, c.bottom_slope_angles), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_dish(const dish& d, const mat4& transform)
+	instance_handle static_renderer::add_dish(const dish& d, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_dish(d.radius, d.height), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_mesh(const tess::triangle_mesh& m, const mat4& transform)
+	instance_handle static_renderer::add_mesh(const tess::triangle_mesh& m, const mat4& transform)
 	{
 		_add_mesh(m, transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_pyramid(const pyramid& p, const mat4& transform)
+	instance_handle static_renderer::add_pyramid(const pyramid& p, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_pyramid(p.top_extents, p.bottom_extents, p.height, p.offset), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
+	instance_handle static_renderer::add_rectangular_torus(const rectangular_torus& rt, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_rectangular_torus(rt.in_radius, rt.out_radius, rt.in_height, rt.sweep_angle), transform);
+		return INVALID_INSTANCE;
 	}
 
-	void static_renderer::add_sphere(const sphere& s, const mat4& transform)
+	instance_handle static_renderer::add_sphere(const sphere& s, const mat4& transform)
 	{
 		_add_mesh(tess::tessellate_sphere(s.radius), transform);
+		return INVALID_INSTANCE;
 	}
 
 	void static_renderer::end_upload()
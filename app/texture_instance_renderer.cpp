@@ -17,32 +17,36 @@ namespace app
 	// public
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 
-	void texture_instance_renderer::add_box(const box& b, const mat4& transform)
+	instance_handle texture_instance_renderer::add_box(const box& b, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= b.extents;
 		_box_transforms_buffer.add(t);
+		return INVALID_INSTANCE;
 	}
 
-	void texture_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
+	instance_handle texture_instance_renderer::add_cylinder(const cylinder& c, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(c.radius, c.radius, c.height);
 		_cylinder_transforms_buffer.add(t);
+		return INVALID_INSTANCE;
 	}
 
-	void texture_instance_renderer::add_dish(const dish& d, const mat4& transform)
+	instance_handle texture_instance_renderer::add_dish(const dish& d, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(d.radius, d.radius, d.height);
 		_dish_transforms_buffer.add(t);
+		return INVALID_INSTANCE;
 	}
 
-	void texture_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
+	instance_handle texture_instance_renderer::add_sphere(const sphere& s, const mat4& transform)
 	{
 		auto t = transformation(transform);
 		t.scale *= vec3(s.radius, s.radius, s.radius);
 		_sphere_transforms_buffer.add(t);
+		return INVALID_INSTANCE;
 	}
 
 	bool texture_instance_renderer::initialize(glb::framebuffer& fbuffer, glb::camera& cam)
@@ -0,0 +1,113 @@
+#include <app/thread_pool.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// chunks per thread, more balance uneven chunks at the cost of more atomic claims
+	static const unsigned int CHUNKS_PER_THREAD = 4;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	thread_pool::thread_pool(unsigned int threads /*= 0*/) : _next(0)
+	{
+		if(threads == 0)
+		{
+			threads = math::max(std::thread::hardware_concurrency(), 1u);
+		}
+		for(unsigned int i = 1; i < threads; ++i)
+		{
+			_threads.emplace_back(&thread_pool::_work, this);
+		}
+	}
+
+	thread_pool::~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for(auto& t : _threads)
+		{
+			t.join();
+		}
+	}
+
+	void thread_pool::parallel_for(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& task)
+	{
+		const auto chunk = math::max(math::max(grain, 1u), (count + get_thread_count() * CHUNKS_PER_THREAD - 1) / (get_thread_count() * CHUNKS_PER_THREAD));
+		if(_threads.empty() || count <= chunk)
+		{
+			if(count > 0)
+			{
+				task(0, count);
+			}
+			return;
+		}
+
+		// 1. publish the range and wake every worker
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_task = &task;
+			_count = count;
+			_chunk = chunk;
+			_next = 0;
+			_busy = _threads.size();
+			++_generation;
+		}
+		_wake.notify_all();
+
+		// 2. claim chunks alongside the workers, then wait for the ones still running
+		_run_chunks();
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this]{ return _busy == 0; });
+		_task = nullptr;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void thread_pool::_work()
+	{
+		unsigned int generation = 0;
+		for(;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [&]{ return _stop || _generation != generation; });
+				if(_stop)
+				{
+					return;
+				}
+				generation = _generation;
+			}
+
+			_run_chunks();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(--_busy == 0)
+			{
+				_done.notify_one();
+			}
+		}
+	}
+
+	void thread_pool::_run_chunks()
+	{
+		for(;;)
+		{
+			const auto first = _next.fetch_add(_chunk);
+			if(first >= _count)
+			{
+				return;
+			}
+			(*_task)(first, math::min(first + _chunk, _count));
+		}
+	}
+} // namespace app
@@ -0,0 +1,45 @@
+#pragma once
+#include <bl/bl.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace app
+{
+	// fixed set of worker threads running chunks of an index range, the calling thread works along
+	class thread_pool
+	{
+	public:
+		// threads including the caller, 0 uses one per hardware thread
+		explicit thread_pool(unsigned int threads = 0);
+		~thread_pool();
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		// runs task(first, last) over [0, count) in chunks of at least grain indices, returns once every chunk is done
+		void parallel_for(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& task);
+
+		unsigned int get_thread_count() const { return _threads.size() + 1; }
+
+	private:
+		void _work();
+		void _run_chunks();
+
+		vector<std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		std::condition_variable _done;
+		unsigned int _generation = 0;
+		unsigned int _busy = 0;
+		bool _stop = false;
+
+		// range of the current parallel_for, chunks are claimed by advancing _next
+		const std::function<void(unsigned int, unsigned int)>* _task = nullptr;
+		unsigned int _count = 0;
+		unsigned int _chunk = 0;
+		std::atomic<unsigned int> _next;
+	};
+} // namespace app
@@ -0,0 +1,298 @@
+#include <app/transform_feed.h>
+#include <chrono>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRANSFORM_FEED_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#define TRANSFORM_FEED_POSIX 0
+#endif
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global definitions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// start of the segment, the records follow its last cache line; indices only grow and are taken modulo the capacity
+	struct transform_feed::header
+	{
+		unsigned int magic;
+		unsigned int capacity;
+		alignas(64) std::atomic<bl::uint64> head;
+		alignas(64) std::atomic<bl::uint64> tail;
+		alignas(64) std::atomic<bl::uint64> dropped;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static const unsigned int FEED_MAGIC = 0x44454546;
+
+	// moving instances bob around their rest transforms, in model units and radians per second
+	static const float PRODUCER_AMPLITUDE = 0.5f;
+	static const float PRODUCER_SPEED = 3.0f;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// shared by both processes, the producer stamps records with it and the consumer measures their age
+	static bl::uint64 monotonic_ns()
+	{
+#if TRANSFORM_FEED_POSIX
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<bl::uint64>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	transform_feed::~transform_feed()
+	{
+		close();
+	}
+
+	bool transform_feed::create(const char* name, unsigned int capacity /*= TRANSFORM_FEED_CAPACITY*/)
+	{
+		return _map(name, true, capacity);
+	}
+
+	bool transform_feed::attach(const char* name)
+	{
+		return _map(name, false, 0);
+	}
+
+	void transform_feed::close()
+	{
+#if TRANSFORM_FEED_POSIX
+		if(_header != nullptr)
+		{
+			munmap(_header, _mapped_bytes);
+			if(_owner)
+			{
+				shm_unlink(_name.c_str());
+			}
+		}
+#endif
+		_header = nullptr;
+		_records = nullptr;
+		_mapped_bytes = 0;
+		_capacity = 0;
+		_owner = false;
+	}
+
+	bool transform_feed::push(instance_handle handle, const mat34& transform)
+	{
+		// only the producer writes head, the consumer frees slots by advancing tail
+		const auto head = _header->head.load(std::memory_order_relaxed);
+		if(head - _header->tail.load(std::memory_order_acquire) >= _capacity)
+		{
+			_header->dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		auto& r = _records[head & (_capacity - 1)];
+		r.handle = handle;
+		r.transform = transform;
+		r.time_ns = monotonic_ns();
+		_header->head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	unsigned int transform_feed::consume(const std::function<void(const feed_record&)>& apply)
+	{
+		if(_header == nullptr)
+		{
+			return 0;
+		}
+
+		// records pushed while applying wait for the next frame, the other process owns the header: only the capacity checked when
+		// mapping is trusted and a head further than one ring ahead is counted as dropped records
+		auto tail = _header->tail.load(std::memory_order_relaxed);
+		const auto head = _header->head.load(std::memory_order_acquire);
+		if(head - tail > _capacity)
+		{
+			_header->dropped.fetch_add(head - tail - _capacity, std::memory_order_relaxed);
+			tail = head - _capacity;
+		}
+		const auto now = monotonic_ns();
+		for(auto i = tail; i != head; ++i)
+		{
+			const auto& r = _records[i & (_capacity - 1)];
+			const auto latency = now > r.time_ns ? (now - r.time_ns) * 1e-6 : 0.0;
+			_stats.latency_sum_ms += latency;
+			_stats.max_latency_ms = math::max(_stats.max_latency_ms, static_cast<float>(latency));
+			apply(r);
+		}
+		_header->tail.store(head, std::memory_order_release);
+		_stats.records += head - tail;
+		return head - tail;
+	}
+
+	transform_feed::feed_stats transform_feed::get_stats() const
+	{
+		auto stats = _stats;
+		stats.seconds = (monotonic_ns() - _stats_start_ns) * 1e-9f;
+		stats.dropped = _header != nullptr ? _header->dropped.load(std::memory_order_relaxed) - _dropped_at_reset : 0;
+		return stats;
+	}
+
+	void transform_feed::reset_stats()
+	{
+		_stats = feed_stats();
+		_stats_start_ns = monotonic_ns();
+		_dropped_at_reset = _header != nullptr ? _header->dropped.load(std::memory_order_relaxed) : 0;
+	}
+
+	feed_producer::~feed_producer()
+	{
+		stop();
+	}
+
+	bool feed_producer::start(const char* name, const vector<instance_handle>& handles, const vector<mat34>& rest_transforms, float rate_hz)
+	{
+		stop();
+		if(!_feed.attach(name))
+		{
+			return false;
+		}
+		_handles = handles;
+		_rest = rest_transforms;
+		_rate_hz = math::max(rate_hz, 1.0f);
+		_stop = false;
+		_thread = std::thread(&feed_producer::_run, this);
+		return true;
+	}
+
+	void feed_producer::stop()
+	{
+		if(_thread.joinable())
+		{
+			_stop = true;
+			_thread.join();
+		}
+		_feed.close();
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	bool transform_feed::_map(const char* name, bool create, unsigned int capacity)
+	{
+		close();
+#if TRANSFORM_FEED_POSIX
+		// 1. the creator sizes a fresh segment, attaching reads the capacity back from its header
+		int fd = -1;
+		if(create)
+		{
+			if(capacity == 0 || (capacity & (capacity - 1)) != 0)
+			{
+				return false;
+			}
+			shm_unlink(name);
+			fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+			_mapped_bytes = sizeof(header) + capacity * sizeof(feed_record);
+			if(fd < 0 || ftruncate(fd, _mapped_bytes) != 0)
+			{
+				if(fd >= 0)
+				{
+					::close(fd);
+					shm_unlink(name);
+				}
+				return false;
+			}
+		}
+		else
+		{
+			fd = shm_open(name, O_RDWR, 0600);
+			struct stat st;
+			if(fd < 0 || fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(header)))
+			{
+				if(fd >= 0)
+				{
+					::close(fd);
+				}
+				return false;
+			}
+			_mapped_bytes = st.st_size;
+		}
+
+		void* data = mmap(nullptr, _mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(data == MAP_FAILED)
+		{
+			if(create)
+			{
+				shm_unlink(name);
+			}
+			return false;
+		}
+
+		// 2. a new segment is zero filled, its header is built in place
+		_header = static_cast<header*>(data);
+		_records = reinterpret_cast<feed_record*>(static_cast<char*>(data) + sizeof(header));
+		if(create)
+		{
+			new(_header) header();
+			_header->capacity = capacity;
+			_header->head = 0;
+			_header->tail = 0;
+			_header->dropped = 0;
+			_header->magic = FEED_MAGIC;
+		}
+		else
+		{
+			capacity = _header->capacity;
+		}
+		if(_header->magic != FEED_MAGIC || capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+		   sizeof(header) + static_cast<bl::uint64>(capacity) * sizeof(feed_record) > _mapped_bytes)
+		{
+			munmap(data, _mapped_bytes);
+			_header = nullptr;
+			_records = nullptr;
+			return false;
+		}
+
+		_name = name;
+		_owner = create;
+		_capacity = capacity;
+		reset_stats();
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void feed_producer::_run()
+	{
+		const auto period = std::chrono::nanoseconds(static_cast<bl::uint64>(1e9f / _rate_hz));
+		const auto start = std::chrono::steady_clock::now();
+		auto next = start;
+		while(!_stop)
+		{
+			const auto seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+			for(unsigned int i = 0; i < _handles.size(); ++i)
+			{
+				// each instance swings with its own phase over its rest transform
+				auto t = _rest[i];
+				t.data[11] += PRODUCER_AMPLITUDE * std::sin(PRODUCER_SPEED * seconds + i);
+				_feed.push(_handles[i], t);
+			}
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+	}
+} // namespace app
@@ -0,0 +1,101 @@
+#pragma once
+#include <app/base_renderer.h>
+#include <app/transformation.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace app
+{
+	// records the ring holds, a power of two
+	static const unsigned int TRANSFORM_FEED_CAPACITY = 64 * 1024;
+
+	// new transform of one instance, stamped with the monotonic clock of the writer when pushed
+	struct feed_record
+	{
+		bl::uint64 time_ns = 0;
+		instance_handle handle = INVALID_INSTANCE;
+		unsigned int pad = 0;
+		mat34 transform;
+	};
+
+	// single producer, single consumer ring of transform records in POSIX shared memory
+	// the renderer creates the segment, a simulation process attaches to it by name and pushes records
+	class transform_feed
+	{
+	public:
+		struct feed_stats
+		{
+			bl::uint64 records = 0;
+			bl::uint64 dropped = 0;
+			double latency_sum_ms = 0.0;
+			float max_latency_ms = 0.0f;
+			float seconds = 0.0f;
+		};
+
+		transform_feed() = default;
+		~transform_feed();
+
+		transform_feed(const transform_feed&) = delete;
+		transform_feed& operator=(const transform_feed&) = delete;
+
+		// consumer side, replaces any segment left under the same name
+		bool create(const char* name, unsigned int capacity = TRANSFORM_FEED_CAPACITY);
+
+		// producer side, the segment must exist
+		bool attach(const char* name);
+
+		// unmaps, and removes the name when this side created the segment
+		void close();
+		bool is_open() const { return _header != nullptr; }
+
+		// false when the ring is full, the record is counted as dropped
+		bool push(instance_handle handle, const mat34& transform);
+
+		// hands every pending record to apply in push order straight from shared memory, returns how many
+		unsigned int consume(const std::function<void(const feed_record&)>& apply);
+
+		// counters of consume since the last reset
+		feed_stats get_stats() const;
+		void reset_stats();
+
+	private:
+		struct header;
+
+		bool _map(const char* name, bool create, unsigned int capacity);
+
+		header* _header = nullptr;
+		feed_record* _records = nullptr;
+		unsigned int _mapped_bytes = 0;
+
+		// read once from the header when mapping, the other process may rewrite it later
+		unsigned int _capacity = 0;
+		string _name;
+		bool _owner = false;
+
+		feed_stats _stats;
+		bl::uint64 _stats_start_ns = 0;
+		bl::uint64 _dropped_at_reset = 0;
+	};
+
+	// stand-in for the simulation process: a thread attached to the feed by name, swinging a few instances at a fixed rate
+	class feed_producer
+	{
+	public:
+		~feed_producer();
+
+		bool start(const char* name, const vector<instance_handle>& handles, const vector<mat34>& rest_transforms, float rate_hz);
+		void stop();
+		bool is_running() const { return _thread.joinable(); }
+
+	private:
+		void _run();
+
+		transform_feed _feed;
+		vector<instance_handle> _handles;
+		vector<mat34> _rest;
+		float _rate_hz = 0.0f;
+		std::atomic<bool> _stop{false};
+		std::thread _thread;
+	};
+} // namespace app
@@ -0,0 +1,173 @@
+#include <app/transform_kernels.h>
+
+#if defined(__AVX__)
+#define TRANSFORM_AVX 1
+#define TRANSFORM_SSE 1
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORM_AVX 0
+#define TRANSFORM_SSE 1
+#include <xmmintrin.h>
+#else
+#define TRANSFORM_AVX 0
+#define TRANSFORM_SSE 0
+#endif
+
+namespace app
+{
+#if !TRANSFORM_SSE
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// rows of a are combinations of the rows of b, the implicit last row (0, 0, 0, 1) of b adds the translation of a
+	static void multiply(const float* a, const float* b, float* out)
+	{
+		for(int r = 0; r < 3; ++r)
+		{
+			const auto* ar = a + r*4;
+			for(int c = 0; c < 4; ++c)
+			{
+				out[r*4 + c] = ar[0]*b[c] + ar[1]*b[4 + c] + ar[2]*b[8 + c] + (c == 3 ? ar[3] : 0.0f);
+			}
+		}
+	}
+#endif
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void apply_delta(const mat34& delta, const mat34* src, mat34* dst, unsigned int count)
+	{
+		unsigned int i = 0;
+		const auto* d = delta.data;
+
+#if TRANSFORM_AVX
+		// 1. two transforms per iteration, one in each 128-bit lane
+		__m256 c[3][3], t[3];
+		for(int r = 0; r < 3; ++r)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				c[r][k] = _mm256_set1_ps(d[r*4 + k]);
+			}
+			t[r] = _mm256_set_ps(d[r*4 + 3], 0.0f, 0.0f, 0.0f, d[r*4 + 3], 0.0f, 0.0f, 0.0f);
+		}
+		for(; i + 2 <= count; i += 2)
+		{
+			const auto* s0 = src[i].data;
+			const auto* s1 = src[i+1].data;
+			__m256 rows[3];
+			for(int k = 0; k < 3; ++k)
+			{
+				rows[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(s0 + k*4)), _mm_loadu_ps(s1 + k*4), 1);
+			}
+			for(int r = 0; r < 3; ++r)
+			{
+				const auto row = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[r][0], rows[0]), _mm256_mul_ps(c[r][1], rows[1])),
+											   _mm256_add_ps(_mm256_mul_ps(c[r][2], rows[2]), t[r]));
+				_mm_storeu_ps(dst[i].data + r*4, _mm256_castps256_ps128(row));
+				_mm_storeu_ps(dst[i+1].data + r*4, _mm256_extractf128_ps(row, 1));
+			}
+		}
+#endif
+
+#if TRANSFORM_SSE
+		// 2. one transform per iteration
+		__m128 c4[3][3], t4[3];
+		for(int r = 0; r < 3; ++r)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				c4[r][k] = _mm_set1_ps(d[r*4 + k]);
+			}
+			t4[r] = _mm_set_ps(d[r*4 + 3], 0.0f, 0.0f, 0.0f);
+		}
+		for(; i < count; ++i)
+		{
+			const auto* s = src[i].data;
+			const auto s0 = _mm_loadu_ps(s);
+			const auto s1 = _mm_loadu_ps(s + 4);
+			const auto s2 = _mm_loadu_ps(s + 8);
+			for(int r = 0; r < 3; ++r)
+			{
+				const auto row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c4[r][0], s0), _mm_mul_ps(c4[r][1], s1)), _mm_add_ps(_mm_mul_ps(c4[r][2], s2), t4[r]));
+				_mm_storeu_ps(dst[i].data + r*4, row);
+			}
+		}
+#else
+		for(; i < count; ++i)
+		{
+			float out[12];
+			multiply(d, src[i].data, out);
+			std::copy(out, out + 12, dst[i].data);
+		}
+#endif
+	}
+
+	void apply_deltas(const mat34* deltas, const mat34* src, mat34* dst, unsigned int count)
+	{
+		unsigned int i = 0;
+
+#if TRANSFORM_AVX
+		// 1. two transforms per iteration, coefficients are broadcast within each lane
+		const auto w256 = _mm256_set_ps(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+		for(; i + 2 <= count; i += 2)
+		{
+			const auto* s0 = src[i].data;
+			const auto* s1 = src[i+1].data;
+			__m256 rows[3];
+			for(int k = 0; k < 3; ++k)
+			{
+				rows[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(s0 + k*4)), _mm_loadu_ps(s1 + k*4), 1);
+			}
+			for(int r = 0; r < 3; ++r)
+			{
+				const auto a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(deltas[i].data + r*4)), _mm_loadu_ps(deltas[i+1].data + r*4), 1);
+				const auto row = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_permute_ps(a, 0x00), rows[0]), _mm256_mul_ps(_mm256_permute_ps(a, 0x55), rows[1])),
+											   _mm256_add_ps(_mm256_mul_ps(_mm256_permute_ps(a, 0xAA), rows[2]), _mm256_mul_ps(a, w256)));
+				_mm_storeu_ps(dst[i].data + r*4, _mm256_castps256_ps128(row));
+				_mm_storeu_ps(dst[i+1].data + r*4, _mm256_extractf128_ps(row, 1));
+			}
+		}
+#endif
+
+#if TRANSFORM_SSE
+		// 2. one transform per iteration
+		const auto w128 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		for(; i < count; ++i)
+		{
+			const auto* s = src[i].data;
+			const auto s0 = _mm_loadu_ps(s);
+			const auto s1 = _mm_loadu_ps(s + 4);
+			const auto s2 = _mm_loadu_ps(s + 8);
+			for(int r = 0; r < 3; ++r)
+			{
+				const auto a = _mm_loadu_ps(deltas[i].data + r*4);
+				const auto row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), s0), _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), s1)),
+											_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, 0xAA), s2), _mm_mul_ps(a, w128)));
+				_mm_storeu_ps(dst[i].data + r*4, row);
+			}
+		}
+#else
+		for(; i < count; ++i)
+		{
+			float out[12];
+			multiply(deltas[i].data, src[i].data, out);
+			std::copy(out, out + 12, dst[i].data);
+		}
+#endif
+	}
+
+	const char* get_transform_kernel_name()
+	{
+#if TRANSFORM_AVX
+		return "avx";
+#elif TRANSFORM_SSE
+		return "sse";
+#else
+		return "scalar";
+#endif
+	}
+} // namespace app
@@ -0,0 +1,15 @@
+#pragma once
+#include <app/transformation.h>
+
+namespace app
+{
+	// dst[i] = delta * src[i] over a contiguous range, src and dst may be the same range
+	// dst is only written, so it can point into write-combined mapped memory
+	void apply_delta(const mat34& delta, const mat34* src, mat34* dst, unsigned int count);
+
+	// dst[i] = deltas[i] * src[i]
+	void apply_deltas(const mat34* deltas, const mat34* src, mat34* dst, unsigned int count);
+
+	// instruction set of the kernels as compiled: "avx", "sse" or "scalar"
+	const char* get_transform_kernel_name();
+} // namespace app
@@ -0,0 +1,130 @@
+#include <app/transform_ring.h>
+#include <glb/opengl.h>
+
+namespace app
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// wait step once a frame is still in use, in nanoseconds
+	static const GLuint64 FENCE_WAIT_TIMEOUT = 1000000;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	bool transform_ring::create(const vector<mat34>& transforms, int texture_unit)
+	{
+		destroy();
+		if(transforms.empty())
+		{
+			return false;
+		}
+
+		// 1. frames start at offsets a buffer texture range may use
+		int alignment = 1;
+		glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = math::max(alignment, 1);
+		_count = transforms.size();
+		const unsigned int frame_bytes = _count * sizeof(mat34);
+		_frame_stride = (frame_bytes + alignment - 1) / alignment * alignment;
+
+		// 2. coherent persistent mapping, writes become visible to later draws without flushes or unmapping
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &_buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+		glBufferStorage(GL_TEXTURE_BUFFER, TRANSFORM_RING_FRAMES * _frame_stride, nullptr, flags);
+		_data = static_cast<char*>(glMapBufferRange(GL_TEXTURE_BUFFER, 0, TRANSFORM_RING_FRAMES * _frame_stride, flags));
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		if(_data == nullptr)
+		{
+			destroy();
+			return false;
+		}
+
+		for(unsigned int f = 0; f < TRANSFORM_RING_FRAMES; ++f)
+		{
+			std::memcpy(_data + f * _frame_stride, transforms.data(), frame_bytes);
+		}
+
+		// 3. view of the first frame
+		_texture_unit = texture_unit;
+		_frame = 0;
+		_stalls = 0;
+		glGenTextures(1, &_texture);
+		glBindTexture(GL_TEXTURE_BUFFER, _texture);
+		glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, _buffer, 0, frame_bytes);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		return true;
+	}
+
+	void transform_ring::destroy()
+	{
+		for(auto& fence : _fences)
+		{
+			if(fence != nullptr)
+			{
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
+
+		if(_buffer != 0)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+			glUnmapBuffer(GL_TEXTURE_BUFFER);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			glDeleteBuffers(1, &_buffer);
+			glDeleteTextures(1, &_texture);
+		}
+		_buffer = 0;
+		_texture = 0;
+		_data = nullptr;
+		_count = 0;
+	}
+
+	mat34* transform_ring::begin_frame()
+	{
+		if(_data == nullptr)
+		{
+			return nullptr;
+		}
+
+		// 1. every draw issued so far reads the current frame
+		_fences[_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		_frame = (_frame + 1) % TRANSFORM_RING_FRAMES;
+
+		// 2. the next frame is free once the draws of TRANSFORM_RING_FRAMES frames ago completed
+		auto& fence = _fences[_frame];
+		if(fence != nullptr)
+		{
+			auto status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if(status == GL_TIMEOUT_EXPIRED)
+			{
+				++_stalls;
+				do
+				{
+					status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_TIMEOUT);
+				}
+				while(status == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		// 3. the buffer texture views the frame being written from now on
+		glBindTexture(GL_TEXTURE_BUFFER, _texture);
+		glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, _buffer, _frame * _frame_stride, _count * sizeof(mat34));
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		return reinterpret_cast<mat34*>(_data + _frame * _frame_stride);
+	}
+
+	void transform_ring::bind() const
+	{
+		glActiveTexture(GL_TEXTURE0 + _texture_unit);
+		glBindTexture(GL_TEXTURE_BUFFER, _texture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+} // namespace app
@@ -0,0 +1,45 @@
+#pragma once
+#include <app/transformation.h>
+
+// fence type of OpenGL sync objects, GLsync
+struct __GLsync;
+
+namespace app
+{
+	// frames the GPU may still be reading while the CPU writes the next one
+	static const unsigned int TRANSFORM_RING_FRAMES = 3;
+
+	// persistently mapped buffer holding several frames of transforms, viewed by a buffer texture over the current frame
+	// the CPU writes straight into mapped memory, fences keep it from overwriting a frame queued draws still read
+	class transform_ring
+	{
+	public:
+		// every frame starts as a copy of the initial transforms, requires buffer storage (OpenGL 4.4)
+		bool create(const vector<mat34>& transforms, int texture_unit);
+		void destroy();
+
+		// fences the draws issued since the previous call, then waits until the GPU is done with the next frame
+		// returns the next frame: every transform must be rewritten, the frame holds what was written 3 frames ago
+		mat34* begin_frame();
+
+		// current frame on the texture unit given to create
+		void bind() const;
+
+		bool is_created() const { return _buffer != 0; }
+		unsigned int get_count() const { return _count; }
+
+		// frames begin_frame had to wait for the GPU
+		unsigned int get_stalls() const { return _stalls; }
+
+	private:
+		unsigned int _buffer = 0;
+		unsigned int _texture = 0;
+		int _texture_unit = 0;
+		char* _data = nullptr;
+		unsigned int _count = 0;
+		unsigned int _frame_stride = 0;
+		unsigned int _frame = 0;
+		__GLsync* _fences[TRANSFORM_RING_FRAMES] = {};
+		unsigned int _stalls = 0;
+	};
+} // namespace app
@@ -10,4 +10,124 @@ namespace app
 		vec3 rotation;
 		vec3 translation;
 	};
+
+	// affine transform stored as the upper 3 rows of a mat4, as uploaded to transform buffers
+	struct mat34
+	{
+		mat34(){}
+
+		explicit mat34(const mat4& m)
+		{
+			int i = 0;
+			data[i++] = m.at(0,0);
+			data[i++] = m.at(0,1);
+			data[i++] = m.at(0,2);
+			data[i++] = m.at(0,3);
+
+			data[i++] = m.at(1,0);
+			data[i++] = m.at(1,1);
+			data[i++] = m.at(1,2);
+			data[i++] = m.at(1,3);
+
+			data[i++] = m.at(2,0);
+			data[i++] = m.at(2,1);
+			data[i++] = m.at(2,2);
+			data[i++] = m.at(2,3);
+		}
+
+		mat4 as_mat4() const
+		{
+			return mat4(data[0], data[1], data[2], data[3],
+						data[4], data[5], data[6], data[7],
+						data[8], data[9], data[10], data[11],
+						0,0,0,1);
+		}
+
+		vec3 mul(const vec3& p) const
+		{
+			return vec3(data[0]*p.x + data[1]*p.y + data[2]*p.z + data[3],
+						data[4]*p.x + data[5]*p.y + data[6]*p.z + data[7],
+						data[8]*p.x + data[9]*p.y + data[10]*p.z + data[11]);
+		}
+
+		vec3 mul3x3(const vec3& v) const
+		{
+			return vec3(data[0]*v.x + data[1]*v.y + data[2]*v.z,
+						data[4]*v.x + data[5]*v.y + data[6]*v.z,
+						data[8]*v.x + data[9]*v.y + data[10]*v.z);
+		}
+
+		// this transform applied after m
+		mat34 mul(const mat34& m) const
+		{
+			mat34 r;
+			for(int row = 0; row < 3; ++row)
+			{
+				const auto* a = data + row*4;
+				for(int c = 0; c < 4; ++c)
+				{
+					r.data[row*4 + c] = a[0]*m.data[c] + a[1]*m.data[4 + c] + a[2]*m.data[8 + c] + (c == 3 ? a[3] : 0.0f);
+				}
+			}
+			return r;
+		}
+
+		// affine inverse, identity for singular transforms, which callers that need a true inverse test with is_singular first
+		mat34 inverse() const
+		{
+			const auto det = determinant();
+			mat34 r(mat4::IDENTITY);
+			if(is_singular())
+			{
+				return r;
+			}
+
+			const auto* d = data;
+			const auto inv = 1.0f / det;
+			r.data[0] = (d[5]*d[10] - d[6]*d[9]) * inv;
+			r.data[1] = (d[2]*d[9] - d[1]*d[10]) * inv;
+			r.data[2] = (d[1]*d[6] - d[2]*d[5]) * inv;
+			r.data[4] = (d[6]*d[8] - d[4]*d[10]) * inv;
+			r.data[5] = (d[0]*d[10] - d[2]*d[8]) * inv;
+			r.data[6] = (d[2]*d[4] - d[0]*d[6]) * inv;
+			r.data[8] = (d[4]*d[9] - d[5]*d[8]) * inv;
+			r.data[9] = (d[1]*d[8] - d[0]*d[9]) * inv;
+			r.data[10] = (d[0]*d[5] - d[1]*d[4]) * inv;
+
+			const auto t = r.mul3x3(vec3(d[3], d[7], d[11]));
+			r.data[3] = -t.x;
+			r.data[7] = -t.y;
+			r.data[11] = -t.z;
+			return r;
+		}
+
+		// a flattened axis, nothing maps back to the space of the transform
+		bool is_singular() const
+		{
+			return std::abs(determinant()) < 1e-12f;
+		}
+
+		float determinant() const
+		{
+			return data[0] * (data[5]*data[10] - data[6]*data[9]) -
+				   data[1] * (data[4]*data[10] - data[6]*data[8]) +
+				   data[2] * (data[4]*data[9] - data[5]*data[8]);
+		}
+
+		// squared lengths of the transformed basis vectors
+		vec3 squared_scale() const
+		{
+			return vec3(data[0]*data[0] + data[4]*data[4] + data[8]*data[8],
+						data[1]*data[1] + data[5]*data[5] + data[9]*data[9],
+						data[2]*data[2] + data[6]*data[6] + data[10]*data[10]);
+		}
+
+		float max_scale() const
+		{
+			const auto s = squared_scale();
+			return std::sqrt(math::max(s.x, math::max(s.y, s.z)));
+		}
+
+		float data[12];
+	};
 } // namespace app
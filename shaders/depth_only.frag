@@ -0,0 +1,6 @@
+#version 420
+
+// depth pre-pass: only the depth test and write remain
+void main()
+{
+}
@@ -2,28 +2,104 @@
 
 in vec3 in_position;
 in vec3 in_normal;
-in int in_tex_offset;
+in int in_instance;
 in vec3 in_color;
 
 uniform samplerBuffer tex_transforms;
 uniform usamplerBuffer tex_colorIDs;
 uniform usamplerBuffer tex_colors;
 
+// flag bits of every instance, hidden instances never reach the vertex stage
+uniform usamplerBuffer tex_flags;
+const uint INSTANCE_HIGHLIGHTED = 2u;
+const uint INSTANCE_GHOSTED = 4u;
+const vec3 HIGHLIGHT_COLOR = vec3(1.0f, 0.55f, 0.0f);
+const vec3 GHOST_COLOR = vec3(0.9f, 0.9f, 0.95f);
+
+// keyframe tracks: the track texel of every instance packed four to a texel, -1 when it is not animated, then per track
+// (pivot, key count) followed by (translation, time) and the rotation quaternion of each key
+uniform samplerBuffer tex_tracks;
+// seconds into the tracks, negative when nothing is animated
+uniform float animation_time;
+
 out vert_color
 {
 	vec3 diffuse;
 } OutColor;
 
+// instance id for the visibility pass
+flat out uint vis_object_id;
+
+// m moved by the track of the instance, same steps as evaluate_track in animation_track.cpp
+mat4 animate(int instance, mat4 m)
+{
+	if(animation_time < 0.0f)
+	{
+		return m;
+	}
+	const float track = texelFetch(tex_tracks, instance >> 2)[instance & 3];
+	if(track < 0.0f)
+	{
+		return m;
+	}
+
+	// key before the wrapped time, and the blend towards the next one
+	const vec4 header = texelFetch(tex_tracks, int(track));
+	const int first = int(track) + 1;
+	const int count = int(header.w);
+	const float last_time = texelFetch(tex_tracks, first + 2*(count-1)).w;
+	const float t = last_time > 0.0f ? animation_time - last_time * floor(animation_time / last_time) : 0.0f;
+	int k = 0;
+	while(k + 1 < count && texelFetch(tex_tracks, first + 2*(k+1)).w <= t)
+	{
+		++k;
+	}
+
+	const vec4 a = texelFetch(tex_tracks, first + 2*k);
+	vec3 translation = a.xyz;
+	vec4 q = texelFetch(tex_tracks, first + 2*k+1);
+	if(k + 1 < count)
+	{
+		const vec4 b = texelFetch(tex_tracks, first + 2*k+2);
+		const vec4 qb = texelFetch(tex_tracks, first + 2*k+3);
+		const float s = (t - a.w) / (b.w - a.w);
+		translation = mix(a.xyz, b.xyz, s);
+		q = normalize(mix(q, dot(q, qb) < 0.0f ? -qb : qb, s));
+	}
+
+	// rows of the rotation about the pivot followed by the translation, m holds the rows of the rest transform as columns
+	const float x = q.x, y = q.y, z = q.z, w = q.w;
+	const vec3 r0 = vec3(1.0f - 2.0f*(y*y + z*z), 2.0f*(x*y - w*z), 2.0f*(x*z + w*y));
+	const vec3 r1 = vec3(2.0f*(x*y + w*z), 1.0f - 2.0f*(x*x + z*z), 2.0f*(y*z - w*x));
+	const vec3 r2 = vec3(2.0f*(x*z - w*y), 2.0f*(y*z + w*x), 1.0f - 2.0f*(x*x + y*y));
+	const vec3 p = header.xyz;
+	const vec3 offset = p + translation - vec3(dot(r0, p), dot(r1, p), dot(r2, p));
+	return m * mat4(vec4(r0, offset.x), vec4(r1, offset.y), vec4(r2, offset.z), vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
 void main()
 {
-	const mat4 m = mat4(texelFetch(tex_transforms, (in_tex_offset+gl_InstanceID)*3+0),
-						texelFetch(tex_transforms, (in_tex_offset+gl_InstanceID)*3+1),
-						texelFetch(tex_transforms, (in_tex_offset+gl_InstanceID)*3+2),
-						vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	// in_instance is a per-instance attribute offset by the draw's base instance
+	const mat4 m = animate(in_instance, mat4(texelFetch(tex_transforms, in_instance*3+0),
+											 texelFetch(tex_transforms, in_instance*3+1),
+											 texelFetch(tex_transforms, in_instance*3+2),
+											 vec4(0.0f, 0.0f, 0.0f, 1.0f)));
 
 	gl_Position = default_transform_t(in_position, in_normal, m);
+	vis_object_id = uint(in_instance);
 
-        int color_id = int(texelFetch(tex_colorIDs, in_tex_offset+gl_InstanceID).r);
+        int color_id = int(texelFetch(tex_colorIDs, in_instance).r);
         OutColor.diffuse = texelFetch(tex_colors, color_id).rgb * vec3(0.00392156862745f);
+
+	// highlighted instances are pulled towards one color, ghosted ones washed out
+	const uint flags = texelFetch(tex_flags, in_instance).r;
+	if((flags & INSTANCE_HIGHLIGHTED) != 0u)
+	{
+		OutColor.diffuse = mix(OutColor.diffuse, HIGHLIGHT_COLOR, 0.7f);
+	}
+	if((flags & INSTANCE_GHOSTED) != 0u)
+	{
+		OutColor.diffuse = mix(OutColor.diffuse, GHOST_COLOR, 0.8f);
+	}
     //OutColor.diffuse = in_color;
 }
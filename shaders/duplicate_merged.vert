@@ -0,0 +1,24 @@
+#include "common.vert"
+
+in vec3 in_position;
+in vec3 in_normal;
+in int in_color_id;
+
+uniform usamplerBuffer tex_colors;
+
+out vert_color
+{
+	vec3 diffuse;
+} OutColor;
+
+// color id tagged as merged for the visibility pass
+flat out uint vis_object_id;
+
+void main()
+{
+	// merged batches are pre-transformed to world space
+	gl_Position = default_transform_t(in_position, in_normal, mat4(1.0f));
+	vis_object_id = 0x40000000u | uint(in_color_id);
+
+	OutColor.diffuse = texelFetch(tex_colors, in_color_id).rgb * vec3(0.00392156862745f);
+}
@@ -0,0 +1,16 @@
+#include "common.vert"
+
+in vec3 in_position;
+in vec3 in_color;
+
+out vert_color
+{
+	vec3 diffuse;
+} OutColor;
+
+void main()
+{
+	// small features are drawn as their world space center
+	gl_Position = default_transform_t(in_position, vec3(0.0f, 0.0f, 1.0f), mat4(1.0f));
+	OutColor.diffuse = in_color;
+}
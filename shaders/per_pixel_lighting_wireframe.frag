@@ -0,0 +1,56 @@
+#version 420
+
+in vert_to_frag_block
+{
+	vec3 eye_position;
+	vec3 eye_normal;
+} Input;
+
+in vert_color
+{
+	vec3 diffuse;
+} InColor;
+
+noperspective in vec3 edge_coords;
+flat in uint edge_mask;
+
+out vec4 out_color;
+
+const vec3 DEFAULT_AMBIENT  = vec3(0.2f, 0.2f, 0.2f);
+const vec3 DEFAULT_SPECULAR = vec3(0.4f, 0.4f, 0.4f);
+const float MATERIAL_SHININESS = 32.0f;
+const float MATERIAL_ALPHA = 1.0f;
+
+const vec3 EDGE_COLOR = vec3(0.0f, 0.0f, 0.0f);
+// pixels on each side of a shared edge
+const float EDGE_HALF_WIDTH = 1.0f;
+
+void main()
+{
+	const vec3 ambient = DEFAULT_AMBIENT;
+	vec3 diffuse = vec3(0.0);
+	vec3 specular = vec3(0.0);
+
+	const vec3 n = normalize(Input.eye_normal);
+	const vec3 l = normalize(-Input.eye_position); // light - vert
+
+	float diffuseIntensity = dot(n,l);
+	if(diffuseIntensity > 0.0f)
+	{
+		diffuse = InColor.diffuse * diffuseIntensity;
+
+		const vec3 r = reflect(-l,n);
+		const vec3 e = l; // cam - vert
+		const float specularIntensity = max(dot(r,e), 0.0f);
+		specular = DEFAULT_SPECULAR * pow(specularIntensity, MATERIAL_SHININESS);
+	}
+
+	// distance in pixels to each edge from the screen-space rate of change of the barycentric coordinates
+	const vec3 pixels = edge_coords / max(fwidth(edge_coords), vec3(1e-6f));
+	const bvec3 drawn = notEqual(edge_mask & uvec3(1u, 2u, 4u), uvec3(0u));
+	const vec3 distances = mix(vec3(1e6f), pixels, drawn);
+	const float nearest = min(distances.x, min(distances.y, distances.z));
+	const float edge = 1.0f - smoothstep(EDGE_HALF_WIDTH - 0.5f, EDGE_HALF_WIDTH + 0.5f, nearest);
+
+	out_color = vec4(mix(ambient + diffuse + specular, EDGE_COLOR, edge), MATERIAL_ALPHA);
+}
@@ -0,0 +1,10 @@
+#version 420
+
+flat in uint vis_object_id;
+
+out uvec2 out_visibility;
+
+void main()
+{
+	out_visibility = uvec2(vis_object_id, uint(gl_PrimitiveID));
+}
@@ -0,0 +1,11 @@
+#version 420
+
+// id of every object drawn by the program, for vertex stages that do not output one
+uniform int object_id;
+
+out uvec2 out_visibility;
+
+void main()
+{
+	out_visibility = uvec2(uint(object_id), uint(gl_PrimitiveID));
+}
@@ -0,0 +1,109 @@
+#version 420
+
+uniform usampler2D tex_visibility;
+uniform sampler2D tex_depth;
+uniform usamplerBuffer tex_colorIDs;
+uniform usamplerBuffer tex_colors;
+
+// flag bits of every mesh instance, same shading as duplicate_instance.vert
+uniform usamplerBuffer tex_flags;
+const uint INSTANCE_HIGHLIGHTED = 2u;
+const uint INSTANCE_GHOSTED = 4u;
+const vec3 HIGHLIGHT_COLOR = vec3(1.0f, 0.55f, 0.0f);
+const vec3 GHOST_COLOR = vec3(0.9f, 0.9f, 0.95f);
+
+// texel 0: projection terms (P00, P11, P22, P23), then the color of each parametric type
+uniform samplerBuffer tex_resolve;
+
+out vec4 out_color;
+
+const uint MESH_INSTANCE = 0u;
+const uint MERGED_COLOR = 1u;
+const uint PARAMETRIC_TYPE = 2u;
+const uint BACKGROUND = 0xFFFFFFFFu;
+
+const vec3 DEFAULT_AMBIENT  = vec3(0.2f, 0.2f, 0.2f);
+const vec3 DEFAULT_SPECULAR = vec3(0.4f, 0.4f, 0.4f);
+const float MATERIAL_SHININESS = 32.0f;
+const float MATERIAL_ALPHA = 1.0f;
+
+vec3 eye_position(ivec2 pixel)
+{
+	const ivec2 size = textureSize(tex_depth, 0);
+	pixel = clamp(pixel, ivec2(0), size - 1);
+
+	const vec4 projection = texelFetch(tex_resolve, 0);
+	const vec2 ndc = (vec2(pixel) + 0.5f) / vec2(size) * 2.0f - 1.0f;
+	const float ndc_z = texelFetch(tex_depth, pixel, 0).r * 2.0f - 1.0f;
+	const float z = -projection.w / (ndc_z + projection.z);
+	return vec3(-z * ndc.x / projection.x, -z * ndc.y / projection.y, z);
+}
+
+// step to the neighbour on the same surface, the one with the smaller depth change
+vec3 surface_delta(ivec2 pixel, vec3 p, ivec2 step)
+{
+	const vec3 forward = eye_position(pixel + step) - p;
+	const vec3 backward = p - eye_position(pixel - step);
+	return abs(forward.z) < abs(backward.z) ? forward : backward;
+}
+
+void main()
+{
+	const ivec2 pixel = ivec2(gl_FragCoord.xy);
+	const uint object_id = texelFetch(tex_visibility, pixel, 0).r;
+	if(object_id == BACKGROUND)
+	{
+		discard;
+	}
+
+	// 1. color of the object
+	const uint tag = object_id >> 30;
+	const int id = int(object_id & 0x3FFFFFFFu);
+	vec3 color;
+	if(tag == MESH_INSTANCE)
+	{
+		color = texelFetch(tex_colors, int(texelFetch(tex_colorIDs, id).r)).rgb * vec3(0.00392156862745f);
+		const uint flags = texelFetch(tex_flags, id).r;
+		if((flags & INSTANCE_HIGHLIGHTED) != 0u)
+		{
+			color = mix(color, HIGHLIGHT_COLOR, 0.7f);
+		}
+		if((flags & INSTANCE_GHOSTED) != 0u)
+		{
+			color = mix(color, GHOST_COLOR, 0.8f);
+		}
+	}
+	else if(tag == MERGED_COLOR)
+	{
+		color = texelFetch(tex_colors, id).rgb * vec3(0.00392156862745f);
+	}
+	else
+	{
+		color = texelFetch(tex_resolve, 1 + id).rgb;
+	}
+
+	// 2. eye space position from depth, face normal from the neighbouring positions
+	const vec3 p = eye_position(pixel);
+	vec3 n = normalize(cross(surface_delta(pixel, p, ivec2(1, 0)), surface_delta(pixel, p, ivec2(0, 1))));
+	const vec3 l = normalize(-p);
+	if(dot(n, l) < 0.0f)
+	{
+		n = -n;
+	}
+
+	// 3. same lighting as per_pixel_lighting_color.frag, once per pixel
+	vec3 diffuse = vec3(0.0);
+	vec3 specular = vec3(0.0);
+	const float diffuseIntensity = dot(n, l);
+	if(diffuseIntensity > 0.0f)
+	{
+		diffuse = color * diffuseIntensity;
+
+		const vec3 r = reflect(-l, n);
+		const float specularIntensity = max(dot(r, l), 0.0f);
+		specular = DEFAULT_SPECULAR * pow(specularIntensity, MATERIAL_SHININESS);
+	}
+
+	out_color = vec4(DEFAULT_AMBIENT + diffuse + specular, MATERIAL_ALPHA);
+	gl_FragDepth = texelFetch(tex_depth, pixel, 0).r;
+}
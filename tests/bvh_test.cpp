@@ -0,0 +1,147 @@
+#include <app/bvh.h>
+#include <app/duplicate_instance_renderer.h>
+#include <app/parametric_instance_renderer.h>
+#include <tests/test_common.h>
+
+// headless check of bvh culling over a grid of known spheres, directly and through the instance renderers
+
+using namespace app;
+using namespace test;
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// global constants
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// 10x10x10 unit spheres 10 apart, from 0 to 90 along each axis
+static const int GRID_SIZE = 10;
+static const float GRID_SPACING = 10.0f;
+static const float GRID_CENTER = 45.0f;
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// helper functions
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// camera above the grid center at the given height, looking down -z, or up +z when turned around
+static frustum grid_camera(float height, bool turned, float far)
+{
+	return make_frustum(vec3(GRID_CENTER, GRID_CENTER, height), turned, far, 1.0f);
+}
+
+// octahedron of unit radius, its vertices are not coplanar so shape matching finds every copy
+static tess::triangle_mesh make_octahedron()
+{
+	tess::triangle_mesh mesh;
+	const vec3 corners[] = {vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f),
+							vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f)};
+	for(const auto& c : corners)
+	{
+		tess::vertex v;
+		v.position = c;
+		v.normal = c;
+		mesh.vertices.push_back(v);
+	}
+	mesh.elements = {0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4, 2, 0, 5, 1, 2, 5, 3, 1, 5, 0, 3, 5};
+	return mesh;
+}
+
+static unsigned int count_visible(const bvh& h, const frustum& f)
+{
+	vector<unsigned int> visible;
+	const auto count = h.cull(f, visible);
+	std::sort(visible.begin(), visible.end());
+	if(std::adjacent_find(visible.begin(), visible.end()) != visible.end() || count != visible.size())
+	{
+		return ~0u;
+	}
+	return count;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// test
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+	vector<bounding_sphere> bounds;
+	for(int z = 0; z < GRID_SIZE; ++z)
+	{
+		for(int y = 0; y < GRID_SIZE; ++y)
+		{
+			for(int x = 0; x < GRID_SIZE; ++x)
+			{
+				bounding_sphere b;
+				b.center = vec3(x * GRID_SPACING, y * GRID_SPACING, z * GRID_SPACING);
+				b.radius = 1.0f;
+				bounds.push_back(b);
+			}
+		}
+	}
+
+	bvh h;
+	h.build(bounds);
+	check(h.get_node_count() > 1, "grid is split into several nodes", h.get_node_count());
+
+	// 1. far above the grid every sphere is in view, turned around none is
+	auto visible = count_visible(h, grid_camera(300.0f, false, 1000.0f));
+	check(visible == 1000, "whole grid in view", visible);
+	visible = count_visible(h, grid_camera(300.0f, true, 1000.0f));
+	check(visible == 0, "grid behind the camera", visible);
+
+	// 2. the far plane at 155 keeps the layers z = 50 to 90, 150 to 110 away, and drops z = 40 at 160
+	visible = count_visible(h, grid_camera(200.0f, false, 155.0f));
+	check(visible == 500, "far plane keeps the top five layers", visible);
+
+	// 3. below the grid looking up, the same far plane keeps the layers z = 0 to 50 and drops z = 60 at 160
+	visible = count_visible(h, grid_camera(-100.0f, true, 155.0f));
+	check(visible == 600, "far plane keeps the bottom six layers", visible);
+
+	// 4. spheres moved far aside leave the view after refitting only them, and after a full refit
+	vector<unsigned int> moved;
+	for(unsigned int i = 0; i < 10; ++i)
+	{
+		moved.push_back(i * 97);
+		bounds[i * 97].center.x += 10000.0f;
+	}
+	h.refit(bounds, moved);
+	visible = count_visible(h, grid_camera(300.0f, false, 1000.0f));
+	check(visible == 990, "moved spheres leave the view", visible);
+	check(h.get_refit_node_count() < h.get_node_count(), "only the moved leaves and their ancestors are refitted", h.get_refit_node_count());
+
+	h.refit(bounds);
+	visible = count_visible(h, grid_camera(300.0f, false, 1000.0f));
+	check(visible == 990, "full refit agrees", visible);
+
+	// 5. both renderers cull the same grid through their own hierarchies after the CPU half of end_upload
+	const auto octahedron = make_octahedron();
+	duplicate_instance_renderer meshes;
+	parametric_instance_renderer primitives;
+	sphere unit;
+	unit.radius = 1.0f;
+	for(int z = 0; z < GRID_SIZE; ++z)
+	{
+		for(int y = 0; y < GRID_SIZE; ++y)
+		{
+			for(int x = 0; x < GRID_SIZE; ++x)
+			{
+				const auto transform = mat4::translation(vec3(x * GRID_SPACING, y * GRID_SPACING, z * GRID_SPACING));
+				meshes.add_mesh(octahedron, transform);
+				primitives.add_sphere(unit, transform);
+			}
+		}
+	}
+	meshes.prepare_upload();
+	primitives.prepare_upload();
+	check(meshes.get_unique_mesh_count() == 1, "mesh renderer shares one mesh", meshes.get_unique_mesh_count());
+
+	const frustum cameras[] = {grid_camera(300.0f, false, 1000.0f), grid_camera(300.0f, true, 1000.0f), grid_camera(200.0f, false, 155.0f), grid_camera(-100.0f, true, 155.0f)};
+	const unsigned int expected[] = {1000, 0, 500, 600};
+	for(unsigned int c = 0; c < 4; ++c)
+	{
+		visible = meshes.count_visible_instances(cameras[c]);
+		check(visible == expected[c], "mesh renderer agrees with the bvh", visible);
+		visible = primitives.count_visible_instances(cameras[c]);
+		check(visible == expected[c], "parametric renderer agrees with the bvh", visible);
+	}
+
+	return report("bvh");
+}
@@ -0,0 +1,140 @@
+#include <app/meshlet.h>
+#include <app/duplicate_instance_renderer.h>
+#include <tests/test_common.h>
+
+// headless check of meshlet building and culling for fixed cameras, directly and through duplicate_instance_renderer
+
+using namespace app;
+using namespace test;
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// global constants
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// a patch of 7x7 quads has 64 vertices and 98 triangles, exactly one meshlet
+static const int PATCH_QUADS = 7;
+static const unsigned int PATCH_TRIANGLES = 2 * PATCH_QUADS * PATCH_QUADS;
+
+// the renderer only splits meshes of several meshlets, 16x16 quads make 512 triangles
+static const int LARGE_PATCH_QUADS = 16;
+static const unsigned int LARGE_PATCH_TRIANGLES = 2 * LARGE_PATCH_QUADS * LARGE_PATCH_QUADS;
+static const float FAR_PATCH_X = 100.0f;
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// helper functions
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// patch of side 2 in the z = 0 plane centered on (x, 0, 0), its triangles face +z
+// ridges lift every other column of vertices, shape matching needs points off a single plane
+static void add_patch(tess::triangle_mesh& mesh, float x, int quads = PATCH_QUADS, float ridge = 0.0f)
+{
+	const unsigned int first = mesh.vertices.size();
+	for(int j = 0; j <= quads; ++j)
+	{
+		for(int i = 0; i <= quads; ++i)
+		{
+			tess::vertex v;
+			v.position = vec3(x - 1.0f + 2.0f * i / quads, -1.0f + 2.0f * j / quads, (i % 2) * ridge);
+			v.normal = vec3(0.0f, 0.0f, 1.0f);
+			mesh.vertices.push_back(v);
+		}
+	}
+
+	for(int j = 0; j < quads; ++j)
+	{
+		for(int i = 0; i < quads; ++i)
+		{
+			const unsigned int a = first + j * (quads + 1) + i;
+			const unsigned int b = a + 1;
+			const unsigned int c = b + quads + 1;
+			const unsigned int d = a + quads + 1;
+			mesh.elements.insert(mesh.elements.end(), {a, b, c, a, c, d});
+		}
+	}
+}
+
+static unsigned int count_triangles(const vector<draw_range>& ranges)
+{
+	unsigned int triangles = 0;
+	for(const auto& r : ranges)
+	{
+		triangles += r.element_count / 3;
+	}
+	return triangles;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// test
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+	// 1. two patches, one at the origin and one far along x, cut into one meshlet each
+	tess::triangle_mesh mesh;
+	add_patch(mesh, 0.0f);
+	add_patch(mesh, FAR_PATCH_X);
+	const auto meshlets = build_meshlets(mesh.elements, mesh.vertices);
+	check(meshlets.size() == 2, "one meshlet per patch", meshlets.size());
+	check(meshlets[0].element_count / 3 == PATCH_TRIANGLES, "first meshlet holds the first patch", meshlets[0].element_count / 3);
+
+	const mat34 identity(mat4::IDENTITY);
+	vector<draw_range> ranges;
+
+	// 2. facing the near patch, the far one is outside the frustum
+	auto culled = cull_meshlets(meshlets.data(), meshlets.size(), identity, make_frustum(vec3(0.0f, 0.0f, 5.0f), false, 100.0f), ranges);
+	check(culled == PATCH_TRIANGLES, "front camera culls the far patch", culled);
+	check(count_triangles(ranges) == PATCH_TRIANGLES, "front camera draws the near patch", count_triangles(ranges));
+
+	// 3. behind the patches both face away
+	ranges.clear();
+	culled = cull_meshlets(meshlets.data(), meshlets.size(), identity, make_frustum(vec3(0.0f, 0.0f, -5.0f), true, 100.0f), ranges);
+	check(culled == 2 * PATCH_TRIANGLES, "back camera culls both back facing patches", culled);
+	check(ranges.empty(), "back camera draws nothing", ranges.size());
+
+	// 4. far enough back both are in view, as one merged range
+	ranges.clear();
+	culled = cull_meshlets(meshlets.data(), meshlets.size(), identity, make_frustum(vec3(0.5f * FAR_PATCH_X, 0.0f, 200.0f), false, 1000.0f), ranges);
+	check(culled == 0, "wide camera culls nothing", culled);
+	check(ranges.size() == 1 && count_triangles(ranges) == 2 * PATCH_TRIANGLES, "wide camera draws one merged range", ranges.size());
+
+	// 5. the instance transform moves the mesh behind the camera
+	ranges.clear();
+	const mat34 behind(mat4::translation(vec3(0.0f, 0.0f, 500.0f)));
+	culled = cull_meshlets(meshlets.data(), meshlets.size(), behind, make_frustum(vec3(0.0f, 0.0f, 5.0f), false, 100.0f), ranges);
+	check(culled == 2 * PATCH_TRIANGLES, "instance behind the camera is culled", culled);
+
+	// 6. a mirror keeps the near patch facing the camera, only the far one leaves the frustum
+	ranges.clear();
+	const mat34 mirrored(mat4(-1.0f, 0.0f, 0.0f, 0.0f,
+							   0.0f, 1.0f, 0.0f, 0.0f,
+							   0.0f, 0.0f, 1.0f, 0.0f,
+							   0.0f, 0.0f, 0.0f, 1.0f));
+	culled = cull_meshlets(meshlets.data(), meshlets.size(), mirrored, make_frustum(vec3(0.0f, 0.0f, 5.0f), false, 100.0f), ranges);
+	check(culled == PATCH_TRIANGLES, "mirrored instance keeps its front facing patch", culled);
+
+	// 7. a shear with unit columns turns the cone axis away from the camera, the patch itself still faces it
+	ranges.clear();
+	const mat34 sheared(mat4(1.0f, 0.0f, 0.98f, 40.0f,
+							 0.0f, 1.0f, 0.0f,  0.0f,
+							 0.0f, 0.0f, 0.2f,  0.0f,
+							 0.0f, 0.0f, 0.0f,  1.0f));
+	culled = cull_meshlets(meshlets.data(), meshlets.size(), sheared, make_frustum(vec3(0.0f, 0.0f, 100.0f), false, 1000.0f), ranges);
+	check(culled == PATCH_TRIANGLES, "sheared instance skips the cone test", culled);
+
+	// 8. through the renderer: the set of a large patch with an instance far along x and a mirrored one at the origin
+	tess::triangle_mesh large;
+	add_patch(large, 0.0f, LARGE_PATCH_QUADS, 0.05f);
+	duplicate_instance_renderer renderer;
+	renderer.add_mesh(large, mat4::IDENTITY);
+	renderer.add_mesh(large, mat4::translation(vec3(FAR_PATCH_X, 0.0f, 0.0f)));
+	renderer.add_mesh(large, mirrored.as_mat4());
+	renderer.prepare_upload();
+	check(renderer.get_unique_mesh_count() == 1, "renderer shares one mesh", renderer.get_unique_mesh_count());
+
+	culled = renderer.count_culled_triangles(make_frustum(vec3(0.0f, 0.0f, 5.0f), false, 100.0f));
+	check(culled == LARGE_PATCH_TRIANGLES, "renderer front camera culls the far instance", culled);
+	culled = renderer.count_culled_triangles(make_frustum(vec3(0.0f, 0.0f, -5.0f), true, 100.0f));
+	check(culled == 3 * LARGE_PATCH_TRIANGLES, "renderer back camera culls every instance", culled);
+
+	return report("meshlet");
+}
@@ -0,0 +1,73 @@
+#include <app/occlusion_buffer.h>
+#include <tests/test_common.h>
+
+// headless check of the CPU occlusion buffer against known occluders, links app/occlusion_buffer.cpp and app/frustum.cpp
+
+using namespace app;
+using namespace test;
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// global constants
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// the buffer is twice as wide as high
+static const float CAMERA_ASPECT = 2.0f;
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// helper functions
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// x and y scaled by extent, z by depth, centered at distance along -z
+static mat34 slab(float extent, float depth, float distance)
+{
+	return mat34(mat4(extent, 0.0f,   0.0f,  0.0f,
+					  0.0f,   extent, 0.0f,  0.0f,
+					  0.0f,   0.0f,   depth, -distance,
+					  0.0f,   0.0f,   0.0f,  1.0f));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+// test
+// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main()
+{
+	// camera at the origin looking down -z
+	const auto f = make_frustum(vec3(0.0f, 0.0f, 0.0f), false, 1000.0f, 1.0f, CAMERA_ASPECT, OCCLUSION_BUFFER_HEIGHT);
+	occlusion_buffer buffer;
+	bool visible = false;
+
+	// 1. nothing rasterized hides nothing
+	buffer.begin(f);
+	visible = buffer.is_sphere_visible(vec3(0.0f, 0.0f, -50.0f), 1.0f);
+	check(visible, "empty buffer hides nothing", visible);
+
+	// 2. a 4x4 box 10 in front of the camera
+	buffer.begin(f);
+	buffer.rasterize_box(slab(4.0f, 1.0f, 10.0f));
+	check(buffer.get_rasterized_triangles() > 0, "box is rasterized", buffer.get_rasterized_triangles());
+	visible = buffer.is_sphere_visible(vec3(0.0f, 0.0f, -50.0f), 1.0f);
+	check(!visible, "small sphere behind the box is hidden", visible);
+	visible = buffer.is_sphere_visible(vec3(0.0f, 0.0f, -5.0f), 1.0f);
+	check(visible, "sphere in front of the box is visible", visible);
+	visible = buffer.is_sphere_visible(vec3(20.0f, 0.0f, -50.0f), 1.0f);
+	check(visible, "sphere beside the box is visible", visible);
+	visible = buffer.is_sphere_visible(vec3(0.0f, 0.0f, -50.0f), 30.0f);
+	check(visible, "sphere wider than the box is visible", visible);
+
+	// the silhouette x = 2 at z = -9.5 lands at x = 10.53 at z = -50, the sphere reaches a fraction of a buffer pixel past it
+	visible = buffer.is_sphere_visible(vec3(10.5f, 0.0f, -50.0f), 0.1f);
+	check(visible, "sphere poking out of the silhouette is visible", visible);
+
+	// 3. a 10x10 quad 20 in front of the camera through the mesh path
+	const vector<vec3> positions = {vec3(-0.5f, -0.5f, 0.0f), vec3(0.5f, -0.5f, 0.0f), vec3(0.5f, 0.5f, 0.0f), vec3(-0.5f, 0.5f, 0.0f)};
+	const vector<unsigned int> elements = {0, 1, 2, 0, 2, 3};
+	buffer.begin(f);
+	buffer.rasterize(positions, elements, slab(10.0f, 1.0f, 20.0f));
+	visible = buffer.is_sphere_visible(vec3(0.0f, 0.0f, -40.0f), 1.0f);
+	check(!visible, "sphere behind the quad is hidden", visible);
+	visible = buffer.is_sphere_visible(vec3(0.0f, 0.0f, -10.0f), 1.0f);
+	check(visible, "sphere in front of the quad is visible", visible);
+
+	return report("occlusion buffer");
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <app/frustum.h>
+#include <cstdio>
+
+// shared by the headless tests, each test is one executable that prints its failed checks and returns non-zero if any failed
+
+namespace test
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static const float CAMERA_FOVY = 1.0f;
+	static const int VIEWPORT_HEIGHT = 600;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helper functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static int failures = 0;
+
+	inline void check(bool condition, const char* what, unsigned int value)
+	{
+		if(!condition)
+		{
+			std::printf("FAILED: %s (got %u)\n", what, value);
+			++failures;
+		}
+	}
+
+	// camera at eye looking down -z, or down +z when turned around
+	inline app::frustum make_frustum(const vec3& eye, bool turned, float far, float near = 0.1f, float aspect = 1.0f, int viewport_height = VIEWPORT_HEIGHT)
+	{
+		const float s = turned ? -1.0f : 1.0f;
+		const mat4 view(s,    0.0f, 0.0f, -s * eye.x,
+						0.0f, 1.0f, 0.0f, -eye.y,
+						0.0f, 0.0f, s,    -s * eye.z,
+						0.0f, 0.0f, 0.0f, 1.0f);
+		app::frustum f;
+		f.set(view, mat4::perspective(CAMERA_FOVY, aspect, near, far), viewport_height);
+		return f;
+	}
+
+	// prints the outcome, the result is the exit code of the test
+	inline int report(const char* name)
+	{
+		std::printf("%s test: %s\n", name, failures == 0 ? "passed" : "failed");
+		return failures == 0 ? 0 : 1;
+	}
+} // namespace test